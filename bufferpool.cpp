@@ -0,0 +1,30 @@
+#include "bufferpool.hpp"
+#include <new>
+
+BufferPool::BufferPool() : borrowed(0), area(new char[SCRATCH_SIZE]) {}
+
+BufferPool::~BufferPool() {
+	for (size_t i = 0; i < spare.size(); ++i)
+		::operator delete(spare[i]);
+	delete[] area;
+}
+
+void* BufferPool::allocate(size_t size) {
+	size = sizeFor(size);
+	borrowed += size;
+	if (size == CHUNK_SIZE && !spare.empty()) {
+		void* chunk = spare.back();
+		spare.pop_back();
+		return chunk;
+	}
+	return ::operator new(size);
+}
+
+void BufferPool::release(void* block, size_t size) {
+	size = sizeFor(size);
+	borrowed -= size;
+	if (size == CHUNK_SIZE && spare.size() < MAX_SPARE)
+		spare.push_back(block);
+	else
+		::operator delete(block);
+}
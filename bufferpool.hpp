@@ -0,0 +1,47 @@
+#ifndef BUFFERPOOL_HPP
+#define BUFFERPOOL_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Tampons des connexions d'un shard. Une connexion inactive n'en a aucun :
+// elle emprunte un morceau de CHUNK_SIZE octets seulement quand une ligne
+// partielle attend la suite (LineBuffer) ou qu'une réponse attend l'envoi
+// (SendQueue), et le rend dès que c'est vidé. Les morceaux rendus sont
+// réutilisés en LIFO ; au-delà de MAX_SPARE, ils retournent au système.
+// Les demandes plus grandes (lignes retenues par le limiteur, longues
+// réponses) sont allouées à la taille exacte, mais comptées ici aussi.
+// Un seul thread (celui du shard) : pas de verrou.
+class BufferPool {
+public:
+	static const size_t CHUNK_SIZE = 1024;
+	static const size_t MAX_SPARE = 1024;
+	// Zone commune où le shard lit les sockets avant de découper les lignes
+	static const size_t SCRATCH_SIZE = 16384;
+
+	BufferPool();
+	~BufferPool();
+
+	// Taille réellement réservée pour une demande de `size` octets
+	static size_t sizeFor(size_t size) { return size <= CHUNK_SIZE ? CHUNK_SIZE : size; }
+
+	void* allocate(size_t size);
+	// `size` : la même demande qu'à allocate() (ou sizeFor() de celle-ci)
+	void release(void* block, size_t size);
+
+	char* scratch() { return area; }
+
+	// Octets prêtés aux connexions, et gardés en réserve
+	size_t borrowedBytes() const { return borrowed; }
+	size_t spareBytes() const { return spare.size() * CHUNK_SIZE; }
+
+private:
+	std::vector<void*> spare;
+	size_t borrowed;
+	char* area;
+
+	BufferPool(const BufferPool&);
+	BufferPool& operator=(const BufferPool&);
+};
+
+#endif // BUFFERPOOL_HPP
@@ -0,0 +1,27 @@
+#include "casemap.hpp"
+
+std::string ircFold(const StrView& name) {
+	std::string folded(name.ptr, name.len);
+	for (size_t i = 0; i < folded.size(); ++i)
+		folded[i] = ircLower(folded[i]);
+	return folded;
+}
+
+bool ircEquals(const StrView& a, const StrView& b) {
+	if (a.len != b.len)
+		return false;
+	for (size_t i = 0; i < a.len; ++i) {
+		if (ircLower(a.ptr[i]) != ircLower(b.ptr[i]))
+			return false;
+	}
+	return true;
+}
+
+size_t ircHash(const StrView& name) {
+	size_t h = static_cast<size_t>(2166136261u);
+	for (size_t i = 0; i < name.len; ++i) {
+		h ^= static_cast<unsigned char>(ircLower(name.ptr[i]));
+		h *= static_cast<size_t>(16777619u);
+	}
+	return h;
+}
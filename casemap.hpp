@@ -0,0 +1,26 @@
+#ifndef CASEMAP_HPP
+#define CASEMAP_HPP
+
+#include <string>
+#include "strview.hpp"
+
+// Casemapping rfc1459 : A-Z [ ] \ ^ équivalent à a-z { } | ~
+inline char ircLower(char c) {
+	if ((c >= 'A' && c <= 'Z') || c == '[' || c == ']' || c == '\\')
+		return static_cast<char>(c + 32);
+	if (c == '^')
+		return '~';
+	return c;
+}
+
+std::string ircFold(const StrView& name);
+bool ircEquals(const StrView& a, const StrView& b);
+// Hash FNV-1a calculé sur la forme repliée
+size_t ircHash(const StrView& name);
+
+// Nom de canal (#, &) : jamais un pseudo, les deux partageant NameTable
+inline bool isChannelName(const StrView& name) {
+	return name.len != 0 && (name.ptr[0] == '#' || name.ptr[0] == '&');
+}
+
+#endif // CASEMAP_HPP
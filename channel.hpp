@@ -0,0 +1,27 @@
+#ifndef CHANNEL_HPP
+#define CHANNEL_HPP
+
+#include <set>
+#include <string>
+#include "shard.hpp"
+
+struct Channel {
+	std::string name;
+	MemberModes clients;     // Membres et leurs modes (MEMBER_OP, MEMBER_VOICE)
+	MemberList members;      // Dernière liste publiée de `clients`
+	bool inviteOnly;         // Mode `i` : invitation seulement
+	bool topicRestricted;    // Mode `t` : sujet restreint aux opérateurs
+	std::string password;    // Mode `k` : mot de passe du canal
+	int userLimit;           // Mode `l` : limite d’utilisateurs
+	std::string topic;       // Sujet du canal
+
+	Channel() : inviteOnly(false), topicRestricted(false), userLimit(-1) {}
+	Channel(const std::string& name) : name(name), inviteOnly(false), topicRestricted(false), userLimit(-1) {}
+
+	bool hasMode(ClientId id, unsigned char mode) const {
+		MemberModes::const_iterator it = clients.find(id);
+		return it != clients.end() && (it->second & mode);
+	}
+};
+
+#endif // CHANNEL_HPP
@@ -0,0 +1,81 @@
+#ifndef CLIENT_HPP
+#define CLIENT_HPP
+
+#include <string>
+#include <stdint.h>
+#include "linebuffer.hpp"
+#include "nametable.hpp"
+#include "sendqueue.hpp"
+#include "timerwheel.hpp"
+
+class BufferPool;
+struct ServerLink;
+
+// Données lues seulement à l'enregistrement, au QUIT et au NICK : gardées
+// hors de Client pour que le chemin chaud (lecture, dispatch, envoi) tienne
+// dans moins de lignes de cache
+struct ClientProfile {
+	std::string username;
+	std::string realname;
+	// Canaux rejoints, par entrée internée épinglée. Seul le shard du client
+	// l'écrit : un KICK venu d'ailleurs n'y touche pas, l'ensemble peut donc
+	// contenir des canaux déjà quittés.
+	ChannelSet channels;
+};
+
+// Capacités IRCv3 acceptées par CAP REQ (Client::caps)
+enum ClientCap {
+	CAP_SERVER_TIME = 1,    // server-time : tag time= sur l'historique rejoué
+	CAP_MESSAGE_TAGS = 2,   // message-tags : tag msgid=
+	CAP_BATCH = 4,          // batch : réponse de CHATHISTORY encadrée par BATCH
+	CAP_CHATHISTORY = 8     // draft/chathistory
+};
+
+// Connexion d'un client, allouée par ClientTable et jamais déplacée
+struct Client {
+	// Ajouté au fd pour former l'id de inputTimer dans la roue
+	static const int INPUT_TIMER = 1 << 30;
+
+	// Champs chauds : consultés à chaque lecture ou envoi
+	int fd;
+	uint32_t generation;   // Distingue les connexions successives sur un même fd
+	bool registered;       // Indique si le client est entièrement authentifié
+	bool closing;          // À fermer au prochain passage de flushPendingClients()
+	bool flushScheduled;   // Déjà présent dans Server::pendingFlush
+	bool wantWrite;        // POLLOUT activé (le socket était plein)
+	bool sendInFlight;     // Envoi asynchrone (io_uring) en attente de complétion
+	bool pingSent;         // PING envoyé, réponse attendue
+	bool readable;         // Socket pas encore lu jusqu'à EAGAIN (budget épuisé)
+	bool runQueued;        // Déjà présent dans Server::runQueue
+	uint64_t lastActivity; // Dernier trafic reçu (ms, horloge monotone)
+	uint64_t floodClock;   // Limiteur d'entrée : date (ms) où le crédit de lignes sera plein
+	std::string nickname;
+	std::string prefix;    // Source de ses messages, ":pseudo!utilisateur@hôte" (Server::updatePrefix)
+	LineBuffer recvbuf;    // Données reçues, découpées en lignes
+	SendQueue sendq;       // Réponses en attente d'envoi
+	Timer timer;           // Prochaine échéance PING / délai d'inactivité
+	Timer inputTimer;      // Reprise des lignes retenues par le limiteur
+
+	// Champs froids
+	bool is_authenticated;
+	bool passReceived;     // Pour vérifier si le mot de passe a été reçu
+	bool nickReceived;     // Pour vérifier si le pseudo (NICK) a été reçu
+	bool userReceived;     // Pour vérifier si le nom d'utilisateur (USER) a été reçu
+	unsigned caps;         // ClientCap négociées
+	const InternedName* nickEntry; // Entrée du pseudo porté (claimNick), comparée par adresse
+	ClientProfile* profile;
+	ServerLink* link;      // Connexion d'un serveur voisin (shard 0), NULL pour un utilisateur
+
+	Client(int fd, uint32_t generation, ClientProfile* profile, BufferPool* buffers)
+		: fd(fd), generation(generation), registered(false), closing(false), flushScheduled(false),
+		  wantWrite(false), sendInFlight(false), pingSent(false), readable(false), runQueued(false), lastActivity(0), floodClock(0),
+		  recvbuf(buffers), sendq(buffers), timer(fd), inputTimer(fd | INPUT_TIMER),
+		  is_authenticated(false), passReceived(false), nickReceived(false), userReceived(false),
+		  caps(0), nickEntry(NULL), profile(profile), link(NULL) {}
+
+private:
+	Client(const Client&);
+	Client& operator=(const Client&);
+};
+
+#endif // CLIENT_HPP
@@ -0,0 +1,86 @@
+#include "clienttable.hpp"
+#include <set>
+#include <string>
+
+// Octets alloués par une chaîne en dehors d'elle-même (0 si elle tient dans
+// son tampon interne)
+static size_t heapBytes(const std::string& text) {
+	const char* self = reinterpret_cast<const char*>(&text);
+	if (text.data() >= self && text.data() < self + sizeof(text))
+		return 0;
+	return text.capacity() + 1;
+}
+
+ClientTable::ClientTable() {}
+
+ClientTable::~ClientTable() {
+	for (size_t fd = 0; fd < slots.size(); ++fd) {
+		if (slots[fd].client)
+			erase(static_cast<int>(fd));
+	}
+}
+
+Client* ClientTable::find(int fd) const {
+	if (fd < 0 || static_cast<size_t>(fd) >= slots.size())
+		return NULL;
+	return slots[fd].client;
+}
+
+Client& ClientTable::insert(int fd) {
+	if (static_cast<size_t>(fd) >= slots.size())
+		slots.resize(fd + 1);
+	Slot& slot = slots[fd];
+	++slot.generation;
+	slot.client = clients.create(fd, slot.generation, profiles.create(), &bufferPool);
+	return *slot.client;
+}
+
+void ClientTable::setGeneration(int fd, uint32_t generation) {
+	if (static_cast<size_t>(fd) >= slots.size())
+		slots.resize(fd + 1);
+	slots[fd].generation = generation;
+}
+
+Client& ClientTable::restore(int fd) {
+	Slot& slot = slots[fd];
+	slot.client = clients.create(fd, slot.generation, profiles.create(), &bufferPool);
+	return *slot.client;
+}
+
+void ClientTable::erase(int fd) {
+	Client* client = find(fd);
+	if (client == NULL)
+		return;
+	profiles.destroy(client->profile);
+	clients.destroy(client);
+	slots[fd].client = NULL;
+}
+
+uint32_t ClientTable::generation(int fd) const {
+	if (fd < 0 || static_cast<size_t>(fd) >= slots.size())
+		return 0;
+	return slots[fd].generation;
+}
+
+size_t ClientTable::size() const {
+	return clients.size();
+}
+
+int ClientTable::fdLimit() const {
+	return static_cast<int>(slots.size());
+}
+
+size_t ClientTable::baseMemory() {
+	return sizeof(Client) + sizeof(ClientProfile) + sizeof(Slot);
+}
+
+size_t ClientTable::memoryUsage(const Client& client) const {
+	// Nœud d'arbre d'un std::set : trois liens, la couleur, la valeur
+	static const size_t SET_NODE = 4 * sizeof(void*) + sizeof(InternedName*);
+
+	size_t total = baseMemory() + heapBytes(client.nickname);
+	const ClientProfile& profile = *client.profile;
+	total += heapBytes(profile.username) + heapBytes(profile.realname);
+	total += profile.channels.size() * SET_NODE;
+	return total + client.recvbuf.memoryUsage() + client.sendq.memoryUsage();
+}
@@ -0,0 +1,59 @@
+#ifndef CLIENTTABLE_HPP
+#define CLIENTTABLE_HPP
+
+#include <vector>
+#include <stdint.h>
+#include "bufferpool.hpp"
+#include "client.hpp"
+#include "pool.hpp"
+
+// Connexions d'un shard, indexées directement par fd : une recherche est un
+// accès à un tableau, sans parcours d'arbre. Chaque case garde une
+// génération incrémentée à chaque nouvelle connexion sur ce fd, ce qui
+// permet de reconnaître un ClientId devenu obsolète après réutilisation
+// du numéro. Client et ClientProfile viennent de pools par blocs, les
+// tampons d'entrée et de sortie du BufferPool du shard.
+class ClientTable {
+public:
+	ClientTable();
+	~ClientTable();
+
+	// NULL si aucun client n'occupe ce fd
+	Client* find(int fd) const;
+	// Le fd doit être libre
+	Client& insert(int fd);
+	void erase(int fd);
+	// Redémarrage à chaud : fixe la génération d'une case, puis restore()
+	// y recrée le client sans l'incrémenter
+	void setGeneration(int fd, uint32_t generation);
+	Client& restore(int fd);
+	// Génération du client actuel (ou du prochain) sur ce fd
+	uint32_t generation(int fd) const;
+	size_t size() const;
+	// Un de plus que le plus grand fd jamais inséré
+	int fdLimit() const;
+
+	BufferPool& buffers() { return bufferPool; }
+	// Mémoire tenue par une connexion : Client, ClientProfile, case de la
+	// table, chaînes et tampons empruntés
+	size_t memoryUsage(const Client& client) const;
+	// Partie fixe, la même pour chaque connexion
+	static size_t baseMemory();
+
+private:
+	struct Slot {
+		Client* client;
+		uint32_t generation;
+		Slot() : client(NULL), generation(0) {}
+	};
+
+	std::vector<Slot> slots;
+	BufferPool bufferPool;
+	Pool<Client> clients;
+	Pool<ClientProfile> profiles;
+
+	ClientTable(const ClientTable&);
+	ClientTable& operator=(const ClientTable&);
+};
+
+#endif // CLIENTTABLE_HPP
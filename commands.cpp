@@ -0,0 +1,484 @@
+#include "server.hpp"
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+/*
+ * Table des commandes : nom, gestionnaire, enregistrement requis,
+ * nombre minimal de paramètres. L'ordre doit suivre l'énumération CommandId.
+ */
+enum CommandId {
+	CMD_CAP, CMD_PASS, CMD_NICK, CMD_USER, CMD_PING, CMD_PONG, CMD_QUIT,
+	CMD_JOIN, CMD_PART, CMD_KICK, CMD_INVITE, CMD_MODE, CMD_TOPIC, CMD_PRIVMSG,
+	CMD_STATS, CMD_CHATHISTORY
+};
+
+const Server::CommandSpec Server::commandTable[] = {
+	{ "CAP",     &Server::cmdCap,     false, 1 },
+	{ "PASS",    &Server::cmdPass,    false, 1 },
+	{ "NICK",    &Server::cmdNick,    false, 1 },
+	{ "USER",    &Server::cmdUser,    false, 4 },
+	{ "PING",    &Server::cmdPing,    false, 1 },
+	{ "PONG",    &Server::cmdPong,    false, 0 },
+	{ "QUIT",    &Server::cmdQuit,    false, 0 },
+	{ "JOIN",    &Server::cmdJoin,    true,  1 },
+	{ "PART",    &Server::cmdPart,    true,  1 },
+	{ "KICK",    &Server::cmdKick,    true,  2 },
+	{ "INVITE",  &Server::cmdInvite,  true,  2 },
+	{ "MODE",    &Server::cmdMode,    true,  2 },
+	{ "TOPIC",   &Server::cmdTopic,   true,  1 },
+	{ "PRIVMSG", &Server::cmdPrivmsg, true,  2 },
+	{ "STATS",   &Server::cmdStats,   true,  0 },
+	{ "CHATHISTORY", &Server::cmdChathistory, true, 1 },
+};
+
+const size_t Server::commandCount = sizeof(commandTable) / sizeof(commandTable[0]);
+
+// Comparaison insensible à la casse ASCII ; `upper` est déjà en majuscules
+static bool equalsUpper(const StrView& s, const char* upper) {
+	for (size_t i = 0; i < s.len; ++i) {
+		char c = s.ptr[i];
+		if (c >= 'a' && c <= 'z')
+			c -= 'a' - 'A';
+		if (c != upper[i])
+			return false;
+	}
+	return upper[s.len] == '\0';
+}
+
+static char upperFirst(const StrView& s) {
+	char c = s.ptr[0];
+	return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+}
+
+// Recherche par longueur puis première lettre : au plus une ou deux
+// comparaisons de chaînes par ligne, quelle que soit la taille de la table
+const Server::CommandSpec* Server::findCommand(const StrView& name) {
+	int id = -1;
+	switch (name.len) {
+	case 3:
+		id = CMD_CAP;
+		break;
+	case 4:
+		switch (upperFirst(name)) {
+		case 'P':
+			if (equalsUpper(name, "PING"))
+				return &commandTable[CMD_PING];
+			if (equalsUpper(name, "PONG"))
+				return &commandTable[CMD_PONG];
+			if (equalsUpper(name, "PART"))
+				return &commandTable[CMD_PART];
+			id = CMD_PASS;
+			break;
+		case 'N': id = CMD_NICK; break;
+		case 'U': id = CMD_USER; break;
+		case 'Q': id = CMD_QUIT; break;
+		case 'J': id = CMD_JOIN; break;
+		case 'K': id = CMD_KICK; break;
+		case 'M': id = CMD_MODE; break;
+		}
+		break;
+	case 5:
+		id = upperFirst(name) == 'S' ? CMD_STATS : CMD_TOPIC;
+		break;
+	case 6:
+		id = CMD_INVITE;
+		break;
+	case 7:
+		id = CMD_PRIVMSG;
+		break;
+	case 11:
+		id = CMD_CHATHISTORY;
+		break;
+	}
+	if (id < 0 || !equalsUpper(name, commandTable[id].name))
+		return NULL;
+	return &commandTable[id];
+}
+
+/*Implementation IRC*/
+
+// Fonction principale de traitement des commandes
+void Server::processCommand(int client_fd, const StrView &line) {
+	Client *found = connections.find(client_fd);
+	if (found == NULL) {
+		LOG_ERROR(LOG_IRC, "client non enregistré");
+		return;
+	}
+	Client &client = *found;
+	uint64_t parseStarted = traceId ? metricNowNs() : 0;
+
+	// Vérifier l'encodage UTF-8 et relever les espaces en une passe
+	LineScan scan;
+	if (!scanLine(line, scan)) {
+		reply(client, ERR_UNKNOWNERROR);
+		return;
+	}
+
+	IrcMessage msg;
+	if (!parseMessage(line, scan, msg))
+		return;
+	IRC_PROBE3(parse, client_fd, msg.command.ptr, msg.command.len);
+	if (traceId)
+		Tracer::record(traceId, TRACE_PARSE, parseStarted, metricNowNs());
+	if (client.link) {
+		processLinkMessage(*client.link, line, msg);
+		return;
+	}
+
+	const CommandSpec *spec = findCommand(msg.command);
+	if (spec == NULL) {
+		metricAdd(metrics->unknownCommands);
+		if (client.registered) {
+			// Commande inconnue
+			reply(client, ERR_UNKNOWNCOMMAND, msg.command);
+			LOG_DEBUG(LOG_IRC, "Commande inconnue reçue de " << client_fd << ": " << msg.command);
+		} else {
+			reply(client, ERR_NOTREGISTERED);
+		}
+		return;
+	}
+	if (spec->needsRegistration && !client.registered) {
+		reply(client, ERR_NOTREGISTERED);
+		return;
+	}
+	if (msg.paramCount < spec->minParams) {
+		reply(client, ERR_NEEDMOREPARAMS, std::string(spec->name));
+		return;
+	}
+	size_t index = static_cast<size_t>(spec - commandTable);
+	metricAdd(metrics->commands[index]);
+	uint64_t started = metricNowNs();
+	(this->*(spec->handler))(client, msg);
+	uint64_t done = metricNowNs();
+	metricRecord(metrics->commandLatency[index], done - started);
+	IRC_PROBE3(dispatch, client_fd, index, done - started);
+	if (traceId)
+		Tracer::record(traceId, TRACE_DISPATCH, started, done, index);
+}
+
+// Termine l'enregistrement dès que PASS, NICK et USER ont été reçus
+void Server::tryRegister(Client &client) {
+	if (client.registered || !client.nickReceived || !client.userReceived)
+		return;
+	if (!client.passReceived && !serverPassword.empty())
+		return;
+	client.registered = true;
+	client.is_authenticated = true;
+	metricAdd(metrics->registrations);
+	sendWelcomeMessages(client, client.fd);
+}
+
+// Capacités proposées par CAP LS ; draft/chathistory seulement si
+// l'historique est activé
+static const struct {
+	const char *name;
+	unsigned bit;
+} capabilities[] = {
+	{ "batch",             CAP_BATCH },
+	{ "message-tags",      CAP_MESSAGE_TAGS },
+	{ "server-time",       CAP_SERVER_TIME },
+	{ "draft/chathistory", CAP_CHATHISTORY },
+};
+
+static unsigned findCapability(const std::string &name) {
+	for (size_t i = 0; i < sizeof(capabilities) / sizeof(capabilities[0]); ++i) {
+		if (name == capabilities[i].name)
+			return capabilities[i].bit;
+	}
+	return 0;
+}
+
+// Commande CAP pour la négociation des capacités
+void Server::cmdCap(Client &client, const IrcMessage &msg) {
+	const StrView &subcommand = msg.params[0];
+	bool history = shared->history().enabled();
+
+	if (subcommand == "LS" || subcommand == "LIST") {
+		std::string list;
+		for (size_t i = 0; i < sizeof(capabilities) / sizeof(capabilities[0]); ++i) {
+			if ((capabilities[i].bit == CAP_CHATHISTORY && !history)
+				|| (subcommand == "LIST" && !(client.caps & capabilities[i].bit)))
+				continue;
+			if (!list.empty())
+				list += ' ';
+			list += capabilities[i].name;
+		}
+		ReplyLine line;
+		line << serverPrefix << " CAP * " << subcommand << " :" << list;
+		queueReply(client.fd, line.end());
+	} else if (subcommand == "REQ") {
+		// Tout ou rien : une seule capacité inconnue refuse la requête
+		std::string capRequested = msg.paramCount > 1 ? msg.params[1].str() : "";
+		std::istringstream names(capRequested);
+		std::string name;
+		unsigned enable = 0, disable = 0;
+		bool known = true;
+		while (names >> name && known) {
+			bool remove = name[0] == '-';
+			unsigned bit = findCapability(remove ? name.substr(1) : name);
+			if (bit == 0 || (bit == CAP_CHATHISTORY && !history))
+				known = false;
+			(remove ? disable : enable) |= bit;
+		}
+		bool accepted = known && (enable != 0 || disable != 0);
+		if (accepted)
+			client.caps = (client.caps | enable) & ~disable;
+		ReplyLine line;
+		line << serverPrefix << (accepted ? " CAP * ACK :" : " CAP * NAK :") << capRequested;
+		queueReply(client.fd, line.end());
+	} else if (subcommand == "END") {
+		ReplyLine line;
+		line << serverPrefix << " CAP * END";
+		queueReply(client.fd, line.end());
+	}
+}
+
+void Server::cmdPass(Client &client, const IrcMessage &msg) {
+	if (client.registered) {
+		reply(client, ERR_ALREADYREGISTERED);
+		return;
+	}
+	if (!checkPassword(client.fd, msg.params[0].str())) {
+		reply(client, ERR_PASSWDMISMATCH);
+		return;
+	}
+	client.passReceived = true;
+}
+
+void Server::cmdNick(Client &client, const IrcMessage &msg) {
+	if (!client.passReceived && !serverPassword.empty()) {
+		return;
+	}
+	if (msg.params[0].empty()) {
+		reply(client, ERR_NONICKNAMEGIVEN);
+		return;
+	}
+	if (isChannelName(msg.params[0])) {
+		reply(client, ERR_ERRONEUSNICKNAME, msg.params[0]);
+		return;
+	}
+	if (!setNickname(client.fd, msg.params[0].str()))
+		return;
+	client.nickReceived = true;
+	tryRegister(client);
+}
+
+void Server::cmdUser(Client &client, const IrcMessage &msg) {
+	if (client.registered) {
+		reply(client, ERR_ALREADYREGISTERED);
+		return;
+	}
+	setUser(client.fd, msg.params[0].str(), msg.params[3].str());
+	client.userReceived = true;
+	tryRegister(client);
+}
+
+void Server::cmdPing(Client &client, const IrcMessage &msg) {
+	// Réponse au PING
+	ReplyLine line;
+	line << serverPrefix << " PONG " << serverName << " :" << msg.params[0];
+	queueReply(client.fd, line.end());
+}
+
+void Server::cmdPong(Client &client, const IrcMessage &msg) {
+	(void) client;
+	(void) msg;
+}
+
+void Server::cmdQuit(Client &client, const IrcMessage &msg) {
+	removeClient(client.fd, msg.paramCount > 0 ? "Quit: " + msg.params[0].str() : "Client Quit");
+}
+
+void Server::cmdJoin(Client &client, const IrcMessage &msg) {
+	joinChannel(client.fd, msg.params[0].str());
+}
+
+void Server::cmdPart(Client &client, const IrcMessage &msg) {
+	partChannel(client.fd, msg.params[0].str());
+}
+
+void Server::cmdKick(Client &client, const IrcMessage &msg) {
+	kickUser(client.fd, msg.params[0].str(), msg.params[1].str());
+}
+
+void Server::cmdInvite(Client &client, const IrcMessage &msg) {
+	// INVITE <pseudo> <canal>
+	inviteUser(client.fd, msg.params[1].str(), msg.params[0].str());
+}
+
+void Server::cmdMode(Client &client, const IrcMessage &msg) {
+	if (msg.paramCount > 2) {
+		setChannelMode(client.fd, msg.params[0].str(), msg.params[1].str(), msg.params[2].str());
+	} else {
+		setChannelMode(client.fd, msg.params[0].str(), msg.params[1].str());
+	}
+}
+
+void Server::cmdTopic(Client &client, const IrcMessage &msg) {
+	std::string topic = msg.paramCount > 1 ? msg.params[1].str() : "";
+	topicChannel(client.fd, msg.params[0].str(), topic);
+}
+
+void Server::cmdPrivmsg(Client &client, const IrcMessage &msg) {
+	sendMessage(client.fd, msg.params[0], msg.params[1]);
+}
+
+// STATS [m|u|z] : compteurs de tous les shards, lus sans verrou.
+// m : commandes (212), u : uptime (242), z (par défaut) : compteurs du
+// serveur et percentiles (249)
+void Server::cmdStats(Client &client, const IrcMessage &msg) {
+	char query = (msg.paramCount > 0 && !msg.params[0].empty()) ? msg.params[0][0] : 'z';
+	MetricsRegistry &registry = shared->metrics();
+	ShardMetrics total;
+	registry.total(total);
+
+	if (query == 'm') {
+		for (size_t i = 0; i < commandCount; ++i) {
+			if (total.commands[i] == 0)
+				continue;
+			std::ostringstream count;
+			count << total.commands[i];
+			reply(client, RPL_STATSCOMMANDS, std::string(commandTable[i].name), count.str());
+		}
+	} else if (query == 'u') {
+		time_t up = time(NULL) - registry.startTime();
+		char uptime[64];
+		snprintf(uptime, sizeof(uptime), "%ld days %ld:%02ld:%02ld", static_cast<long>(up / 86400),
+			static_cast<long>(up / 3600 % 24), static_cast<long>(up / 60 % 60), static_cast<long>(up % 60));
+		reply(client, RPL_STATSUPTIME, std::string(uptime));
+	} else if (query == 'l') {
+		// Connexion du demandeur seulement : pseudo[fd] file d'envoi, entrée
+		// en attente, mémoire. Les autres connexions ne sont visibles qu'en
+		// agrégat (STATS z, --metrics-port).
+		std::ostringstream name, sendq, recvq, memory;
+		name << (client.nickname.empty() ? "*" : client.nickname) << "[" << client.fd << "]";
+		sendq << client.sendq.size();
+		recvq << client.recvbuf.pending();
+		memory << connections.memoryUsage(client);
+		reply(client, RPL_STATSLINKINFO, name.str(), sendq.str(), recvq.str(), memory.str());
+	} else if (query == 'z') {
+		std::vector<std::string> lines;
+		std::ostringstream line;
+		line << "connexions " << total.connectionsAccepted - total.connectionsClosed << " acceptées "
+			<< total.connectionsAccepted << " enregistrées " << total.registrations;
+		lines.push_back(line.str());
+		line.str("");
+		line << "octets reçus " << total.bytesIn << " envoyés " << total.bytesOut;
+		lines.push_back(line.str());
+		line.str("");
+		line << "fermetures sendq " << total.sendqDropped << " recvq " << total.recvqDropped
+			<< " ping " << total.pingTimeouts << " commandes inconnues " << total.unknownCommands;
+		lines.push_back(line.str());
+		line.str("");
+		line << "entrée retenue " << total.inputThrottled << " fois, budget de lecture épuisé " << total.readBudgetExhausted << " fois";
+		lines.push_back(line.str());
+		line.str("");
+		uint64_t open = total.connectionsAccepted - total.connectionsClosed;
+		line << "mémoire des connexions " << total.connectionMemory << " octets (" << (open ? total.connectionMemory / open : 0)
+			<< " par connexion), tampons " << total.bufferBytes << " empruntés " << total.bufferSpare << " en réserve";
+		lines.push_back(line.str());
+		line.str("");
+		line << "file d'envoi p50 " << total.sendqDepth.percentile(0.5) << " p99 "
+			<< total.sendqDepth.percentile(0.99) << " octets";
+		lines.push_back(line.str());
+		line.str("");
+		line << "diffusion p50 " << total.fanout.percentile(0.5) << " p99 "
+			<< total.fanout.percentile(0.99) << " destinataires";
+		lines.push_back(line.str());
+		for (size_t i = 0; i < commandCount; ++i) {
+			const MetricHistogram &latency = total.commandLatency[i];
+			if (latency.count == 0)
+				continue;
+			line.str("");
+			line << "latence " << commandTable[i].name << " p50 " << latency.percentile(0.5) / 1000
+				<< " p99 " << latency.percentile(0.99) / 1000 << " µs (" << latency.count << ")";
+			lines.push_back(line.str());
+		}
+		for (size_t i = 0; i < lines.size(); ++i)
+			reply(client, RPL_STATSDEBUG, StrView(&query, 1), lines[i]);
+	}
+	reply(client, RPL_ENDOFSTATS, StrView(&query, 1));
+}
+
+// CHATHISTORY LATEST|BEFORE|AFTER <canal> <référence> <limite> (IRCv3
+// draft/chathistory). Réservé aux membres du canal ; la réponse vient de
+// l'anneau partagé, sans passer par les autres shards.
+void Server::cmdChathistory(Client &client, const IrcMessage &msg) {
+	ChannelHistory &history = shared->history();
+	std::string subcommand = msg.params[0].str();
+	for (size_t i = 0; i < subcommand.size(); ++i)
+		subcommand[i] = static_cast<char>(std::toupper(static_cast<unsigned char>(subcommand[i])));
+
+	if (subcommand != "LATEST" && subcommand != "BEFORE" && subcommand != "AFTER") {
+		fail(client, "CHATHISTORY", "UNKNOWN_COMMAND", "Unknown subcommand", subcommand);
+		return;
+	}
+	HistoryRef ref;
+	int limit = msg.paramCount >= 4 ? std::atoi(msg.params[3].str().c_str()) : 0;
+	if (msg.paramCount < 4 || !ref.parse(msg.params[2]) || limit < 1
+		|| (ref.kind == HistoryRef::NONE && subcommand != "LATEST")) {
+		fail(client, "CHATHISTORY", "INVALID_PARAMS", "Invalid parameters", subcommand);
+		return;
+	}
+	std::string target = msg.params[1].str();
+	MemberList *members = channelMembers.find(target);
+	if (!history.enabled() || members == NULL || !(*members)->contains(idOf(client.fd))) {
+		fail(client, "CHATHISTORY", "INVALID_TARGET", "Messages could not be retrieved", subcommand, target);
+		return;
+	}
+
+	size_t count = static_cast<size_t>(limit);
+	if (count > ChannelHistory::MAX_REPLAY)
+		count = ChannelHistory::MAX_REPLAY;
+	std::vector<HistoryEntry> entries;
+	if (subcommand == "LATEST")
+		history.latest(target, ref, count, entries);
+	else if (subcommand == "BEFORE")
+		history.before(target, ref, count, entries);
+	else
+		history.after(target, ref, count, entries);
+	replayHistory(client, target, entries);
+}
+
+// Sans tag négocié, la ligne conservée part telle quelle (même tampon) ;
+// sinon elle est préfixée des tags batch, time et msgid demandés
+void Server::replayHistory(Client &client, const std::string &target, const std::vector<HistoryEntry> &entries) {
+	ReplyLine id;
+	if (client.caps & CAP_BATCH) {
+		id << 'h' << static_cast<uint64_t>(shardId) << '-' << ++nextBatch;
+		ReplyLine line;
+		line << serverPrefix << " BATCH +" << StrView(id.data(), id.size()) << " chathistory " << target;
+		queueReply(client.fd, line.end());
+	}
+	StrView batch(id.data(), id.size());
+	for (size_t i = 0; i < entries.size(); ++i) {
+		const HistoryEntry &entry = entries[i];
+		if (batch.empty() && !(client.caps & (CAP_SERVER_TIME | CAP_MESSAGE_TAGS))) {
+			queueReply(client.fd, entry.line);
+			continue;
+		}
+		// Les tags précèdent la ligne conservée, mise en file telle quelle
+		ReplyLine tags;
+		char separator = '@';
+		if (!batch.empty()) {
+			tags << separator << "batch=" << batch;
+			separator = ';';
+		}
+		if (client.caps & CAP_SERVER_TIME) {
+			tags << separator << "time=" << ChannelHistory::formatTime(entry.time);
+			separator = ';';
+		}
+		if (client.caps & CAP_MESSAGE_TAGS)
+			tags << separator << "msgid=" << entry.msgid;
+		tags << ' ';
+		queueReply(client.fd, tags);
+		queueReply(client.fd, entry.line);
+	}
+	if (!batch.empty()) {
+		ReplyLine line;
+		line << serverPrefix << " BATCH -" << batch;
+		queueReply(client.fd, line.end());
+	}
+}
@@ -0,0 +1,134 @@
+#include "config.hpp"
+#include "shard.hpp"
+#include "linebuffer.hpp"
+#include <cstdlib>
+
+bool ServerConfig::parseOption(const std::string& arg) {
+	if (arg.compare(0, 2, "--") != 0)
+		return false;
+	std::string::size_type eq = arg.find('=');
+	if (eq == std::string::npos)
+		return false;
+	std::string key = arg.substr(2, eq - 2);
+	std::string value = arg.substr(eq + 1);
+
+	if (key == "poller") {
+		if (value != "auto" && value != "uring" && value != "epoll" && value != "select")
+			return false;
+		poller = value;
+		return true;
+	}
+	if (key == "threads") {
+		int n = std::atoi(value.c_str());
+		if (n < 1 || static_cast<size_t>(n) > MAX_SHARDS)
+			return false;
+		threads = static_cast<size_t>(n);
+		return true;
+	}
+	if (key == "ping-interval" || key == "ping-timeout") {
+		int n = std::atoi(value.c_str());
+		if (n < 1)
+			return false;
+		(key == "ping-interval" ? pingInterval : pingTimeout) = static_cast<unsigned>(n);
+		return true;
+	}
+	if (key == "flood-burst" || key == "flood-rate") {
+		int n = std::atoi(value.c_str());
+		if (n < (key == "flood-burst" ? 1 : 0) || n > 1000)
+			return false;
+		(key == "flood-burst" ? floodBurst : floodRate) = static_cast<unsigned>(n);
+		return true;
+	}
+	if (key == "recvq" || key == "sendq") {
+		long n = std::atol(value.c_str());
+		if (n < static_cast<long>(LineBuffer::MAX_LINE) || n > (1L << 30))
+			return false;
+		(key == "recvq" ? recvq : sendq) = static_cast<size_t>(n);
+		return true;
+	}
+	if (key == "name") {
+		if (value.empty() || value.find_first_of(" :,!@*") != std::string::npos)
+			return false;
+		name = value;
+		return true;
+	}
+	if (key == "link-port") {
+		int n = std::atoi(value.c_str());
+		if (n < 1 || n > 65535)
+			return false;
+		linkPort = n;
+		return true;
+	}
+	if (key == "link-password") {
+		if (value.empty() || value.find(' ') != std::string::npos)
+			return false;
+		linkPassword = value;
+		return true;
+	}
+	if (key == "connect") {
+		std::string::size_type colon = value.rfind(':');
+		if (colon == std::string::npos || colon == 0 || std::atoi(value.c_str() + colon + 1) < 1)
+			return false;
+		connect.push_back(value);
+		return true;
+	}
+	if (key == "log-level") {
+		if (value != "debug" && value != "info" && value != "warn" && value != "error")
+			return false;
+		logLevel = value;
+		return true;
+	}
+	if (key == "log-file") {
+		logFile = value;
+		return true;
+	}
+	if (key == "log-categories") {
+		logCategories = value;
+		return true;
+	}
+	if (key == "history") {
+		int n = std::atoi(value.c_str());
+		if (n < 0 || n > 100000 || (n == 0 && value != "0"))
+			return false;
+		history = static_cast<size_t>(n);
+		return true;
+	}
+	if (key == "history-dir") {
+		if (value.empty())
+			return false;
+		historyDir = value;
+		return true;
+	}
+	if (key == "upgrade-fd") {
+		int n = std::atoi(value.c_str());
+		if (n < 3)
+			return false;
+		upgradeFd = n;
+		return true;
+	}
+	if (key == "trace-sample") {
+		int n = std::atoi(value.c_str());
+		if (n < 0 || n > 1000000 || (n == 0 && value != "0"))
+			return false;
+		traceSample = static_cast<unsigned>(n);
+		return true;
+	}
+	if (key == "trace-file") {
+		if (value.empty())
+			return false;
+		traceFile = value;
+		return true;
+	}
+	if (key == "metrics-port") {
+		int n = std::atoi(value.c_str());
+		if (n < 1 || n > 65535)
+			return false;
+		metricsPort = n;
+		return true;
+	}
+	return false;
+}
+
+bool ServerConfig::linking() const {
+	return linkPort != 0 || !connect.empty();
+}
@@ -0,0 +1,42 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <string>
+#include <vector>
+
+// Options de lancement : ./ircserv <port> <password> [--option=valeur ...]
+struct ServerConfig {
+	std::string poller;     // --poller=auto|uring|epoll|select
+	size_t threads;         // --threads=N : nombre de shards (boucles d'événements)
+	unsigned pingInterval;  // --ping-interval=s : PING après ce délai sans trafic
+	unsigned pingTimeout;   // --ping-timeout=s : déconnexion si pas de réponse au PING
+	unsigned floodBurst;    // --flood-burst=N : lignes acceptées d'affilée
+	unsigned floodRate;     // --flood-rate=N : lignes par seconde ensuite (0 : sans limite)
+	size_t recvq;           // --recvq=octets : entrée retenue au-delà : "Excess Flood"
+	size_t sendq;           // --sendq=octets : file d'envoi au-delà : "Max SendQ exceeded"
+	std::string name;       // --name=nom : nom du serveur, unique dans le réseau
+	int linkPort;           // --link-port=N : écoute des serveurs voisins (0 : aucune)
+	std::string linkPassword; // --link-password=mdp : mot de passe des liens, dans les deux sens
+	std::vector<std::string> connect; // --connect=hôte:port (répétable) : voisins à joindre
+	int metricsPort;        // --metrics-port=N : métriques Prometheus sur 127.0.0.1 (0 : désactivé)
+	size_t history;         // --history=N : messages conservés par canal (0, par défaut : pas d'historique)
+	std::string historyDir; // --history-dir=chemin : journal de l'historique (vide : en mémoire seulement)
+	std::string logLevel;   // --log-level=debug|info|warn|error
+	std::string logFile;    // --log-file=chemin (vide : stderr)
+	std::string logCategories; // --log-categories=server,net,irc,channel ou all
+	unsigned traceSample;   // --trace-sample=N : suivi d'une ligne sur N (0 : désactivé, trace.hpp)
+	std::string traceFile;  // --trace-file=chemin : trace Chrome écrite à la sortie
+	int upgradeFd;          // --upgrade-fd=N : ajouté par un redémarrage à chaud (upgrade.hpp)
+
+	ServerConfig() : poller("auto"), threads(1), pingInterval(60), pingTimeout(60), floodBurst(10),
+		floodRate(5), recvq(8192), sendq(1024 * 1024), name("myircserver"),
+		linkPort(0), metricsPort(0), history(0),
+		logLevel("info"), logCategories("all"), traceSample(0), upgradeFd(-1) {}
+
+	// Analyse une option "--cle=valeur", retourne false si inconnue ou invalide
+	bool parseOption(const std::string& arg);
+	// Au moins un lien possible (--link-port ou --connect)
+	bool linking() const;
+};
+
+#endif // CONFIG_HPP
@@ -0,0 +1,67 @@
+#include "histogram.hpp"
+
+static const size_t SUB_COUNT = static_cast<size_t>(1) << LatencyHistogram::SUB_BITS;
+// Valeurs exactes sous SUB_COUNT, puis SUB_COUNT cases par puissance de deux
+static const size_t BUCKETS = (64 - LatencyHistogram::SUB_BITS + 1) * SUB_COUNT;
+
+LatencyHistogram::LatencyHistogram() : buckets(BUCKETS, 0), total(0), sum(0), maxValue(0) {}
+
+size_t LatencyHistogram::bucketOf(uint64_t value) {
+	if (value < SUB_COUNT)
+		return static_cast<size_t>(value);
+	unsigned exponent = 63 - __builtin_clzll(value);
+	unsigned shift = exponent - SUB_BITS;
+	// (value >> shift) est dans [SUB_COUNT, 2 * SUB_COUNT)
+	return (shift + 1) * SUB_COUNT + static_cast<size_t>(value >> shift) - SUB_COUNT;
+}
+
+uint64_t LatencyHistogram::upperBound(size_t bucket) {
+	if (bucket < SUB_COUNT)
+		return bucket;
+	size_t shift = bucket / SUB_COUNT - 1;
+	uint64_t mantissa = bucket % SUB_COUNT + SUB_COUNT;
+	return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+	++buckets[bucketOf(value)];
+	++total;
+	sum += value;
+	if (value > maxValue)
+		maxValue = value;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+	for (size_t i = 0; i < BUCKETS; ++i)
+		buckets[i] += other.buckets[i];
+	total += other.total;
+	sum += other.sum;
+	if (other.maxValue > maxValue)
+		maxValue = other.maxValue;
+}
+
+void LatencyHistogram::clear() {
+	buckets.assign(BUCKETS, 0);
+	total = 0;
+	sum = 0;
+	maxValue = 0;
+}
+
+uint64_t LatencyHistogram::mean() const {
+	return total ? sum / total : 0;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+	if (total == 0)
+		return 0;
+	uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total));
+	if (rank >= total)
+		rank = total - 1;
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKETS; ++i) {
+		seen += buckets[i];
+		if (seen > rank)
+			return upperBound(i) < maxValue ? upperBound(i) : maxValue;
+	}
+	return maxValue;
+}
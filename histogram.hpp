@@ -0,0 +1,37 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <vector>
+#include <stdint.h>
+#include <cstddef>
+
+// Histogramme log-linéaire de durées (en ns) : chaque puissance de deux est
+// découpée en 2^SUB_BITS cases, soit une précision relative d'environ 1,5 %
+// sur toute la plage, pour une taille fixe et un enregistrement en O(1).
+class LatencyHistogram {
+public:
+	static const unsigned SUB_BITS = 6;
+
+	LatencyHistogram();
+
+	void record(uint64_t value);
+	void merge(const LatencyHistogram& other);
+	void clear();
+
+	uint64_t count() const { return total; }
+	uint64_t max() const { return maxValue; }
+	uint64_t mean() const;
+	// Valeur sous laquelle se trouve la fraction `q` (0..1) des mesures
+	uint64_t percentile(double q) const;
+
+private:
+	static size_t bucketOf(uint64_t value);
+	static uint64_t upperBound(size_t bucket);
+
+	std::vector<uint64_t> buckets;
+	uint64_t total;
+	uint64_t sum;
+	uint64_t maxValue;
+};
+
+#endif // HISTOGRAM_HPP
@@ -0,0 +1,576 @@
+#include "history.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/* ************************************************************************** */
+/*                                Références                                  */
+/* ************************************************************************** */
+
+static bool startsWith(const StrView& text, const char* prefix, StrView& rest) {
+	size_t len = std::strlen(prefix);
+	if (text.len < len || std::memcmp(text.ptr, prefix, len) != 0)
+		return false;
+	rest = StrView(text.ptr + len, text.len - len);
+	return true;
+}
+
+bool HistoryRef::parse(const StrView& text) {
+	StrView rest;
+	if (text == "*") {
+		kind = NONE;
+		return true;
+	}
+	if (startsWith(text, "msgid=", rest)) {
+		if (rest.empty() || rest.len > 19)
+			return false;
+		value = 0;
+		for (size_t i = 0; i < rest.len; ++i) {
+			if (rest[i] < '0' || rest[i] > '9')
+				return false;
+			value = value * 10 + static_cast<uint64_t>(rest[i] - '0');
+		}
+		kind = MSGID;
+		return true;
+	}
+	if (startsWith(text, "timestamp=", rest) && ChannelHistory::parseTime(rest, value)) {
+		kind = TIME;
+		return true;
+	}
+	return false;
+}
+
+/* ************************************************************************** */
+/*                                  Anneau                                    */
+/* ************************************************************************** */
+
+HistoryRing::HistoryRing(size_t capacity) : limit(capacity), head(0) {}
+
+void HistoryRing::push(const HistoryEntry& entry) {
+	if (slots.size() < limit) {
+		// Croissance par doublement, sans dépasser `limit`
+		if (slots.size() == slots.capacity())
+			slots.reserve(std::min(limit, std::max(static_cast<size_t>(8), slots.size() * 2)));
+		slots.push_back(entry);
+	} else {
+		slots[head] = entry;   // Écrase le plus ancien
+		head = (head + 1) % limit;
+	}
+}
+
+// Les messages sont rangés par msgid et par date : recherche dichotomique
+static bool entryAfter(const HistoryEntry& entry, const HistoryRef& ref, bool inclusive) {
+	uint64_t key = ref.kind == HistoryRef::MSGID ? entry.msgid : entry.time;
+	return inclusive ? key >= ref.value : key > ref.value;
+}
+
+size_t HistoryRing::firstAfter(const HistoryRef& ref) const {
+	if (ref.kind == HistoryRef::NONE)
+		return 0;
+	size_t lo = 0, hi = size();
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (entryAfter(at(mid), ref, false))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+size_t HistoryRing::firstNotBefore(const HistoryRef& ref) const {
+	if (ref.kind == HistoryRef::NONE)
+		return size();
+	size_t lo = 0, hi = size();
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (entryAfter(at(mid), ref, true))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+/* ************************************************************************** */
+/*                                 Journal                                    */
+/* ************************************************************************** */
+
+static const size_t RECORD_HEADER = 24;
+
+static size_t recordSize(size_t nameLen, size_t lineLen) {
+	return (RECORD_HEADER + nameLen + lineLen + 7) & ~static_cast<size_t>(7);
+}
+
+HistoryLog::HistoryLog() : number(0), map(NULL), used(0), spare(NULL), preparing(false), unmapLater(NULL) {}
+
+HistoryLog::~HistoryLog() {
+	if (map)
+		munmap(map, SEGMENT_SIZE);
+	if (spare)
+		munmap(spare, SEGMENT_SIZE);
+	if (unmapLater)
+		munmap(unmapLater, SEGMENT_SIZE);
+}
+
+std::string HistoryLog::segmentPath(uint64_t n) const {
+	char name[64];
+	snprintf(name, sizeof(name), "/history.%010llu.log", static_cast<unsigned long long>(n));
+	return dir + name;
+}
+
+bool HistoryLog::open(const std::string& path) {
+	dir = path;
+	if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) {
+		LOG_ERROR(LOG_SERVER, "historique : impossible de créer " << dir << " : " << strerror(errno));
+		return false;
+	}
+	DIR* listing = opendir(dir.c_str());
+	if (listing == NULL) {
+		LOG_ERROR(LOG_SERVER, "historique : impossible de lire " << dir << " : " << strerror(errno));
+		return false;
+	}
+	std::vector<uint64_t> numbers;
+	while (struct dirent* file = readdir(listing)) {
+		unsigned long long n;
+		char tail[8];
+		if (sscanf(file->d_name, "history.%llu.%7s", &n, tail) == 2 && std::strcmp(tail, "log") == 0)
+			numbers.push_back(n);
+	}
+	closedir(listing);
+	std::sort(numbers.begin(), numbers.end());
+	for (size_t i = 0; i < numbers.size(); ++i)
+		kept.push_back(segmentPath(numbers[i]));
+
+	number = numbers.empty() ? 1 : numbers.back();
+	if (numbers.empty())
+		kept.push_back(segmentPath(number));
+	map = mapFile(kept.back());
+	if (map == NULL)
+		return false;
+
+	// Reprise à la suite du dernier enregistrement complet
+	used = 0;
+	while (used + RECORD_HEADER <= SEGMENT_SIZE) {
+		uint32_t size;
+		std::memcpy(&size, map + used, sizeof(size));
+		if (size < RECORD_HEADER || used + size > SEGMENT_SIZE)
+			break;
+		used += size;
+	}
+	return true;
+}
+
+// Segment créé (ou agrandi) à SEGMENT_SIZE : les octets jamais écrits
+// valent 0, ce qui marque la fin des enregistrements
+char* HistoryLog::mapFile(const std::string& path) {
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0 || ftruncate(fd, SEGMENT_SIZE) < 0) {
+		LOG_ERROR(LOG_SERVER, "historique : impossible d'ouvrir " << path << " : " << strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return NULL;
+	}
+	void* addr = mmap(NULL, SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		LOG_ERROR(LOG_SERVER, "historique : mmap de " << path << " impossible : " << strerror(errno));
+		return NULL;
+	}
+	return static_cast<char*>(addr);
+}
+
+// Normalement un échange de pointeurs avec le segment préparé ; les appels
+// système ne se font ici que si une rafale a rempli le segment avant que
+// sa préparation n'aboutisse
+bool HistoryLog::rotate() {
+	++number;
+	kept.push_back(segmentPath(number));
+	while (kept.size() > SEGMENTS_KEPT) {
+		stale.push_back(kept.front());
+		kept.erase(kept.begin());
+	}
+	// Une préparation encore en cours visait ce segment : setSpare() la
+	// refusera, la suivante peut commencer
+	preparing = false;
+	if (spare != NULL) {
+		if (unmapLater)
+			munmap(unmapLater, SEGMENT_SIZE);
+		unmapLater = map;
+		map = spare;
+		spare = NULL;
+		used = 0;
+		return true;
+	}
+	if (map)
+		munmap(map, SEGMENT_SIZE);
+	map = mapFile(kept.back());
+	used = 0;
+	return map != NULL;
+}
+
+bool HistoryLog::takeChores(Chores& out) {
+	if (map != NULL && spare == NULL && !preparing && used >= SEGMENT_SIZE / 2) {
+		preparing = true;
+		out.next = number + 1;
+		out.nextPath = segmentPath(out.next);
+	}
+	out.unmap = unmapLater;
+	unmapLater = NULL;
+	out.stale.swap(stale);
+	return !out.empty();
+}
+
+bool HistoryLog::setSpare(uint64_t n, char* addr) {
+	if (n != number + 1 || spare != NULL)
+		return false;
+	spare = addr;
+	preparing = false;
+	return true;
+}
+
+char* HistoryLog::Chores::run() {
+	if (unmap)
+		munmap(unmap, SEGMENT_SIZE);
+	for (size_t i = 0; i < stale.size(); ++i)
+		unlink(stale[i].c_str());
+	return next != 0 ? mapFile(nextPath) : NULL;
+}
+
+void HistoryLog::append(const StrView& channel, const HistoryEntry& entry) {
+	size_t size = recordSize(channel.len, entry.line.size());
+	if (map == NULL || used + size > SEGMENT_SIZE) {
+		if (!rotate())
+			return;
+	}
+	char* record = map + used;
+	uint32_t nameLen = static_cast<uint32_t>(channel.len);
+	std::memcpy(record + 4, &nameLen, sizeof(nameLen));
+	std::memcpy(record + 8, &entry.msgid, sizeof(entry.msgid));
+	std::memcpy(record + 16, &entry.time, sizeof(entry.time));
+	for (size_t i = 0; i < channel.len; ++i)
+		record[RECORD_HEADER + i] = ircLower(channel.ptr[i]);
+	std::memcpy(record + RECORD_HEADER + channel.len, entry.line.data(), entry.line.size());
+	// La taille en dernier : un enregistrement interrompu reste invisible
+	uint32_t total = static_cast<uint32_t>(size);
+	__atomic_store_n(reinterpret_cast<uint32_t*>(record), total, __ATOMIC_RELEASE);
+	used += size;
+}
+
+bool HistoryLog::replay(const std::string& path, void (*visit)(void*, const StrView&, const HistoryEntry&), void* context) {
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return errno == ENOENT;
+	struct stat info;
+	if (fstat(fd, &info) < 0 || info.st_size == 0) {
+		close(fd);
+		return true;
+	}
+	size_t length = static_cast<size_t>(info.st_size);
+	void* addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+		return false;
+	const char* data = static_cast<const char*>(addr);
+	for (size_t offset = 0; offset + RECORD_HEADER <= length; ) {
+		uint32_t size, nameLen;
+		std::memcpy(&size, data + offset, sizeof(size));
+		std::memcpy(&nameLen, data + offset + 4, sizeof(nameLen));
+		if (size < RECORD_HEADER || offset + size > length || RECORD_HEADER + nameLen > size)
+			break;
+		HistoryEntry entry;
+		std::memcpy(&entry.msgid, data + offset + 8, sizeof(entry.msgid));
+		std::memcpy(&entry.time, data + offset + 16, sizeof(entry.time));
+		const char* name = data + offset + RECORD_HEADER;
+		// La ligne se termine par "\r\n" ; le reste n'est que du remplissage
+		const char* line = name + nameLen;
+		const char* end = data + offset + size;
+		const char* crlf = line;
+		while (crlf + 1 < end && !(crlf[0] == '\r' && crlf[1] == '\n'))
+			++crlf;
+		if (crlf + 1 < end) {
+			entry.line = BufferRef::copyOf(line, static_cast<size_t>(crlf + 2 - line));
+			visit(context, StrView(name, nameLen), entry);
+		}
+		offset += size;
+	}
+	munmap(addr, length);
+	return true;
+}
+
+/* ************************************************************************** */
+/*                             Historique partagé                             */
+/* ************************************************************************** */
+
+ChannelHistory::ChannelHistory() : capacity(0), nextMsgid(1), logging(false) {
+	pthread_mutex_init(&logMutex, NULL);
+	for (size_t i = 0; i < STRIPES; ++i) {
+		pthread_mutex_init(&stripes[i].mutex, NULL);
+		stripes[i].retiredCount = 0;
+		stripes[i].retireClock = 0;
+	}
+}
+
+ChannelHistory::~ChannelHistory() {
+	for (size_t i = 0; i < STRIPES; ++i) {
+		stripes[i].rings.forEach(deleteRing);
+		pthread_mutex_destroy(&stripes[i].mutex);
+	}
+	pthread_mutex_destroy(&logMutex);
+}
+
+bool ChannelHistory::open(size_t size, const std::string& dir) {
+	capacity = size;
+	if (capacity == 0 && !dir.empty())
+		LOG_WARN(LOG_SERVER, "historique : --history-dir sans --history=N, journal ignoré");
+	if (capacity == 0 || dir.empty())
+		return true;
+	if (!log.open(dir))
+		return false;
+	const std::vector<std::string>& segments = log.segments();
+	for (size_t i = 0; i < segments.size(); ++i) {
+		if (!HistoryLog::replay(segments[i], restored, this))
+			LOG_WARN(LOG_SERVER, "historique : segment illisible " << segments[i]);
+	}
+	logging = true;
+	LOG_INFO(LOG_SERVER, "Historique des canaux : " << segments.size() << " segment(s) relu(s) dans " << dir
+		<< ", prochain msgid " << nextMsgid);
+	return true;
+}
+
+// Relecture du journal, avant le démarrage : aucun canal n'existe encore,
+// les anneaux relus sont en sursis jusqu'à ce que leur canal renaisse
+// (redémarrage à chaud, nouveau JOIN). Rien n'est libéré pendant la
+// relecture : le premier retire() du segment ramène le compte sous la borne.
+void ChannelHistory::restored(void* context, const StrView& channel, const HistoryEntry& entry) {
+	ChannelHistory* self = static_cast<ChannelHistory*>(context);
+	Stripe& stripe = self->stripeFor(channel);
+	Held* held = stripe.rings.find(channel);
+	if (held == NULL) {
+		Held fresh;
+		fresh.ring = new HistoryRing(self->capacity);
+		fresh.retired = 0;
+		stripe.rings.insert(channel, fresh);
+		held = stripe.rings.find(channel);
+		markRetired(stripe, channel, *held);
+	}
+	held->ring->push(entry);
+	if (entry.msgid >= self->nextMsgid)
+		self->nextMsgid = entry.msgid + 1;
+}
+
+// Les fonctions suivantes sont appelées verrou du segment pris
+void ChannelHistory::markRetired(Stripe& stripe, const StrView& channel, Held& held) {
+	held.retired = ++stripe.retireClock;
+	Retired entry;
+	entry.name = channel.str();
+	entry.stamp = held.retired;
+	stripe.retired.push_back(entry);
+	++stripe.retiredCount;
+}
+
+void ChannelHistory::evictRetired(Stripe& stripe) {
+	while (stripe.retiredCount > MAX_RETIRED / STRIPES) {
+		const Retired& oldest = stripe.retired.front();
+		Held* held = stripe.rings.find(oldest.name);
+		if (held != NULL && held->retired == oldest.stamp) {
+			delete held->ring;
+			stripe.rings.erase(oldest.name);
+			--stripe.retiredCount;
+		}
+		stripe.retired.pop_front();
+	}
+	// Un canal qui disparaît et renaît sans cesse laisse des entrées
+	// périmées : la file est compactée quand elles dominent
+	if (stripe.retired.size() > 2 * stripe.retiredCount + MAX_RETIRED / STRIPES) {
+		std::deque<Retired> live;
+		for (size_t i = 0; i < stripe.retired.size(); ++i) {
+			Held* held = stripe.rings.find(stripe.retired[i].name);
+			if (held != NULL && held->retired == stripe.retired[i].stamp)
+				live.push_back(stripe.retired[i]);
+		}
+		stripe.retired.swap(live);
+	}
+}
+
+void ChannelHistory::deleteRing(Held& held) {
+	delete held.ring;
+}
+
+void ChannelHistory::adopt(const StrView& channel) {
+	if (capacity == 0)
+		return;
+	Stripe& stripe = stripeFor(channel);
+	pthread_mutex_lock(&stripe.mutex);
+	if (Held* held = stripe.rings.find(channel)) {
+		if (held->retired != 0) {
+			held->retired = 0;   // Son entrée dans `retired` devient périmée
+			--stripe.retiredCount;
+		}
+	} else {
+		Held fresh;
+		fresh.ring = new HistoryRing(capacity);
+		fresh.retired = 0;
+		stripe.rings.insert(channel, fresh);
+	}
+	pthread_mutex_unlock(&stripe.mutex);
+}
+
+void ChannelHistory::retire(const StrView& channel) {
+	if (capacity == 0)
+		return;
+	Stripe& stripe = stripeFor(channel);
+	pthread_mutex_lock(&stripe.mutex);
+	Held* held = stripe.rings.find(channel);
+	if (held != NULL && held->retired == 0) {
+		if (held->ring->size() == 0) {
+			delete held->ring;   // Rien à garder
+			stripe.rings.erase(channel);
+		} else {
+			markRetired(stripe, channel, *held);
+		}
+	}
+	evictRetired(stripe);
+	pthread_mutex_unlock(&stripe.mutex);
+}
+
+// Un message arrivé après la disparition du canal (réplique des membres
+// pas encore à jour) va dans l'anneau en sursis, ou est perdu si l'anneau
+// a déjà été libéré : aucun anneau n'est créé ici
+void ChannelHistory::record(const StrView& channel, const BufferRef& line) {
+	if (capacity == 0)
+		return;
+	HistoryEntry entry;
+	entry.line = line;
+	Stripe& stripe = stripeFor(channel);
+	pthread_mutex_lock(&stripe.mutex);
+	Held* held = stripe.rings.find(channel);
+	if (held == NULL) {
+		pthread_mutex_unlock(&stripe.mutex);
+		return;
+	}
+	// Heure lue sous le verrou et jamais avant celle du message précédent
+	// (horloge recalée) : l'anneau reste trié par date pour firstAfter()
+	HistoryRing& ring = *held->ring;
+	entry.time = wallClockMs();
+	if (ring.size() != 0 && ring.at(ring.size() - 1).time > entry.time)
+		entry.time = ring.at(ring.size() - 1).time;
+	entry.msgid = __sync_fetch_and_add(&nextMsgid, 1);
+	ring.push(entry);
+	HistoryLog::Chores chores;
+	bool pending = false;
+	if (logging) {
+		pthread_mutex_lock(&logMutex);
+		log.append(channel, entry);
+		pending = log.takeChores(chores);
+		pthread_mutex_unlock(&logMutex);
+	}
+	pthread_mutex_unlock(&stripe.mutex);
+	if (pending)
+		prepareLog(chores);
+}
+
+// Sans verrou pendant les appels système ; un échec laisse `preparing`
+// levé : la rotation se fera de façon synchrone et relancera la préparation
+void ChannelHistory::prepareLog(HistoryLog::Chores& chores) {
+	char* addr = chores.run();
+	if (addr == NULL)
+		return;
+	pthread_mutex_lock(&logMutex);
+	bool adopted = log.setSpare(chores.next, addr);
+	pthread_mutex_unlock(&logMutex);
+	if (!adopted)
+		munmap(addr, HistoryLog::SEGMENT_SIZE);
+}
+
+void ChannelHistory::copyRange(const StrView& channel, Range range, const HistoryRef& ref, size_t limit, std::vector<HistoryEntry>& out) {
+	if (capacity == 0)
+		return;
+	Stripe& stripe = stripeFor(channel);
+	pthread_mutex_lock(&stripe.mutex);
+	if (Held* held = stripe.rings.find(channel)) {
+		const HistoryRing& ring = *held->ring;
+		size_t lo = 0, hi = ring.size();
+		if (range == LATEST) {
+			lo = std::max(ring.firstAfter(ref), hi > limit ? hi - limit : 0);
+		} else if (range == BEFORE) {
+			hi = ring.firstNotBefore(ref);
+			lo = hi > limit ? hi - limit : 0;
+		} else {
+			lo = ring.firstAfter(ref);
+			hi = std::min(hi, lo + limit);
+		}
+		for (size_t i = lo; i < hi; ++i)
+			out.push_back(ring.at(i));
+	}
+	pthread_mutex_unlock(&stripe.mutex);
+}
+
+void ChannelHistory::latest(const StrView& channel, const HistoryRef& after, size_t limit, std::vector<HistoryEntry>& out) {
+	copyRange(channel, LATEST, after, limit, out);
+}
+
+void ChannelHistory::before(const StrView& channel, const HistoryRef& ref, size_t limit, std::vector<HistoryEntry>& out) {
+	copyRange(channel, BEFORE, ref, limit, out);
+}
+
+void ChannelHistory::after(const StrView& channel, const HistoryRef& ref, size_t limit, std::vector<HistoryEntry>& out) {
+	copyRange(channel, AFTER, ref, limit, out);
+}
+
+// gettimeofday passe par le vDSO : pas d'appel système
+uint64_t ChannelHistory::wallClockMs() {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return static_cast<uint64_t>(now.tv_sec) * 1000 + static_cast<uint64_t>(now.tv_usec) / 1000;
+}
+
+std::string ChannelHistory::formatTime(uint64_t ms) {
+	time_t seconds = static_cast<time_t>(ms / 1000);
+	struct tm utc;
+	gmtime_r(&seconds, &utc);
+	char text[32];
+	snprintf(text, sizeof(text), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", utc.tm_year + 1900, utc.tm_mon + 1,
+		utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec, static_cast<int>(ms % 1000));
+	return text;
+}
+
+bool ChannelHistory::parseTime(const StrView& text, uint64_t& ms) {
+	if (text.len < 20 || text.len > 30)
+		return false;
+	std::string copy = text.str();
+	struct tm utc;
+	std::memset(&utc, 0, sizeof(utc));
+	int consumed = 0;
+	if (sscanf(copy.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d%n", &utc.tm_year, &utc.tm_mon, &utc.tm_mday,
+			&utc.tm_hour, &utc.tm_min, &utc.tm_sec, &consumed) != 6)
+		return false;
+	unsigned millis = 0;
+	const char* rest = copy.c_str() + consumed;
+	if (*rest == '.') {
+		unsigned scale = 100;
+		for (++rest; *rest >= '0' && *rest <= '9'; ++rest) {
+			millis += static_cast<unsigned>(*rest - '0') * scale;
+			scale /= 10;
+		}
+	}
+	if (std::strcmp(rest, "Z") != 0)
+		return false;
+	utc.tm_year -= 1900;
+	utc.tm_mon -= 1;
+	time_t seconds = timegm(&utc);
+	if (seconds < 0)
+		return false;
+	ms = static_cast<uint64_t>(seconds) * 1000 + millis;
+	return true;
+}
@@ -0,0 +1,210 @@
+#ifndef HISTORY_HPP
+#define HISTORY_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <stdint.h>
+#include <pthread.h>
+#include "ircmap.hpp"
+#include "sharedbuffer.hpp"
+
+/*
+ * Historique des canaux (--history=N, --history-dir=chemin), désactivé par
+ * défaut : les N derniers PRIVMSG de chaque canal, rejoués par CHATHISTORY. L'anneau d'un
+ * canal naît avec lui et grandit avec ses messages. Le canal peut
+ * disparaître (dernier membre parti) : son historique reste, mais seuls
+ * les MAX_RETIRED canaux disparus les plus récents sont gardés.
+ *
+ * Avec --history-dir, chaque message est aussi ajouté à un journal en
+ * segments de taille fixe projetés en mémoire (MAP_SHARED) : un ajout est
+ * un memcpy, sans appel système. Le segment suivant est créé et projeté à
+ * l'avance, hors de tout verrou, dès que le courant est à moitié plein :
+ * le changement de segment n'est alors qu'un échange de pointeurs.
+ * Au démarrage (y compris après un redémarrage à chaud) les segments sont
+ * relus pour reconstruire les anneaux.
+ */
+
+// Message conservé ; `line` est le tampon déjà diffusé aux membres
+struct HistoryEntry {
+	uint64_t msgid;   // Croissant sur tout le serveur, jamais réutilisé
+	uint64_t time;    // ms depuis l'epoch (server-time)
+	BufferRef line;   // ":pseudo PRIVMSG #canal :texte\r\n"
+};
+
+// Borne d'une requête CHATHISTORY : msgid=..., timestamp=... ou "*"
+struct HistoryRef {
+	enum Kind { NONE, MSGID, TIME };
+	Kind kind;
+	uint64_t value;
+
+	HistoryRef() : kind(NONE), value(0) {}
+	// Retourne false si `text` n'est ni "*" ni une référence valide
+	bool parse(const StrView& text);
+};
+
+// Les `capacity` derniers messages d'un canal, du plus ancien au plus
+// récent. Les cases sont allouées au fil des messages, jusqu'à `capacity`.
+class HistoryRing {
+public:
+	explicit HistoryRing(size_t capacity);
+
+	void push(const HistoryEntry& entry);
+	size_t size() const { return slots.size(); }
+	const HistoryEntry& at(size_t i) const { return slots[(head + i) % slots.size()]; }
+
+	// Index du premier message strictement après `ref` (0 si NONE)
+	size_t firstAfter(const HistoryRef& ref) const;
+	// Index du premier message qui n'est pas strictement avant `ref`
+	// (size() si NONE)
+	size_t firstNotBefore(const HistoryRef& ref) const;
+
+private:
+	std::vector<HistoryEntry> slots;
+	size_t limit;
+	size_t head;   // Reste 0 tant que l'anneau n'est pas plein
+};
+
+// Journal sur disque : history.<n>.log, SEGMENT_SIZE octets chacun, les
+// SEGMENTS_KEPT plus récents conservés. Un enregistrement :
+//   u32 taille totale (écrite en dernier ; 0 : fin du segment)
+//   u32 longueur du nom, u64 msgid, u64 time, nom replié, ligne
+// complété à un multiple de 8 octets. Non synchronisé : ChannelHistory
+// l'appelle sous son propre verrou, sauf mapFile() et Chores::run().
+class HistoryLog {
+public:
+	static const size_t SEGMENT_SIZE = 16 * 1024 * 1024;
+	static const size_t SEGMENTS_KEPT = 8;
+
+	// Appels système de la rotation, relevés sous le verrou et faits après
+	// l'avoir rendu : projection du segment suivant, libération de l'ancien
+	// segment, suppression des segments au-delà de SEGMENTS_KEPT
+	struct Chores {
+		uint64_t next;                  // 0 : pas de segment à préparer
+		std::string nextPath;
+		char* unmap;
+		std::vector<std::string> stale;
+
+		Chores() : next(0), unmap(NULL) {}
+		bool empty() const { return next == 0 && unmap == NULL && stale.empty(); }
+		// Sans verrou ; retourne le segment projeté (NULL si rien à préparer
+		// ou en cas d'échec)
+		char* run();
+	};
+
+	HistoryLog();
+	~HistoryLog();
+
+	// Crée `dir` au besoin et ouvre le dernier segment (ou le premier) pour
+	// y ajouter à la suite de ses enregistrements
+	bool open(const std::string& path);
+	// Segments présents, du plus ancien au courant, pour la relecture
+	const std::vector<std::string>& segments() const { return kept; }
+	// Le nom du canal est replié en même temps qu'il est copié
+	void append(const StrView& channel, const HistoryEntry& entry);
+
+	// Après append() : retourne false si rien n'est à faire hors verrou.
+	// Un seul appelant à la fois reçoit la préparation du segment suivant.
+	bool takeChores(Chores& out);
+	// Segment `number` préparé par Chores::run() ; retourne false s'il
+	// n'est plus attendu (rotation faite entre-temps) : à libérer
+	bool setSpare(uint64_t number, char* addr);
+
+	// Appelle `visit(context, nom, entrée)` pour chaque enregistrement
+	static bool replay(const std::string& path, void (*visit)(void*, const StrView&, const HistoryEntry&), void* context);
+
+private:
+	std::string segmentPath(uint64_t n) const;
+	static char* mapFile(const std::string& path);
+	bool rotate();
+
+	std::string dir;
+	std::vector<std::string> kept;   // Segments présents, du plus ancien au courant
+	uint64_t number;                 // Numéro du segment courant
+	char* map;
+	size_t used;
+	char* spare;                     // Segment number + 1, déjà projeté
+	bool preparing;                  // Chores::run() en cours pour number + 1
+	char* unmapLater;                // Segment quitté, à libérer hors verrou
+	std::vector<std::string> stale;  // Segments à supprimer hors verrou
+};
+
+// Anneaux de tous les canaux, par segments verrouillés comme SharedState
+class ChannelHistory {
+public:
+	static const size_t STRIPES = 16;
+	static const size_t MAX_REPLAY = 100;     // CHATHISTORY : messages par requête
+	static const size_t MAX_RETIRED = 1024;   // Canaux disparus dont l'historique reste
+
+	ChannelHistory();
+	~ChannelHistory();
+
+	// Avant le démarrage des shards ; `capacity` 0 : désactivé
+	bool open(size_t capacity, const std::string& dir);
+	bool enabled() const { return capacity != 0; }
+
+	// Création et disparition d'un canal (ChannelLock) : l'anneau naît avec
+	// le canal ; à sa disparition il rejoint les anneaux en sursis, dont
+	// les plus anciens sont libérés au-delà de MAX_RETIRED
+	void adopt(const StrView& channel);
+	void retire(const StrView& channel);
+
+	// Chemin de PRIVMSG : numérote, horodate, conserve et journalise.
+	// Verrou du segment, plus celui du journal avec --history-dir ; les
+	// appels système du journal sont faits après les avoir rendus.
+	void record(const StrView& channel, const BufferRef& line);
+
+	// CHATHISTORY LATEST / BEFORE / AFTER : au plus `limit` messages, du plus
+	// ancien au plus récent
+	void latest(const StrView& channel, const HistoryRef& after, size_t limit, std::vector<HistoryEntry>& out);
+	void before(const StrView& channel, const HistoryRef& ref, size_t limit, std::vector<HistoryEntry>& out);
+	void after(const StrView& channel, const HistoryRef& ref, size_t limit, std::vector<HistoryEntry>& out);
+
+	static uint64_t wallClockMs();
+	// "2026-01-02T03:04:05.678Z" (IRCv3 server-time)
+	static std::string formatTime(uint64_t ms);
+	static bool parseTime(const StrView& text, uint64_t& ms);
+
+private:
+	enum Range { LATEST, BEFORE, AFTER };
+
+	// Anneau d'un canal ; `retired` 0 : le canal existe, sinon le numéro de
+	// sa disparition dans le segment
+	struct Held {
+		HistoryRing* ring;
+		uint64_t retired;
+	};
+
+	struct Retired {
+		std::string name;
+		uint64_t stamp;   // Périmé si l'anneau a été repris ou libéré depuis
+	};
+
+	struct Stripe {
+		pthread_mutex_t mutex;
+		IrcMap<Held> rings;
+		std::deque<Retired> retired;   // Disparitions, de la plus ancienne à la plus récente
+		size_t retiredCount;           // Anneaux en sursis (entrées valides de `retired`)
+		uint64_t retireClock;
+	};
+
+	Stripe& stripeFor(const StrView& channel) { return stripes[ircHash(channel) % STRIPES]; }
+	static void markRetired(Stripe& stripe, const StrView& channel, Held& held);
+	static void evictRetired(Stripe& stripe);
+	static void deleteRing(Held& held);
+	void copyRange(const StrView& channel, Range range, const HistoryRef& ref, size_t limit, std::vector<HistoryEntry>& out);
+	static void restored(void* context, const StrView& channel, const HistoryEntry& entry);
+	void prepareLog(HistoryLog::Chores& chores);
+
+	size_t capacity;
+	uint64_t nextMsgid;
+	bool logging;
+	pthread_mutex_t logMutex;
+	HistoryLog log;
+	Stripe stripes[STRIPES];
+
+	ChannelHistory(const ChannelHistory&);
+	ChannelHistory& operator=(const ChannelHistory&);
+};
+
+#endif // HISTORY_HPP
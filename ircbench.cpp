@@ -0,0 +1,518 @@
+#include "ircbench.hpp"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+
+static const size_t MAX_HANDSHAKES = 256;       // Connexions en cours d'enregistrement
+static const size_t MAX_BACKLOG = 256 * 1024;   // Au-delà, le client est considéré saturé
+static const unsigned SETUP_TIMEOUT = 60;       // Secondes pour connecter tout le monde
+static const size_t READ_CHUNK = 16384;
+static const char BENCH_TAG[] = "bench ";
+
+/* ************************************************************************** */
+/*                                  Options                                   */
+/* ************************************************************************** */
+
+BenchConfig::BenchConfig()
+	: host("127.0.0.1"), port(6667), password(""), poller("auto"), clients(1000),
+	channels(10), joins(1), topology("spread"), rate(1000), size(64), churn(0), storm(0),
+	connectRate(0), duration(10), drain(2) {}
+
+bool BenchConfig::parseOption(const std::string& arg) {
+	if (arg.compare(0, 2, "--") != 0)
+		return false;
+	std::string::size_type eq = arg.find('=');
+	if (eq == std::string::npos)
+		return false;
+	std::string key = arg.substr(2, eq - 2);
+	std::string value = arg.substr(eq + 1);
+	char* end = NULL;
+	double number = std::strtod(value.c_str(), &end);
+	bool isNumber = !value.empty() && *end == '\0' && number >= 0;
+
+	if (key == "host") {
+		struct in_addr addr;
+		if (inet_pton(AF_INET, value.c_str(), &addr) != 1)
+			return false;
+		host = value;
+		return true;
+	}
+	if (key == "password") {
+		password = value;
+		return true;
+	}
+	if (key == "poller") {
+		if (value != "auto" && value != "uring" && value != "epoll" && value != "select")
+			return false;
+		poller = value;
+		return true;
+	}
+	if (key == "topology") {
+		if (value != "spread" && value != "hot")
+			return false;
+		topology = value;
+		return true;
+	}
+	if (!isNumber)
+		return false;
+	if (key == "port") {
+		if (number < 1 || number > 65535)
+			return false;
+		port = static_cast<int>(number);
+	} else if (key == "clients" || key == "channels" || key == "joins") {
+		if (number < 1)
+			return false;
+		(key == "clients" ? clients : key == "channels" ? channels : joins) = static_cast<size_t>(number);
+	} else if (key == "size") {
+		if (number < 32 || number > 400)
+			return false;
+		size = static_cast<size_t>(number);
+	} else if (key == "rate") {
+		rate = number;
+	} else if (key == "churn") {
+		churn = number;
+	} else if (key == "storm") {
+		storm = number;
+	} else if (key == "connect-rate") {
+		connectRate = number;
+	} else if (key == "duration") {
+		if (number < 1)
+			return false;
+		duration = static_cast<unsigned>(number);
+	} else if (key == "drain") {
+		drain = static_cast<unsigned>(number);
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/* ************************************************************************** */
+/*                                Connexions                                  */
+/* ************************************************************************** */
+
+IrcBench::IrcBench(const BenchConfig& cfg)
+	: config(cfg), poller(Poller::create(cfg.poller)), clients(cfg.clients), phase(SETUP),
+	phaseStart(0), measureEnd(0), cursor(0), readyCount(0), connecting(0), nextConnect(0),
+	random(2463534242u), sent(0), delivered(0), churnOps(0), stormOps(0), errors(0), dropped(0) {
+	if (config.joins > config.channels)
+		config.joins = config.channels;
+}
+
+IrcBench::~IrcBench() {
+	for (size_t i = 0; i < clients.size(); ++i)
+		closeClient(i);
+	delete poller;
+}
+
+uint64_t IrcBench::nowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+std::string IrcBench::nickOf(size_t slot) const {
+	std::ostringstream nick;
+	nick << "b" << slot << "_" << clients[slot].generation;
+	return nick.str();
+}
+
+std::string IrcBench::channelName(size_t channel) const {
+	std::ostringstream name;
+	name << "#bench" << channel;
+	return name.str();
+}
+
+// k-ième canal du client : réparti uniformément ("spread"), ou canal 0
+// commun à tous puis répartition du reste ("hot", fan-out maximal)
+size_t IrcBench::pickChannel(size_t slot, size_t k) {
+	if (config.topology == "hot") {
+		if (k == 0)
+			return 0;
+		return 1 + (slot * (config.joins - 1) + k - 1) % (config.channels > 1 ? config.channels - 1 : 1);
+	}
+	return (slot * config.joins + k) % config.channels;
+}
+
+bool IrcBench::connectClient(size_t slot) {
+	BenchClient& client = clients[slot];
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		std::cerr << "Erreur de socket(): " << strerror(errno) << std::endl;
+		++errors;
+		return false;
+	}
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	struct sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(static_cast<uint16_t>(config.port));
+	inet_pton(AF_INET, config.host.c_str(), &addr.sin_addr);
+	if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 && errno != EINPROGRESS) {
+		std::cerr << "Erreur de connect(): " << strerror(errno) << std::endl;
+		close(fd);
+		++errors;
+		return false;
+	}
+	if (static_cast<size_t>(fd) >= slotOfFd.size())
+		slotOfFd.resize(fd + 1, -1);
+	slotOfFd[fd] = static_cast<int>(slot);
+
+	client.fd = fd;
+	client.state = CONNECTING;
+	client.joined.clear();
+	client.nextChannel = 0;
+	client.in = LineBuffer();
+	client.out.clear();
+	client.outStart = 0;
+	client.wantWrite = true;    // La fin du connect() est signalée par WRITE
+	poller->add(fd, Poller::READ | Poller::WRITE);
+	++connecting;
+	return true;
+}
+
+void IrcBench::closeClient(size_t slot) {
+	BenchClient& client = clients[slot];
+	if (client.fd < 0)
+		return;
+	poller->remove(client.fd);
+	close(client.fd);
+	slotOfFd[client.fd] = -1;
+	client.fd = -1;
+	if (client.state == READY)
+		--readyCount;
+	else if (client.state != IDLE)
+		--connecting;
+	client.state = IDLE;
+	++client.generation;
+}
+
+void IrcBench::queue(size_t slot, const std::string& data) {
+	clients[slot].out += data;
+}
+
+// Envoie tout ce qui peut l'être, puis ajuste l'intérêt WRITE du fd
+void IrcBench::flush(size_t slot) {
+	BenchClient& client = clients[slot];
+	if (client.fd < 0 || client.state == CONNECTING)
+		return;
+	while (client.outStart < client.out.size()) {
+		ssize_t n = send(client.fd, client.out.data() + client.outStart,
+			client.out.size() - client.outStart, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			++errors;
+			closeClient(slot);
+			return;
+		}
+		client.outStart += static_cast<size_t>(n);
+	}
+	if (client.outStart == client.out.size()) {
+		client.out.clear();
+		client.outStart = 0;
+	} else if (client.outStart > client.out.size() / 2) {
+		client.out.erase(0, client.outStart);
+		client.outStart = 0;
+	}
+	bool want = !client.out.empty();
+	if (want != client.wantWrite) {
+		poller->modify(client.fd, Poller::READ | (want ? Poller::WRITE : 0));
+		client.wantWrite = want;
+	}
+}
+
+void IrcBench::readClient(size_t slot) {
+	BenchClient& client = clients[slot];
+	while (client.fd >= 0) {
+		char* buf = client.in.prepare(READ_CHUNK);
+		ssize_t n = recv(client.fd, buf, READ_CHUNK, 0);
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		if (n <= 0) {
+			// Le serveur a fermé la connexion (ou erreur) : compté comme erreur
+			++errors;
+			closeClient(slot);
+			return;
+		}
+		client.in.commit(static_cast<size_t>(n));
+		StrView line;
+		LineBuffer::Status status;
+		while (client.fd >= 0 && (status = client.in.nextLine(line)) != LineBuffer::NEED_MORE) {
+			if (status == LineBuffer::LINE_READY)
+				handleLine(slot, line);
+		}
+	}
+}
+
+void IrcBench::handleLine(size_t slot, const StrView& line) {
+	BenchClient& client = clients[slot];
+	IrcMessage msg;
+	if (!parseMessage(line, msg))
+		return;
+
+	if (msg.command == "PRIVMSG") {
+		if (msg.paramCount < 2 || phase == SETUP)
+			return;
+		const StrView& text = msg.params[msg.paramCount - 1];
+		size_t tagLen = sizeof(BENCH_TAG) - 1;
+		if (text.len <= tagLen || std::memcmp(text.ptr, BENCH_TAG, tagLen) != 0)
+			return;
+		// Le texte est suivi d'un espace : strtoull s'arrête avant la fin de la vue
+		uint64_t stamp = std::strtoull(text.ptr + tagLen, NULL, 10);
+		uint64_t now = nowNs();
+		++delivered;
+		latency.record(now > stamp ? now - stamp : 0);
+	} else if (msg.command == "001") {
+		// Enregistré : rejoindre les canaux, puis un PING sert de barrière
+		client.state = JOINING;
+		for (size_t k = 0; k < config.joins; ++k) {
+			size_t channel = pickChannel(slot, k);
+			client.joined.push_back(channel);
+			queue(slot, "JOIN " + channelName(channel) + "\r\n");
+		}
+		queue(slot, "PING :ready\r\n");
+	} else if (msg.command == "PONG") {
+		if (client.state == JOINING) {
+			client.state = READY;
+			--connecting;
+			++readyCount;
+		}
+	} else if (msg.command == "PING") {
+		queue(slot, "PONG :" + (msg.paramCount ? msg.params[0].str() : std::string()) + "\r\n");
+	} else if (msg.command == "433") {
+		// Pseudo encore tenu par une connexion précédente : en prendre un autre
+		++errors;
+		++client.generation;
+		queue(slot, "NICK " + nickOf(slot) + "\r\n");
+	} else if (msg.command == "ERROR" || (msg.command.len == 3 && (msg.command[0] == '4' || msg.command[0] == '5'))) {
+		++errors;
+	}
+}
+
+void IrcBench::handleEvent(const PollEvent& event) {
+	if (event.fd < 0 || static_cast<size_t>(event.fd) >= slotOfFd.size() || slotOfFd[event.fd] < 0)
+		return;
+	size_t slot = static_cast<size_t>(slotOfFd[event.fd]);
+	BenchClient& client = clients[slot];
+
+	if (client.state == CONNECTING) {
+		int err = 0;
+		socklen_t len = sizeof(err);
+		getsockopt(client.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+		if (err != 0) {
+			if (err != EINPROGRESS) {
+				std::cerr << "Connexion refusée : " << strerror(err) << std::endl;
+				++errors;
+				closeClient(slot);
+			}
+			return;
+		}
+		client.state = REGISTERING;
+		if (!config.password.empty())
+			queue(slot, "PASS " + config.password + "\r\n");
+		std::string nick = nickOf(slot);
+		queue(slot, "NICK " + nick + "\r\n" + "USER " + nick + " 0 * :ircbench\r\n");
+	}
+	if (event.events & (Poller::READ | Poller::HANGUP))
+		readClient(slot);
+	flush(slot);
+}
+
+/* ************************************************************************** */
+/*                                   Charge                                   */
+/* ************************************************************************** */
+
+// Prochain client prêt, en tourniquet ; clients.size() si aucun
+size_t IrcBench::nextReady() {
+	for (size_t tries = 0; tries < clients.size(); ++tries) {
+		size_t slot = cursor++ % clients.size();
+		if (clients[slot].state == READY)
+			return slot;
+	}
+	return clients.size();
+}
+
+void IrcBench::sendMessages(uint64_t now) {
+	uint64_t due = static_cast<uint64_t>(config.rate * static_cast<double>(now - phaseStart) / 1e9);
+	char header[64];
+	while (sent + dropped < due) {
+		size_t slot = nextReady();
+		if (slot == clients.size())
+			return;
+		BenchClient& client = clients[slot];
+		if (client.out.size() - client.outStart > MAX_BACKLOG) {
+			++dropped;
+			continue;
+		}
+		size_t channel = client.joined[client.nextChannel++ % client.joined.size()];
+		int n = std::snprintf(header, sizeof(header), "%s%llu %llu ", BENCH_TAG,
+			static_cast<unsigned long long>(nowNs()), static_cast<unsigned long long>(sent));
+		std::string line = "PRIVMSG " + channelName(channel) + " :";
+		line.append(header, static_cast<size_t>(n));
+		if (static_cast<size_t>(n) < config.size)
+			line.append(config.size - static_cast<size_t>(n), 'x');
+		line += "\r\n";
+		queue(slot, line);
+		++sent;
+	}
+}
+
+void IrcBench::churnChannels(uint64_t now) {
+	uint64_t due = static_cast<uint64_t>(config.churn * static_cast<double>(now - phaseStart) / 1e9);
+	while (churnOps < due) {
+		size_t slot = nextReady();
+		if (slot == clients.size() || config.channels <= config.joins)
+			return;
+		BenchClient& client = clients[slot];
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		size_t k = random % client.joined.size();
+		// Un canal que le client n'a pas déjà rejoint (il en reste, joins < channels)
+		size_t next = random % config.channels;
+		while (std::find(client.joined.begin(), client.joined.end(), next) != client.joined.end())
+			next = (next + 1) % config.channels;
+		queue(slot, "PART " + channelName(client.joined[k]) + "\r\nJOIN " + channelName(next) + "\r\n");
+		client.joined[k] = next;
+		++churnOps;
+	}
+}
+
+void IrcBench::stormClients(uint64_t now) {
+	uint64_t due = static_cast<uint64_t>(config.storm * static_cast<double>(now - phaseStart) / 1e9);
+	while (stormOps < due) {
+		size_t slot = nextReady();
+		if (slot == clients.size())
+			return;
+		// QUIT envoyé sans attendre la réponse, puis nouvelle connexion
+		queue(slot, "QUIT :storm\r\n");
+		flush(slot);
+		closeClient(slot);
+		connectClient(slot);
+		++stormOps;
+	}
+}
+
+/* ************************************************************************** */
+/*                                  Boucle                                    */
+/* ************************************************************************** */
+
+int IrcBench::run() {
+	if (poller == NULL) {
+		std::cerr << "Erreur: aucun backend de multiplexage disponible" << std::endl;
+		return 1;
+	}
+	// Des milliers de connexions : relever la limite de descripteurs
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	std::cout << "ircbench : " << config.clients << " clients vers " << config.host << ":" << config.port
+		<< " (" << poller->name() << "), " << config.channels << " canaux, " << config.joins
+		<< " par client (" << config.topology << ")" << std::endl;
+
+	std::vector<PollEvent> events;
+	phaseStart = nowNs();
+	while (true) {
+		uint64_t now = nowNs();
+		double elapsed = static_cast<double>(now - phaseStart) / 1e9;
+
+		if (phase == SETUP) {
+			while (nextConnect < clients.size() && connecting < MAX_HANDSHAKES
+				&& (config.connectRate == 0 || nextConnect < config.connectRate * elapsed)) {
+				connectClient(nextConnect++);
+			}
+			bool allStarted = nextConnect == clients.size();
+			if ((allStarted && readyCount == clients.size()) || elapsed > SETUP_TIMEOUT) {
+				if (readyCount < clients.size())
+					std::cerr << "Attention : " << readyCount << "/" << clients.size()
+						<< " clients prêts après " << SETUP_TIMEOUT << " s" << std::endl;
+				std::cout << readyCount << " clients enregistrés en " << std::fixed << std::setprecision(2)
+					<< elapsed << " s, mesure pendant " << config.duration << " s" << std::endl;
+				phase = MEASURE;
+				phaseStart = now;
+				errors = 0;
+			}
+		} else if (phase == MEASURE) {
+			sendMessages(now);
+			churnChannels(now);
+			stormClients(now);
+			if (elapsed >= config.duration) {
+				phase = DRAIN;
+				measureEnd = now;
+			}
+		} else if (static_cast<double>(now - measureEnd) / 1e9 >= config.drain) {
+			break;
+		}
+
+		for (size_t i = 0; i < clients.size(); ++i) {
+			if (clients[i].outStart < clients[i].out.size())
+				flush(i);
+		}
+		int ready = poller->wait(events, 1);
+		if (ready < 0 && errno != EINTR) {
+			std::cerr << "Erreur de " << poller->name() << "(): " << strerror(errno) << std::endl;
+			return 1;
+		}
+		for (int i = 0; i < ready; ++i)
+			handleEvent(events[i]);
+	}
+	report();
+	return 0;
+}
+
+static std::string formatNs(uint64_t ns) {
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(ns < 10000 ? 2 : 0) << static_cast<double>(ns) / 1000.0 << " µs";
+	return out.str();
+}
+
+void IrcBench::report() const {
+	double seconds = static_cast<double>(measureEnd - phaseStart) / 1e9;
+	std::cout << std::fixed << std::setprecision(0)
+		<< "messages envoyés     : " << sent << " (" << sent / seconds << " msg/s)" << std::endl
+		<< "livraisons (fan-out) : " << delivered << " (" << delivered / seconds << " livraisons/s)" << std::endl
+		<< "latence              : p50 " << formatNs(latency.percentile(0.50))
+		<< ", p99 " << formatNs(latency.percentile(0.99))
+		<< ", p999 " << formatNs(latency.percentile(0.999))
+		<< ", max " << formatNs(latency.max()) << std::endl
+		<< "churn PART/JOIN      : " << churnOps << ", reconnexions : " << stormOps << std::endl
+		<< "erreurs              : " << errors << ", envois sautés (client saturé) : " << dropped << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+	signal(SIGPIPE, SIG_IGN);
+
+	BenchConfig config;
+	for (int i = 1; i < argc; ++i) {
+		if (!config.parseOption(argv[i])) {
+			std::cerr << "Option invalide : " << argv[i] << std::endl;
+			std::cerr << "Usage: ./ircbench [--host=127.0.0.1] [--port=6667] [--password=mot]"
+				" [--poller=auto|uring|epoll|select] [--clients=N] [--channels=N] [--joins=N]"
+				" [--topology=spread|hot] [--rate=msg/s] [--size=octets] [--churn=ops/s]"
+				" [--storm=ops/s] [--connect-rate=N/s] [--duration=s] [--drain=s]" << std::endl;
+			return 1;
+		}
+	}
+	IrcBench bench(config);
+	return bench.run();
+}
@@ -0,0 +1,111 @@
+#ifndef IRCBENCH_HPP
+#define IRCBENCH_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "poller.hpp"
+#include "linebuffer.hpp"
+#include "message.hpp"
+#include "histogram.hpp"
+
+// Options de lancement : ./ircbench [--option=valeur ...]
+struct BenchConfig {
+	std::string host;       // --host=a.b.c.d
+	int port;               // --port=N
+	std::string password;   // --password=mot
+	std::string poller;     // --poller=auto|uring|epoll|select
+	size_t clients;         // --clients=N : connexions simultanées
+	size_t channels;        // --channels=N : canaux #bench0..N-1
+	size_t joins;           // --joins=N : canaux rejoints par client
+	std::string topology;   // --topology=spread|hot : répartition des membres
+	double rate;            // --rate=N : PRIVMSG par seconde, tous clients confondus
+	size_t size;            // --size=N : taille du texte de chaque PRIVMSG
+	double churn;           // --churn=N : paires PART/JOIN par seconde
+	double storm;           // --storm=N : déconnexions/reconnexions par seconde
+	double connectRate;     // --connect-rate=N : connexions par seconde au démarrage (0 : sans limite)
+	unsigned duration;      // --duration=s : durée de la mesure
+	unsigned drain;         // --drain=s : attente des derniers messages après la mesure
+
+	BenchConfig();
+
+	// Analyse une option "--cle=valeur", retourne false si inconnue ou invalide
+	bool parseOption(const std::string& arg);
+};
+
+// Générateur de charge : un seul thread, une boucle d'événements sur le
+// même Poller que le serveur. Chaque PRIVMSG porte l'instant d'envoi
+// (CLOCK_MONOTONIC, en ns) : à la réception, l'écart donne la latence de
+// bout en bout, serveur et noyau compris.
+class IrcBench {
+public:
+	explicit IrcBench(const BenchConfig& config);
+	~IrcBench();
+
+	// Retourne le code de sortie du programme
+	int run();
+
+private:
+	enum State { IDLE, CONNECTING, REGISTERING, JOINING, READY };
+	enum Phase { SETUP, MEASURE, DRAIN };
+
+	struct BenchClient {
+		int fd;
+		State state;
+		unsigned generation;        // Change le pseudo à chaque reconnexion
+		std::vector<size_t> joined; // Canaux rejoints
+		size_t nextChannel;         // Tourniquet sur `joined`
+		LineBuffer in;
+		std::string out;
+		size_t outStart;            // Début des données non encore envoyées
+		bool wantWrite;
+
+		BenchClient() : fd(-1), state(IDLE), generation(0), nextChannel(0), outStart(0), wantWrite(false) {}
+	};
+
+	static uint64_t nowNs();
+	std::string nickOf(size_t slot) const;
+	std::string channelName(size_t channel) const;
+	size_t pickChannel(size_t slot, size_t k);
+
+	bool connectClient(size_t slot);
+	void closeClient(size_t slot);
+	void queue(size_t slot, const std::string& data);
+	void flush(size_t slot);
+	void readClient(size_t slot);
+	void handleLine(size_t slot, const StrView& line);
+	void handleEvent(const PollEvent& event);
+
+	void sendMessages(uint64_t now);
+	void churnChannels(uint64_t now);
+	void stormClients(uint64_t now);
+	size_t nextReady();
+	void report() const;
+
+	BenchConfig config;
+	Poller* poller;
+	std::vector<BenchClient> clients;
+	std::vector<int> slotOfFd;
+	Phase phase;
+	uint64_t phaseStart;
+	uint64_t measureEnd;
+	size_t cursor;              // Tourniquet des émetteurs
+	size_t readyCount;
+	size_t connecting;          // Poignées de main en cours
+	size_t nextConnect;         // Prochain client à connecter pendant SETUP
+	uint32_t random;            // xorshift, pour le churn et les tempêtes
+
+	// Compteurs de la phase de mesure
+	uint64_t sent;
+	uint64_t delivered;
+	uint64_t churnOps;
+	uint64_t stormOps;
+	uint64_t errors;
+	uint64_t dropped;           // Envois sautés : client saturé
+	LatencyHistogram latency;
+
+	IrcBench(const IrcBench&);
+	IrcBench& operator=(const IrcBench&);
+};
+
+#endif // IRCBENCH_HPP
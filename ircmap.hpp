@@ -0,0 +1,84 @@
+#ifndef IRCMAP_HPP
+#define IRCMAP_HPP
+
+#include <string>
+#include <vector>
+#include "casemap.hpp"
+
+// Table de hachage dont les clés sont des noms IRC comparés sans tenir
+// compte de la casse (rfc1459). Recherche en O(1) en moyenne.
+template <typename V>
+class IrcMap {
+public:
+	IrcMap() : buckets(64), count(0) {}
+
+	V* find(const StrView& name) {
+		size_t h = ircHash(name);
+		std::vector<Entry>& bucket = buckets[h & (buckets.size() - 1)];
+		for (size_t i = 0; i < bucket.size(); ++i) {
+			if (bucket[i].hash == h && ircEquals(StrView(bucket[i].key), name))
+				return &bucket[i].value;
+		}
+		return NULL;
+	}
+
+	// Retourne false si le nom est déjà présent (rien n'est modifié)
+	bool insert(const StrView& name, const V& value) {
+		if (find(name) != NULL)
+			return false;
+		if (count >= buckets.size())
+			rehash(buckets.size() * 2);
+		Entry e;
+		e.key = ircFold(name);
+		e.hash = ircHash(name);
+		e.value = value;
+		buckets[e.hash & (buckets.size() - 1)].push_back(e);
+		++count;
+		return true;
+	}
+
+	bool erase(const StrView& name) {
+		size_t h = ircHash(name);
+		std::vector<Entry>& bucket = buckets[h & (buckets.size() - 1)];
+		for (size_t i = 0; i < bucket.size(); ++i) {
+			if (bucket[i].hash == h && ircEquals(StrView(bucket[i].key), name)) {
+				bucket[i] = bucket.back();
+				bucket.pop_back();
+				--count;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	size_t size() const { return count; }
+
+	// Appelle `visit` sur chaque valeur, dans un ordre quelconque
+	void forEach(void (*visit)(V&)) {
+		for (size_t b = 0; b < buckets.size(); ++b) {
+			for (size_t i = 0; i < buckets[b].size(); ++i)
+				visit(buckets[b][i].value);
+		}
+	}
+
+private:
+	struct Entry {
+		std::string key;   // Forme repliée
+		size_t hash;
+		V value;
+	};
+
+	void rehash(size_t newSize) {
+		std::vector< std::vector<Entry> > old(newSize);
+		old.swap(buckets);
+		for (size_t b = 0; b < old.size(); ++b) {
+			for (size_t i = 0; i < old[b].size(); ++i)
+				buckets[old[b][i].hash & (newSize - 1)].push_back(old[b][i]);
+		}
+	}
+
+	std::vector< std::vector<Entry> > buckets; // Taille toujours puissance de 2
+	size_t count;
+};
+
+#endif // IRCMAP_HPP
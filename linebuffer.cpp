@@ -0,0 +1,156 @@
+#include "linebuffer.hpp"
+#include "bufferpool.hpp"
+#include <cstring>
+#include <new>
+
+LineBuffer::LineBuffer(BufferPool* pool)
+	: pool(pool), data(NULL), capacity(0), start(0), end(0), scanned(0), external(false), discarding(false) {}
+
+LineBuffer::LineBuffer(const LineBuffer& other)
+	: pool(other.pool), data(NULL), capacity(0), start(0), end(0), scanned(0), external(false), discarding(false) {
+	copyPending(other);
+}
+
+LineBuffer& LineBuffer::operator=(const LineBuffer& other) {
+	if (this != &other) {
+		releaseStorage();
+		pool = other.pool;
+		copyPending(other);
+	}
+	return *this;
+}
+
+LineBuffer::~LineBuffer() {
+	releaseStorage();
+}
+
+void LineBuffer::copyPending(const LineBuffer& other) {
+	size_t len = other.pending();
+	if (len != 0) {
+		std::memcpy(prepare(len), other.data + other.start, len);
+		commit(len);
+	}
+	scanned = other.scanned - other.start;
+	discarding = other.discarding;
+}
+
+void LineBuffer::releaseStorage() {
+	if (capacity != 0) {
+		if (pool)
+			pool->release(data, capacity);
+		else
+			::operator delete(data);
+	}
+	data = NULL;
+	capacity = 0;
+	external = false;
+	start = end = scanned = 0;
+}
+
+// Ramène la ligne partielle en tête d'un tampon propre d'au moins
+// pending() + len octets
+void LineBuffer::reserve(size_t len) {
+	size_t kept = end - start;
+	size_t need = kept + len;
+	if (!external && capacity >= need) {
+		std::memmove(data, data + start, kept);
+	} else {
+		size_t size = (capacity * 2 > need) ? capacity * 2 : need;
+		char* grown;
+		if (pool) {
+			grown = static_cast<char*>(pool->allocate(size));
+			size = BufferPool::sizeFor(size);
+		} else {
+			grown = static_cast<char*>(::operator new(size));
+		}
+		if (kept != 0)
+			std::memcpy(grown, data + start, kept);
+		if (capacity != 0) {
+			if (pool)
+				pool->release(data, capacity);
+			else
+				::operator delete(data);
+		}
+		data = grown;
+		capacity = size;
+		external = false;
+	}
+	end = kept;
+	scanned -= start;
+	start = 0;
+}
+
+char* LineBuffer::prepare(size_t len) {
+	if (start == end && !external)
+		start = end = scanned = 0;
+	if (external || capacity - end < len)
+		reserve(len);
+	return data + end;
+}
+
+void LineBuffer::commit(size_t len) {
+	end += len;
+}
+
+void LineBuffer::feed(const char* bytes, size_t len) {
+	if (start == end) {
+		releaseStorage();
+		data = const_cast<char*>(bytes);
+		end = len;
+		external = true;
+	} else {
+		std::memcpy(prepare(len), bytes, len);
+		commit(len);
+	}
+}
+
+void LineBuffer::settle() {
+	if (start == end)
+		releaseStorage();
+	else if (external)
+		reserve(0);
+}
+
+LineBuffer::Status LineBuffer::nextLine(StrView& line) {
+	while (true) {
+		if (scanned == end)
+			return NEED_MORE;
+		const char* base = data;
+		const char* nl = static_cast<const char*>(std::memchr(base + scanned, '\n', end - scanned));
+		if (nl == NULL) {
+			scanned = end;
+			if (discarding) {
+				start = end;
+			} else if (end - start > MAX_LINE) {
+				discarding = true;
+				start = end;
+				return LINE_TOO_LONG;
+			}
+			return NEED_MORE;
+		}
+
+		size_t pos = static_cast<size_t>(nl - base);
+		size_t lineStart = start;
+		start = scanned = pos + 1;
+		if (discarding) {
+			discarding = false;
+			continue;
+		}
+
+		size_t len = pos - lineStart;
+		if (len > 0 && base[lineStart + len - 1] == '\r')
+			--len;
+		if (len + 2 > MAX_LINE)
+			return LINE_TOO_LONG;
+		line = StrView(base + lineStart, len);
+		return LINE_READY;
+	}
+}
+
+size_t LineBuffer::pending() const {
+	return end - start;
+}
+
+StrView LineBuffer::unread() const {
+	return data == NULL ? StrView() : StrView(data + start, end - start);
+}
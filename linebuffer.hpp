@@ -0,0 +1,70 @@
+#ifndef LINEBUFFER_HPP
+#define LINEBUFFER_HPP
+
+#include <cstddef>
+#include "strview.hpp"
+
+class BufferPool;
+
+// Tampon de réception d'un client, découpé en lignes IRC. nextLine() rend
+// des vues sur les lignes complètes terminées par CRLF ou LF ; une ligne
+// incomplète reste en attente jusqu'à la lecture suivante.
+//
+// Côté serveur, les octets lus restent dans la zone commune du shard
+// (feed) : les lignes complètes y sont traitées sans copie, puis settle()
+// ne recopie que le reste éventuel dans un morceau emprunté au pool, rendu
+// dès qu'il est vidé. Un client inactif n'a donc aucun tampon.
+// Sans pool (ircbench, microbench), prepare/commit lisent directement dans
+// un tampon propre qui s'agrandit au besoin.
+// Les vues rendues restent valides jusqu'au prochain prepare(), feed() ou
+// settle().
+class LineBuffer {
+public:
+	enum Status {
+		LINE_READY,     // `line` contient une ligne complète, sans CR/LF
+		LINE_TOO_LONG,  // Ligne au-delà de MAX_LINE, ignorée jusqu'au LF suivant
+		NEED_MORE       // Pas de ligne complète dans le tampon
+	};
+
+	static const size_t MAX_LINE = 512; // Limite IRC, CRLF compris
+
+	explicit LineBuffer(BufferPool* pool = NULL);
+	LineBuffer(const LineBuffer& other);
+	LineBuffer& operator=(const LineBuffer& other);
+	~LineBuffer();
+
+	// Garantit `len` octets libres en fin de tampon et retourne leur adresse
+	char* prepare(size_t len);
+	// Valide `len` octets écrits après prepare()
+	void commit(size_t len);
+	// Octets reçus ailleurs (zone commune, tampon io_uring) : lus sur place
+	// si rien n'est en attente, sinon ajoutés à la suite. `bytes` doit rester
+	// valide jusqu'au settle() suivant.
+	void feed(const char* bytes, size_t len);
+	// Après traitement : le reste non rendu passe dans un tampon propre ; un
+	// tampon vidé est rendu au pool
+	void settle();
+	Status nextLine(StrView& line);
+	// Octets reçus mais pas encore rendus sous forme de ligne
+	size_t pending() const;
+	// Ces octets eux-mêmes (redémarrage à chaud)
+	StrView unread() const;
+	// Mémoire tenue par ce tampon (hors l'objet lui-même)
+	size_t memoryUsage() const { return capacity; }
+
+private:
+	void reserve(size_t len);
+	void releaseStorage();
+	void copyPending(const LineBuffer& other);
+
+	BufferPool* pool;  // NULL : tas
+	char* data;        // Tampon propre, zone extérieure (feed) ou NULL
+	size_t capacity;   // Taille du tampon propre, 0 sinon
+	size_t start;      // Début de la première ligne non rendue
+	size_t end;        // Fin des données reçues
+	size_t scanned;    // Position jusqu'où aucun LF n'a été trouvé
+	bool external;     // `data` appartient à l'appelant de feed()
+	bool discarding;   // En train d'ignorer la fin d'une ligne trop longue
+};
+
+#endif // LINEBUFFER_HPP
@@ -0,0 +1,331 @@
+#include "linescan.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+# include <immintrin.h>
+# define HAVE_X86_SIMD 1
+#endif
+
+size_t LineScan::nextSpace(size_t from) const {
+	while (from < len) {
+		uint64_t bits = spaces[from >> 6] >> (from & 63);
+		if (bits)
+			return from + __builtin_ctzll(bits);
+		from = ((from >> 6) + 1) << 6;
+	}
+	return len;
+}
+
+size_t LineScan::nextNonSpace(size_t from) const {
+	while (from < len) {
+		uint64_t bits = ~spaces[from >> 6] >> (from & 63);
+		if (bits) {
+			size_t pos = from + __builtin_ctzll(bits);
+			return pos < len ? pos : len;
+		}
+		from = ((from >> 6) + 1) << 6;
+	}
+	return len;
+}
+
+/* ************************************************************************** */
+/*                                   scalaire                                 */
+/* ************************************************************************** */
+
+// Validation stricte (RFC 3629) : chaque octet de tête fixe la plage
+// autorisée pour le premier octet de continuation
+static bool validateScalar(const unsigned char* p, size_t n) {
+	size_t i = 0;
+	while (i < n) {
+		unsigned char c = p[i];
+		if (c < 0x80) {
+			++i;
+			continue;
+		}
+		size_t extra;
+		unsigned char lo = 0x80, hi = 0xBF;
+		if (c >= 0xC2 && c <= 0xDF) {
+			extra = 1;
+		} else if (c >= 0xE0 && c <= 0xEF) {
+			extra = 2;
+			if (c == 0xE0)
+				lo = 0xA0;      // Trop longue
+			else if (c == 0xED)
+				hi = 0x9F;      // Surrogates U+D800..U+DFFF
+		} else if (c >= 0xF0 && c <= 0xF4) {
+			extra = 3;
+			if (c == 0xF0)
+				lo = 0x90;      // Trop longue
+			else if (c == 0xF4)
+				hi = 0x8F;      // Au-delà de U+10FFFF
+		} else {
+			return false;       // Continuation isolée, C0/C1, F5..FF
+		}
+		if (n - i <= extra)
+			return false;
+		if (p[i + 1] < lo || p[i + 1] > hi)
+			return false;
+		for (size_t k = 2; k <= extra; ++k) {
+			if ((p[i + k] & 0xC0) != 0x80)
+				return false;
+		}
+		i += extra + 1;
+	}
+	return true;
+}
+
+static bool scanScalar(const char* p, size_t n, uint64_t* spaces) {
+	if (spaces) {
+		for (size_t i = 0; i < n; ++i) {
+			if (p[i] == ' ')
+				spaces[i >> 6] |= static_cast<uint64_t>(1) << (i & 63);
+		}
+	}
+	return validateScalar(reinterpret_cast<const unsigned char*>(p), n);
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* ************************************************************************** */
+/*                                    SSE2                                    */
+/* ************************************************************************** */
+
+// 16 octets par tour : espaces et détection d'octets non ASCII. Une ligne
+// entièrement ASCII (le cas courant) n'est lue qu'une fois ; sinon la
+// validation scalaire reprend au premier octet non ASCII.
+static bool scanSse2(const char* p, size_t n, uint64_t* spaces) {
+	const __m128i space = _mm_set1_epi8(' ');
+	size_t firstHigh = n;
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		if (spaces) {
+			uint64_t mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(input, space)));
+			spaces[i >> 6] |= mask << (i & 63);
+		}
+		if (firstHigh == n && _mm_movemask_epi8(input) != 0)
+			firstHigh = i;
+	}
+	for (; i < n; ++i) {
+		if (spaces && p[i] == ' ')
+			spaces[i >> 6] |= static_cast<uint64_t>(1) << (i & 63);
+		if (firstHigh == n && static_cast<unsigned char>(p[i]) >= 0x80)
+			firstHigh = i;
+	}
+	if (firstHigh == n)
+		return true;
+	return validateScalar(reinterpret_cast<const unsigned char*>(p) + firstHigh, n - firstHigh);
+}
+
+/* ************************************************************************** */
+/*                                    AVX2                                    */
+/* ************************************************************************** */
+
+// Validation par tables (Keiser & Lemire, « Validating UTF-8 In Less Than
+// One Instruction Per Byte ») : trois recherches de 16 entrées sur les
+// quartets de chaque paire d'octets consécutifs donnent un masque d'erreurs,
+// complété par la vérification des 3e/4e octets des séquences longues.
+enum {
+	TOO_SHORT = 1 << 0,      // Tête suivie d'une tête ou d'ASCII
+	TOO_LONG = 1 << 1,       // ASCII suivi d'une continuation
+	OVERLONG_3 = 1 << 2,     // E0 80..9F
+	TOO_LARGE = 1 << 3,      // F4 90..BF, F5..FF
+	SURROGATE = 1 << 4,      // ED A0..BF
+	OVERLONG_2 = 1 << 5,     // C0, C1
+	TOO_LARGE_1000 = 1 << 6, // F5..FF 80..8F
+	OVERLONG_4 = 1 << 6,     // F0 80..8F
+	TWO_CONTS = 1 << 7,      // Deux continuations hors séquence
+	CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS
+};
+
+__attribute__((target("avx2")))
+static inline __m256i lookup16(__m256i index, const __m256i& table) {
+	return _mm256_shuffle_epi8(table, index);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i highNibbles(__m256i v) {
+	return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+// Octets décalés de N positions, en reprenant la fin du bloc précédent
+template <int N>
+__attribute__((target("avx2")))
+static inline __m256i previous(__m256i input, __m256i prev) {
+	return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i checkBlock(__m256i input, __m256i prev) {
+	const __m256i byte1High = _mm256_setr_epi8(
+		TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+		TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+		TOO_SHORT | OVERLONG_2,
+		TOO_SHORT,
+		TOO_SHORT | OVERLONG_3 | SURROGATE,
+		TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+		TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+		TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+		TOO_SHORT | OVERLONG_2,
+		TOO_SHORT,
+		TOO_SHORT | OVERLONG_3 | SURROGATE,
+		TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+	const __m256i byte1Low = _mm256_setr_epi8(
+		CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+		CARRY | OVERLONG_2,
+		CARRY, CARRY,
+		CARRY | TOO_LARGE,
+		CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+		CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+		CARRY | OVERLONG_2,
+		CARRY, CARRY,
+		CARRY | TOO_LARGE,
+		CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+		CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000);
+	const __m256i byte2High = _mm256_setr_epi8(
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+	__m256i prev1 = previous<1>(input, prev);
+	__m256i special = _mm256_and_si256(
+		_mm256_and_si256(lookup16(highNibbles(prev1), byte1High),
+			lookup16(_mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)), byte1Low)),
+		lookup16(highNibbles(input), byte2High));
+
+	// Les 3e et 4e octets d'une séquence doivent être des continuations
+	__m256i prev2 = previous<2>(input, prev);
+	__m256i prev3 = previous<3>(input, prev);
+	__m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+	__m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+	__m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+	return _mm256_xor_si256(must23, special);
+}
+
+// Séquence commencée dans les derniers octets du bloc, à finir au suivant
+__attribute__((target("avx2")))
+static inline __m256i incompleteTail(__m256i input) {
+	const __m256i maxValue = _mm256_setr_epi8(
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+	return _mm256_subs_epu8(input, maxValue);
+}
+
+__attribute__((target("avx2")))
+static bool scanAvx2(const char* p, size_t n, uint64_t* spaces) {
+	const __m256i space = _mm256_set1_epi8(' ');
+	__m256i error = _mm256_setzero_si256();
+	__m256i prev = _mm256_setzero_si256();
+	__m256i incomplete = _mm256_setzero_si256();
+	char tail[32];
+
+	for (size_t i = 0; i < n; i += 32) {
+		__m256i input;
+		if (i + 32 <= n) {
+			input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+		} else {
+			// Dernier bloc complété par des zéros (ASCII, donc neutres)
+			std::memset(tail, 0, sizeof(tail));
+			std::memcpy(tail, p + i, n - i);
+			input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail));
+		}
+		if (spaces) {
+			uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(input, space)));
+			spaces[i >> 6] |= mask << (i & 63);
+		}
+		if (_mm256_movemask_epi8(input) == 0) {
+			error = _mm256_or_si256(error, incomplete);
+			incomplete = _mm256_setzero_si256();
+		} else {
+			error = _mm256_or_si256(error, checkBlock(input, prev));
+			incomplete = incompleteTail(input);
+		}
+		prev = input;
+	}
+	error = _mm256_or_si256(error, incomplete);
+	return _mm256_testz_si256(error, error) != 0;
+}
+
+#endif // HAVE_X86_SIMD
+
+/* ************************************************************************** */
+/*                             Sélection du noyau                             */
+/* ************************************************************************** */
+
+typedef bool (*ScanKernel)(const char* p, size_t n, uint64_t* spaces);
+
+struct KernelChoice {
+	ScanKernel scan;
+	const char* name;
+};
+
+static KernelChoice selectKernel() {
+	KernelChoice choice;
+	choice.scan = scanScalar;
+	choice.name = "scalar";
+#ifdef HAVE_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		choice.scan = scanAvx2;
+		choice.name = "avx2";
+	} else {
+		choice.scan = scanSse2;   // Toujours disponible en x86-64
+		choice.name = "sse2";
+	}
+#endif
+	return choice;
+}
+
+static const KernelChoice kernel = selectKernel();
+
+bool scanLine(const StrView& line, LineScan& scan) {
+	std::memset(scan.spaces, 0, sizeof(scan.spaces));
+	scan.len = line.len;
+	if (line.len > LineScan::MAX_BYTES)
+		return false;
+	return kernel.scan(line.ptr, line.len, scan.spaces);
+}
+
+bool isValidUTF8(const StrView& str) {
+	return kernel.scan(str.ptr, str.len, NULL);
+}
+
+const char* lineScanKernel() {
+	return kernel.name;
+}
+
+size_t lineScanKernels(LineScanKernel* out, size_t max) {
+	LineScanKernel all[3];
+	size_t count = 0;
+	all[count].name = "scalar";
+	all[count++].scan = scanScalar;
+#ifdef HAVE_X86_SIMD
+	all[count].name = "sse2";
+	all[count++].scan = scanSse2;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		all[count].name = "avx2";
+		all[count++].scan = scanAvx2;
+	}
+#endif
+	for (size_t i = 0; i < count && i < max; ++i)
+		out[i] = all[i];
+	return count < max ? count : max;
+}
@@ -0,0 +1,47 @@
+#ifndef LINESCAN_HPP
+#define LINESCAN_HPP
+
+#include <stdint.h>
+#include "strview.hpp"
+
+// Résultat d'un seul passage sur une ligne reçue : validité UTF-8 et
+// position des espaces (bit i de spaces[i / 64] pour l'octet i). Le
+// découpage en paramètres (parseMessage) saute ensuite d'espace en espace
+// sans relire les octets.
+struct LineScan {
+	static const size_t MAX_BYTES = 512;   // Longueur maximale d'une ligne IRC
+	static const size_t WORDS = MAX_BYTES / 64;
+
+	uint64_t spaces[WORDS];
+	size_t len;
+
+	// Position du prochain espace à partir de `from`, ou len
+	size_t nextSpace(size_t from) const;
+	// Position du prochain octet qui n'est pas un espace, ou len
+	size_t nextNonSpace(size_t from) const;
+};
+
+// Valide l'UTF-8 (séquences trop longues, surrogates et points de code
+// au-delà de U+10FFFF refusés) et relève les espaces, en une passe. Retourne
+// false si l'UTF-8 est invalide ; les lignes plus longues que MAX_BYTES sont
+// refusées.
+bool scanLine(const StrView& line, LineScan& scan);
+
+// Validation seule, pour une longueur quelconque
+bool isValidUTF8(const StrView& str);
+
+// Noyau retenu au démarrage selon le processeur : "avx2", "sse2" ou "scalar"
+const char* lineScanKernel();
+
+// Un noyau d'analyse : valide p[0..n) et, si `spaces` n'est pas NULL, y
+// ajoute les bits des espaces (le tableau doit couvrir n octets)
+struct LineScanKernel {
+	const char* name;
+	bool (*scan)(const char* p, size_t n, uint64_t* spaces);
+};
+
+// Noyaux utilisables sur ce processeur, le scalaire (référence) en premier ;
+// pour la vérification croisée (make linescancheck). Retourne leur nombre.
+size_t lineScanKernels(LineScanKernel* out, size_t max);
+
+#endif // LINESCAN_HPP
@@ -0,0 +1,213 @@
+// Vérification croisée des noyaux d'analyse de ligne (make linescancheck) :
+// chaque noyau vectoriel disponible (sse2, avx2) doit donner le même
+// verdict UTF-8 et la même carte des espaces que le noyau scalaire, sur des
+// séquences placées à cheval sur les blocs de 16, 32 et 64 octets puis sur
+// des lignes aléatoires. ./irclinescancheck [graine] [tirages]
+#include "linescan.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+static const size_t MAX_KERNELS = 4;
+static const size_t MAX_FAILURES = 10;
+
+static LineScanKernel kernels[MAX_KERNELS];
+static size_t kernelCount = 0;
+static unsigned long long checked = 0;
+static size_t failures = 0;
+
+// xorshift64 : reproductible d'une machine à l'autre pour une même graine
+static uint64_t state = 88172645463325252ULL;
+
+static uint64_t nextRandom() {
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+static size_t randomBelow(size_t n) {
+	return static_cast<size_t>(nextRandom() % n);
+}
+
+static void dump(const char* p, size_t n) {
+	for (size_t i = 0; i < n; ++i)
+		std::printf("%02x%s", static_cast<unsigned char>(p[i]), (i + 1) % 32 == 0 ? "\n    " : " ");
+	std::printf("\n");
+}
+
+// Compare chaque noyau au scalaire (kernels[0]), avec et sans carte des
+// espaces ; n ne dépasse pas LineScan::MAX_BYTES
+static void check(const char* p, size_t n) {
+	uint64_t expected[LineScan::WORDS];
+	std::memset(expected, 0, sizeof(expected));
+	bool valid = kernels[0].scan(p, n, expected);
+	for (size_t k = 1; k < kernelCount; ++k) {
+		uint64_t spaces[LineScan::WORDS];
+		std::memset(spaces, 0, sizeof(spaces));
+		bool got = kernels[k].scan(p, n, spaces);
+		bool alone = kernels[k].scan(p, n, NULL);
+		++checked;
+		if (got == valid && alone == valid && std::memcmp(spaces, expected, sizeof(spaces)) == 0)
+			continue;
+		if (++failures <= MAX_FAILURES) {
+			std::printf("ÉCART %s : scalaire %s, %s %s (sans carte : %s), espaces %s, %lu octets :\n    ",
+				kernels[k].name, valid ? "valide" : "invalide", kernels[k].name, got ? "valide" : "invalide",
+				alone ? "valide" : "invalide", std::memcmp(spaces, expected, sizeof(spaces)) == 0 ? "identiques" : "différents",
+				static_cast<unsigned long>(n));
+			dump(p, n);
+		}
+	}
+}
+
+/* ************************************************************************** */
+/*                                  Bornes                                    */
+/* ************************************************************************** */
+
+// Positions autour des frontières de blocs SSE2 (16), AVX2 (32) et des mots
+// de la carte des espaces (64)
+static const size_t OFFSETS[] = { 0, 1, 13, 14, 15, 16, 17, 29, 30, 31, 32, 33, 61, 62, 63, 64, 65 };
+static const size_t OFFSET_COUNT = sizeof(OFFSETS) / sizeof(OFFSETS[0]);
+
+// Octets qui bornent les plages de RFC 3629
+static const unsigned char EDGES[] = {
+	0x00, 0x20, 0x7F, 0x80, 0x8F, 0x90, 0x9F, 0xA0, 0xAF, 0xBF, 0xC0, 0xC1, 0xC2, 0xDF, 0xE0, 0xED, 0xF0, 0xF4, 0xF5, 0xFF
+};
+static const size_t EDGE_COUNT = sizeof(EDGES) / sizeof(EDGES[0]);
+
+// `seq` entouré d'ASCII (avec espaces) à chaque position, puis en fin de
+// ligne (séquence éventuellement coupée par la fin)
+static void placeEverywhere(const unsigned char* seq, size_t len) {
+	char line[128];
+	for (size_t o = 0; o < OFFSET_COUNT; ++o) {
+		size_t at = OFFSETS[o];
+		for (size_t i = 0; i < sizeof(line); ++i)
+			line[i] = (i % 7 == 3) ? ' ' : 'a';
+		std::memcpy(line + at, seq, len);
+		check(line, at + len + 19);
+		check(line, at + len);
+		if (len > 1)
+			check(line, at + len - 1);
+	}
+}
+
+static void checkBoundaries() {
+	unsigned char seq[4];
+	for (unsigned a = 0; a < 256; ++a) {
+		seq[0] = static_cast<unsigned char>(a);
+		placeEverywhere(seq, 1);
+		for (unsigned b = 0; b < 256; ++b) {
+			seq[1] = static_cast<unsigned char>(b);
+			placeEverywhere(seq, 2);
+		}
+	}
+	for (unsigned a = 0xC0; a < 256; ++a) {
+		seq[0] = static_cast<unsigned char>(a);
+		for (size_t b = 0; b < EDGE_COUNT; ++b) {
+			seq[1] = EDGES[b];
+			for (size_t c = 0; c < EDGE_COUNT; ++c) {
+				seq[2] = EDGES[c];
+				placeEverywhere(seq, 3);
+				if (a < 0xF0)
+					continue;
+				for (size_t d = 0; d < EDGE_COUNT; ++d) {
+					seq[3] = EDGES[d];
+					placeEverywhere(seq, 4);
+				}
+			}
+		}
+	}
+}
+
+/* ************************************************************************** */
+/*                                 Aléatoire                                  */
+/* ************************************************************************** */
+
+// Point de code valide encodé en UTF-8 ; espaces et ASCII surreprésentés
+static size_t randomChar(unsigned char* out) {
+	size_t kind = randomBelow(8);
+	if (kind < 3) {
+		out[0] = randomBelow(4) == 0 ? ' ' : static_cast<unsigned char>(0x21 + randomBelow(0x5E));
+		return 1;
+	}
+	uint32_t cp;
+	if (kind < 5)
+		cp = 0x80 + static_cast<uint32_t>(randomBelow(0x800 - 0x80));
+	else if (kind < 7) {
+		do
+			cp = 0x800 + static_cast<uint32_t>(randomBelow(0x10000 - 0x800));
+		while (cp >= 0xD800 && cp <= 0xDFFF);
+	} else
+		cp = 0x10000 + static_cast<uint32_t>(randomBelow(0x110000 - 0x10000));
+	if (cp < 0x800) {
+		out[0] = static_cast<unsigned char>(0xC0 | (cp >> 6));
+		out[1] = static_cast<unsigned char>(0x80 | (cp & 0x3F));
+		return 2;
+	}
+	if (cp < 0x10000) {
+		out[0] = static_cast<unsigned char>(0xE0 | (cp >> 12));
+		out[1] = static_cast<unsigned char>(0x80 | ((cp >> 6) & 0x3F));
+		out[2] = static_cast<unsigned char>(0x80 | (cp & 0x3F));
+		return 3;
+	}
+	out[0] = static_cast<unsigned char>(0xF0 | (cp >> 18));
+	out[1] = static_cast<unsigned char>(0x80 | ((cp >> 12) & 0x3F));
+	out[2] = static_cast<unsigned char>(0x80 | ((cp >> 6) & 0x3F));
+	out[3] = static_cast<unsigned char>(0x80 | (cp & 0x3F));
+	return 4;
+}
+
+// Lignes valides, puis la moitié abîmées (octets remplacés ou fin coupée) ;
+// quelques-unes entièrement aléatoires
+static void checkRandom(unsigned long draws) {
+	unsigned char line[LineScan::MAX_BYTES];
+	for (unsigned long d = 0; d < draws; ++d) {
+		size_t target = randomBelow(LineScan::MAX_BYTES + 1);
+		size_t n = 0;
+		if (randomBelow(16) == 0) {
+			for (; n < target; ++n)
+				line[n] = static_cast<unsigned char>(nextRandom());
+		} else {
+			unsigned char ch[4];
+			while (true) {
+				size_t len = randomChar(ch);
+				if (n + len > target)
+					break;
+				std::memcpy(line + n, ch, len);
+				n += len;
+			}
+			if (n > 0 && randomBelow(2) == 0) {
+				size_t damage = 1 + randomBelow(3);
+				for (size_t i = 0; i < damage; ++i)
+					line[randomBelow(n)] = static_cast<unsigned char>(nextRandom());
+			}
+			if (n > 0 && randomBelow(8) == 0)
+				n -= 1 + randomBelow(n < 3 ? n : 3);
+		}
+		check(reinterpret_cast<const char*>(line), n);
+	}
+}
+
+int main(int argc, char** argv) {
+	uint64_t seed = argc > 1 ? std::strtoull(argv[1], NULL, 10) : static_cast<uint64_t>(time(NULL));
+	unsigned long draws = argc > 2 ? std::strtoul(argv[2], NULL, 10) : 200000;
+	state ^= seed * 0x9E3779B97F4A7C15ULL;
+	if (state == 0)
+		state = 1;
+
+	kernelCount = lineScanKernels(kernels, MAX_KERNELS);
+	std::printf("linescancheck : graine %llu, noyaux", static_cast<unsigned long long>(seed));
+	for (size_t k = 0; k < kernelCount; ++k)
+		std::printf(" %s", kernels[k].name);
+	std::printf(" (retenu : %s)\n", lineScanKernel());
+	if (kernelCount < 2) {
+		std::printf("linescancheck : aucun noyau vectoriel à comparer\n");
+		return 0;
+	}
+
+	checkBoundaries();
+	checkRandom(draws);
+	std::printf("linescancheck : %llu comparaisons, %lu écart(s)\n", checked, static_cast<unsigned long>(failures));
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,629 @@
+#include "server.hpp"
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <netdb.h>
+#include <sys/time.h>
+
+/*
+ * Protocole entre serveurs, dans l'esprit de la RFC 2813 : des lignes IRC
+ * ordinaires, les utilisateurs étant désignés par leur pseudo (unique dans
+ * tout le réseau).
+ *
+ *   PASS <mot de passe>              } poignée de main dans les deux sens,
+ *   SERVER <nom>                     } suivie de la salve (état complet)
+ *   SERVER <nom>                     serveur joignable par l'émetteur
+ *   SQUIT <nom> :<raison>            serveur perdu (netsplit)
+ *   NICK <pseudo> <serveur>          pseudo réservé sur <serveur>
+ *   :<pseudo> NICK :<nouveau>
+ *   :<pseudo> QUIT :<raison>
+ *   KILL <pseudo> :<raison>          collision : tué sur son serveur
+ *   NJOIN <canal> :[@][+]<pseudo>,...   membres d'un canal (salve)
+ *   :<pseudo> JOIN|PART|KICK|TOPIC|MODE ...   tels que vus par les clients
+ *   :<pseudo> PRIVMSG <cible> :<texte>
+ *
+ * Les changements d'état partent vers tous les liens sauf celui d'origine :
+ * le réseau étant un arbre, chaque serveur les reçoit une fois. Un PRIVMSG
+ * de canal ne part que vers les liens qui mènent à des membres, un PRIVMSG
+ * privé que vers le lien qui mène au destinataire.
+ */
+
+/* ************************************************************************** */
+/*                          Connexions sortantes                              */
+/* ************************************************************************** */
+
+LinkConnector::LinkConnector(const std::vector<std::string>& addresses, Mailbox& mailbox) : mailbox(mailbox) {
+	for (size_t i = 0; i < addresses.size(); ++i) {
+		Peer peer;
+		std::string::size_type colon = addresses[i].rfind(':');
+		peer.address = addresses[i];
+		peer.host = addresses[i].substr(0, colon);
+		peer.port = addresses[i].substr(colon + 1);
+		peer.connected = 0;
+		peer.nextTry = 0;
+		peers.push_back(peer);
+	}
+}
+
+bool LinkConnector::start() {
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, run, this) != 0)
+		return false;
+	pthread_detach(thread);
+	return true;
+}
+
+void LinkConnector::disconnected(size_t peer) {
+	__atomic_store_n(&peers[peer].connected, 0, __ATOMIC_RELEASE);
+}
+
+const std::string& LinkConnector::peerName(size_t peer) const {
+	return peers[peer].address;
+}
+
+void* LinkConnector::run(void* arg) {
+	LinkConnector* self = static_cast<LinkConnector*>(arg);
+	while (true) {
+		time_t now = time(NULL);
+		for (size_t i = 0; i < self->peers.size(); ++i) {
+			Peer& peer = self->peers[i];
+			if (__atomic_load_n(&peer.connected, __ATOMIC_ACQUIRE) || now < peer.nextTry)
+				continue;
+			// Après une perte comme après un échec, attendre avant de réessayer
+			peer.nextTry = now + RETRY_SECONDS;
+			int fd = self->connectTo(peer);
+			if (fd < 0) {
+				LOG_DEBUG(LOG_NET, "Lien vers " << peer.address << " impossible : " << strerror(errno));
+				continue;
+			}
+			__atomic_store_n(&peer.connected, 1, __ATOMIC_RELEASE);
+			ShardMessage* msg = new ShardMessage(ShardMessage::LINK_CONNECTED);
+			msg->fd = fd;
+			msg->target = static_cast<ClientId>(i);
+			self->mailbox.post(msg, msg);
+		}
+		sleep(1);
+	}
+	return NULL;
+}
+
+int LinkConnector::connectTo(const Peer& peer) {
+	struct addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo* result;
+	if (getaddrinfo(peer.host.c_str(), peer.port.c_str(), &hints, &result) != 0)
+		return -1;
+	int fd = -1;
+	for (struct addrinfo* ai = result; ai != NULL; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		// Sous Linux, SO_SNDTIMEO borne aussi la durée de connect()
+		struct timeval timeout = { 3, 0 };
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(result);
+	return fd;
+}
+
+/* ************************************************************************** */
+/*                               Liens (shard 0)                              */
+/* ************************************************************************** */
+
+void Server::acceptLinks() {
+	while (true) {
+		int fd = accept(linkListenFd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				LOG_WARN(LOG_NET, "Accept de lien échoué - " << strerror(errno));
+			return;
+		}
+		acceptedLink(fd);
+	}
+}
+
+void Server::acceptedLink(int fd) {
+	if (fd < 0) {
+		LOG_WARN(LOG_NET, "Accept de lien échoué - " << strerror(-fd));
+		return;
+	}
+	openLink(fd, -1);
+}
+
+// Nouvelle connexion serveur, entrante (`peer` = -1) ou sortante : elle
+// devient un Client marqué comme lien, qui attend PASS et SERVER
+void Server::openLink(int fd, int peer) {
+	ServerLink *link = NULL;
+	for (size_t i = 0; i < links.size() && link == NULL; ++i) {
+		if (links[i].fd < 0)
+			link = &links[i];
+	}
+	if (upgrading) {
+		// Redémarrage à chaud : les liens ne sont pas transmis
+		close(fd);
+	} else if (link == NULL) {
+		LOG_WARN(LOG_NET, "Trop de liens serveur, connexion refusée");
+		close(fd);
+	}
+	Client *client = link && !upgrading ? adoptClient(fd) : NULL;
+	if (client == NULL) {
+		if (peer >= 0)
+			connector->disconnected(peer);
+		return;
+	}
+	client->link = link;
+	client->sendq.setLimit(LINK_SENDQ);
+	link->fd = fd;
+	link->peer = peer;
+	if (peer >= 0) {
+		LOG_INFO(LOG_NET, "Lien sortant vers " << connector->peerName(peer) << " ouvert");
+		queueReply(fd, "PASS " + config.linkPassword + "\r\nSERVER " + serverName + "\r\n");
+	} else {
+		LOG_INFO(LOG_NET, "Lien entrant accepté (fd " << fd << ")");
+	}
+}
+
+// Appelé par removeClient : les serveurs et utilisateurs joignables par ce
+// lien disparaissent (netsplit), et les autres liens en sont informés
+void Server::closeLink(ServerLink &link) {
+	if (link.peer >= 0)
+		connector->disconnected(link.peer);
+	if (link.established) {
+		LOG_WARN(LOG_NET, "Netsplit : lien avec " << link.name << " perdu");
+		std::string reason = serverName + " " + link.name;
+		for (std::set<std::string>::const_iterator it = link.servers.begin(); it != link.servers.end(); ++it)
+			linkOutput(BufferRef::copyOf("SQUIT " + *it + " :" + reason + "\r\n"), -1, MemberList(), static_cast<int>(link.index));
+		std::vector<ClientId> gone;
+		for (std::map<ClientId, RemoteUser>::const_iterator it = remoteUsers.begin(); it != remoteUsers.end(); ++it) {
+			if (remoteLink(it->first) == link.index)
+				gone.push_back(it->first);
+		}
+		for (size_t i = 0; i < gone.size(); ++i)
+			removeRemoteUser(gone[i], ":" + remoteUsers[gone[i]].nick + " QUIT :" + reason + "\r\n");
+	}
+	link.fd = -1;
+	link.peer = -1;
+	link.passOk = false;
+	link.established = false;
+	link.name.clear();
+	link.servers.clear();
+}
+
+bool Server::knownServer(const std::string &name) const {
+	for (size_t i = 0; i < links.size(); ++i) {
+		if (links[i].fd >= 0 && links[i].servers.count(name))
+			return true;
+	}
+	return false;
+}
+
+void Server::linkHandshake(ServerLink &link, const IrcMessage &msg) {
+	Client &client = *connections.find(link.fd);
+	if (msg.command == "PASS" && msg.paramCount >= 1) {
+		link.passOk = (msg.params[0] == config.linkPassword.c_str());
+		return;
+	}
+	if (!(msg.command == "SERVER") || msg.paramCount < 1) {
+		disconnectClient(client, "Not a server");
+		return;
+	}
+	std::string name = msg.params[0].str();
+	if (!link.passOk) {
+		LOG_WARN(LOG_NET, "Lien refusé pour " << name << " : mot de passe incorrect");
+		disconnectClient(client, "Bad link password");
+		return;
+	}
+	if (name == serverName || knownServer(name)) {
+		LOG_WARN(LOG_NET, "Lien refusé pour " << name << " : serveur déjà présent dans le réseau");
+		disconnectClient(client, "Server exists");
+		return;
+	}
+	if (link.peer < 0)
+		queueReply(link.fd, "PASS " + config.linkPassword + "\r\nSERVER " + serverName + "\r\n");
+	link.name = name;
+	link.servers.insert(name);
+	link.established = true;
+	LOG_INFO(LOG_NET, "Lien établi avec " << name);
+	// Le reste du réseau apprend le nouveau voisin, qui reçoit l'état actuel
+	linkOutput(BufferRef::copyOf("SERVER " + name + "\r\n"), -1, MemberList(), static_cast<int>(link.index));
+	sendBurst(link);
+}
+
+// Salve : serveurs, pseudos et canaux connus, sauf ce qui vient de ce lien
+void Server::sendBurst(ServerLink &link) {
+	std::string out;
+	for (size_t i = 0; i < links.size(); ++i) {
+		if (i == link.index || links[i].fd < 0 || !links[i].established)
+			continue;
+		for (std::set<std::string>::const_iterator it = links[i].servers.begin(); it != links[i].servers.end(); ++it)
+			out += "SERVER " + *it + "\r\n";
+	}
+
+	std::vector<std::pair<ClientId, std::string> > nicks;
+	shared->nicks(nicks);
+	std::map<ClientId, std::string> nickOf;
+	for (size_t i = 0; i < nicks.size(); ++i) {
+		ClientId id = nicks[i].first;
+		std::string server = serverName;
+		if (isRemote(id)) {
+			std::map<ClientId, RemoteUser>::const_iterator user = remoteUsers.find(id);
+			if (remoteLink(id) == link.index || user == remoteUsers.end())
+				continue;
+			server = user->second.server;
+		}
+		out += "NICK " + nicks[i].second + " " + server + "\r\n";
+		nickOf[id] = nicks[i].second;
+	}
+
+	std::vector<std::string> names;
+	shared->channelNames(names);
+	for (size_t c = 0; c < names.size(); ++c) {
+		ChannelLock lock(*shared, names[c]);
+		Channel *channel = lock.find();
+		if (channel == NULL)
+			continue;
+		std::string members;
+		bool sent = false;
+		for (MemberModes::const_iterator it = channel->clients.begin(); it != channel->clients.end(); ++it) {
+			std::map<ClientId, std::string>::const_iterator nick = nickOf.find(it->first);
+			if (nick == nickOf.end())
+				continue;
+			if (members.size() + nick->second.size() + channel->name.size() > 400) {
+				out += "NJOIN " + channel->name + " :" + members + "\r\n";
+				members.clear();
+				sent = true;
+			}
+			if (!members.empty())
+				members += ",";
+			if (it->second & MEMBER_OP)
+				members += "@";
+			if (it->second & MEMBER_VOICE)
+				members += "+";
+			members += nick->second;
+		}
+		if (!members.empty()) {
+			out += "NJOIN " + channel->name + " :" + members + "\r\n";
+			sent = true;
+		}
+		if (!sent)
+			continue;
+		std::string prefix = serverPrefix + " ";
+		if (!channel->topic.empty())
+			out += prefix + "TOPIC " + channel->name + " :" + channel->topic + "\r\n";
+		if (channel->inviteOnly)
+			out += prefix + "MODE " + channel->name + " +i\r\n";
+		if (channel->topicRestricted)
+			out += prefix + "MODE " + channel->name + " +t\r\n";
+		if (!channel->password.empty())
+			out += prefix + "MODE " + channel->name + " +k " + channel->password + "\r\n";
+		if (channel->userLimit > 0) {
+			std::ostringstream limit;
+			limit << channel->userLimit;
+			out += prefix + "MODE " + channel->name + " +l " + limit.str() + "\r\n";
+		}
+	}
+	queueReply(link.fd, out);
+	LOG_INFO(LOG_NET, "Salve envoyée à " << link.name << " : " << nickOf.size() << " pseudos, "
+		<< names.size() << " canaux");
+}
+
+// Envoi vers les liens, depuis n'importe quel shard : vers le lien qui mène
+// à l'utilisateur distant `target`, sinon vers les liens qui mènent à des
+// membres de `members`, sinon (les deux vides) vers tous les liens ; jamais
+// vers `exceptLink`, le lien d'où vient le message
+void Server::linkOutput(const BufferRef &line, ClientId target, const MemberList &members, int exceptLink) {
+	if (shardId != 0) {
+		ShardMessage *msg = new ShardMessage(ShardMessage::LINK_SEND);
+		msg->payload = line;
+		msg->target = target;
+		msg->members = members;
+		postTo(0, msg);
+		return;
+	}
+	for (size_t i = 0; i < links.size(); ++i) {
+		const ServerLink &link = links[i];
+		if (link.fd < 0 || !link.established || static_cast<int>(i) == exceptLink)
+			continue;
+		if (target >= 0 ? remoteLink(target) != i : (!members.isNull() && !members->hasShard(MAX_SHARDS + i)))
+			continue;
+		queueReply(link.fd, line);
+	}
+}
+
+// Changement d'état local, pour tous les liens
+void Server::propagate(const std::string &line) {
+	propagate(BufferRef::copyOf(line));
+}
+
+void Server::propagate(const BufferRef &line) {
+	linkOutput(line, -1, MemberList(), -1);
+}
+
+void Server::forwardLine(const StrView &line, const ServerLink &from) {
+	linkOutput(BufferRef::copyOf(line.str() + "\r\n"), -1, MemberList(), static_cast<int>(from.index));
+}
+
+// Utilisateur désigné par le préfixe (pseudo ou pseudo!utilisateur@hôte),
+// s'il est bien joignable par ce lien
+ClientId Server::remoteSender(const ServerLink &link, const IrcMessage &msg) {
+	if (msg.prefix.empty())
+		return -1;
+	const char *bang = static_cast<const char *>(std::memchr(msg.prefix.ptr, '!', msg.prefix.len));
+	size_t nickLen = bang ? static_cast<size_t>(bang - msg.prefix.ptr) : msg.prefix.len;
+	ClientId id = findClientByNick(std::string(msg.prefix.ptr, nickLen));
+	if (!isRemote(id) || remoteLink(id) != link.index || remoteUsers.count(id) == 0)
+		return -1;
+	return id;
+}
+
+// Ferme un client de n'importe quel shard
+void Server::disconnectAnywhere(ClientId id, const std::string &reason) {
+	if (clientShard(id) == shardId) {
+		if (Client *client = localClient(id))
+			disconnectClient(*client, reason);
+		return;
+	}
+	ShardMessage *msg = new ShardMessage(ShardMessage::DISCONNECT);
+	msg->target = id;
+	msg->payload = BufferRef::copyOf(reason);
+	postTo(clientShard(id), msg);
+}
+
+/* ************************************************************************** */
+/*                           Utilisateurs distants                            */
+/* ************************************************************************** */
+
+// Pseudo réservé sur un autre serveur. En cas de collision, le pseudo venu
+// du lien est tué sur son serveur ; lors d'une salve, les deux côtés voient
+// la même collision et aucun des deux utilisateurs ne survit (RFC 2813).
+void Server::introduceRemote(ServerLink &link, const std::string &nick, const std::string &server) {
+	ClientId id = makeRemoteId(link.index, link.nextUser++);
+	if (!shared->claimNick(nick, id)) {
+		LOG_WARN(LOG_IRC, "Collision de pseudo " << nick << " avec le serveur " << server);
+		queueReply(link.fd, "KILL " + nick + " :Nick collision\r\n");
+		return;
+	}
+	RemoteUser &user = remoteUsers[id];
+	user.nick = nick;
+	user.server = server;
+	linkOutput(BufferRef::copyOf("NICK " + nick + " " + server + "\r\n"), -1, MemberList(), static_cast<int>(link.index));
+}
+
+// Changement de pseudo déjà réservé par l'appelant
+void Server::renameRemote(ClientId id, const std::string &nick) {
+	RemoteUser &user = remoteUsers[id];
+	std::string line = ":" + user.nick + " NICK :" + nick + "\r\n";
+	if (!ircEquals(user.nick, nick))
+		shared->releaseNick(user.nick, id);
+	user.nick = nick;
+	std::set<ClientId> recipients;
+	collectNeighbors(id, user.channels, recipients);
+	notifyNeighbors(recipients, BufferRef::copyOf(line));
+}
+
+// Retire l'utilisateur de ses canaux et libère son pseudo ; les membres
+// locaux reçoivent `quitLine` une seule fois, même s'ils partagent
+// plusieurs canaux avec lui
+void Server::removeRemoteUser(ClientId id, const std::string &quitLine) {
+	std::map<ClientId, RemoteUser>::iterator found = remoteUsers.find(id);
+	if (found == remoteUsers.end())
+		return;
+	RemoteUser &user = found->second;
+	std::set<ClientId> recipients;
+	leaveChannels(id, user.channels, recipients);
+	notifyNeighbors(recipients, BufferRef::copyOf(quitLine));
+	shared->releaseNick(user.nick, id);
+	remoteUsers.erase(found);
+}
+
+// JOIN ou NJOIN d'un utilisateur distant. Hors salve, celui qui crée le
+// canal en devient opérateur, comme sur son propre serveur.
+void Server::remoteJoin(ClientId id, const std::string &channelName, bool burst, unsigned char modes) {
+	RemoteUser &user = remoteUsers[id];
+	ChannelLock lock(*shared, channelName);
+	Channel *existing = lock.find();
+	bool created = (existing == NULL);
+	Channel &channel = created ? lock.create() : *existing;
+	if (channel.clients.count(id))
+		return;
+	channel.clients[id] = burst ? modes : (created ? MEMBER_OP : 0);
+	publishMembers(channel);
+	if (user.channels.insert(lock.interned()).second)
+		lock.pin();
+	broadcast(channel, ":" + user.nick + " JOIN :" + channelName + "\r\n");
+}
+
+// Retire `id` (local ou distant) du canal après avoir annoncé `line` aux
+// membres locaux (PART ou KICK reçu d'un lien)
+void Server::remoteLeave(ClientId id, const std::string &channelName, const std::string &line) {
+	ChannelLock lock(*shared, channelName);
+	Channel *channel = lock.find();
+	if (channel == NULL || channel->clients.count(id) == 0)
+		return;
+	broadcast(*channel, line);
+	channel->clients.erase(id);
+	publishMembers(*channel);
+	// KICK venu d'un lien : l'expulsé peut être un client local
+	dropMembership(id, lock);
+	if (channel->clients.empty())
+		lock.erase();
+}
+
+/* ************************************************************************** */
+/*                              Messages reçus                                */
+/* ************************************************************************** */
+
+void Server::processLinkMessage(ServerLink &link, const StrView &line, const IrcMessage &msg) {
+	const StrView &command = msg.command;
+	if (command == "ERROR") {
+		LOG_WARN(LOG_NET, "Lien " << (link.name.empty() ? "en attente" : link.name) << " : "
+			<< (msg.paramCount ? msg.params[0] : StrView()));
+		return;
+	}
+	if (!link.established) {
+		linkHandshake(link, msg);
+		return;
+	}
+	std::string relayed = line.str() + "\r\n";
+
+	if (command == "PING") {
+		queueReply(link.fd, "PONG " + serverName + " :" + (msg.paramCount ? msg.params[0].str() : serverName) + "\r\n");
+	} else if (command == "PONG") {
+		// L'activité du lien suffit à repousser le délai d'inactivité
+	} else if (command == "PRIVMSG" && msg.paramCount >= 2) {
+		ClientId from = remoteSender(link, msg);
+		if (from < 0)
+			return;
+		std::string target = msg.params[0].str();
+		BufferRef payload = BufferRef::copyOf(relayed);
+		if (target[0] == '#' || target[0] == '&') {
+			MemberList members;
+			{
+				ChannelLock lock(*shared, target);
+				if (Channel *channel = lock.find())
+					members = channel->members;
+			}
+			if (members.isNull())
+				return;
+			deliverToMembers(members, payload, from);
+			shared->history().record(target, payload);
+			linkOutput(payload, -1, members, static_cast<int>(link.index));
+		} else {
+			ClientId to = findClientByNick(target);
+			if (to < 0 || (isRemote(to) && remoteLink(to) == link.index))
+				return;
+			if (isRemote(to))
+				linkOutput(payload, to, MemberList(), static_cast<int>(link.index));
+			else
+				sendTo(to, relayed);
+		}
+	} else if (command == "SERVER" && msg.paramCount >= 1) {
+		std::string name = msg.params[0].str();
+		if (name == serverName || knownServer(name)) {
+			LOG_WARN(LOG_NET, "Boucle : " << name << " annoncé par " << link.name << ", lien fermé");
+			disconnectClient(*connections.find(link.fd), "Server exists");
+			return;
+		}
+		link.servers.insert(name);
+		forwardLine(line, link);
+	} else if (command == "SQUIT" && msg.paramCount >= 1) {
+		std::string name = msg.params[0].str();
+		if (name == link.name || link.servers.erase(name) == 0)
+			return;
+		LOG_WARN(LOG_NET, "Netsplit : " << name << " perdu derrière " << link.name);
+		std::vector<ClientId> gone;
+		for (std::map<ClientId, RemoteUser>::const_iterator it = remoteUsers.begin(); it != remoteUsers.end(); ++it) {
+			if (remoteLink(it->first) == link.index && it->second.server == name)
+				gone.push_back(it->first);
+		}
+		for (size_t i = 0; i < gone.size(); ++i)
+			removeRemoteUser(gone[i], ":" + remoteUsers[gone[i]].nick + " QUIT :" + link.name + " " + name + "\r\n");
+		forwardLine(line, link);
+	} else if (command == "NICK" && msg.prefix.empty() && msg.paramCount >= 2) {
+		introduceRemote(link, msg.params[0].str(), msg.params[1].str());
+	} else if (command == "NICK" && msg.paramCount >= 1) {
+		ClientId id = remoteSender(link, msg);
+		if (id < 0)
+			return;
+		std::string nick = msg.params[0].str();
+		if (!shared->claimNick(nick, id)) {
+			// Collision : l'utilisateur disparaît ici et derrière nous, et
+			// son serveur le tue sous son nouveau pseudo
+			LOG_WARN(LOG_IRC, "Collision de pseudo " << nick << " avec le serveur " << remoteUsers[id].server);
+			std::string quit = ":" + remoteUsers[id].nick + " QUIT :Nick collision\r\n";
+			removeRemoteUser(id, quit);
+			linkOutput(BufferRef::copyOf(quit), -1, MemberList(), static_cast<int>(link.index));
+			queueReply(link.fd, "KILL " + nick + " :Nick collision\r\n");
+			return;
+		}
+		renameRemote(id, nick);
+		forwardLine(line, link);
+	} else if (command == "QUIT") {
+		ClientId id = remoteSender(link, msg);
+		if (id < 0)
+			return;
+		removeRemoteUser(id, relayed);
+		forwardLine(line, link);
+	} else if (command == "KILL" && msg.paramCount >= 1) {
+		ClientId id = findClientByNick(msg.params[0].str());
+		if (id < 0)
+			return;
+		if (isRemote(id)) {
+			// Vers son serveur, qui annoncera le QUIT à tout le réseau
+			if (remoteLink(id) != link.index)
+				linkOutput(BufferRef::copyOf(relayed), id, MemberList(), static_cast<int>(link.index));
+			return;
+		}
+		std::string reason = msg.paramCount > 1 ? msg.params[1].str() : "Killed";
+		LOG_INFO(LOG_IRC, "KILL de " << msg.params[0] << " par " << link.name << " : " << reason);
+		disconnectAnywhere(id, "Killed (" + reason + ")");
+	} else if (command == "NJOIN" && msg.paramCount >= 2) {
+		std::string channelName = msg.params[0].str();
+		const StrView &list = msg.params[1];
+		size_t start = 0;
+		while (start < list.len) {
+			size_t end = start;
+			while (end < list.len && list[end] != ',')
+				++end;
+			unsigned char modes = 0;
+			size_t nickStart = start;
+			for (; nickStart < end && (list[nickStart] == '@' || list[nickStart] == '+'); ++nickStart)
+				modes |= (list[nickStart] == '@') ? MEMBER_OP : MEMBER_VOICE;
+			StrView nick(list.ptr + nickStart, end - nickStart);
+			ClientId id = findClientByNick(nick.str());
+			if (isRemote(id) && remoteLink(id) == link.index)
+				remoteJoin(id, channelName, true, modes);
+			start = end + 1;
+		}
+		forwardLine(line, link);
+	} else if (command == "JOIN" && msg.paramCount >= 1) {
+		ClientId id = remoteSender(link, msg);
+		if (id < 0)
+			return;
+		remoteJoin(id, msg.params[0].str(), false, 0);
+		forwardLine(line, link);
+	} else if (command == "PART" && msg.paramCount >= 1) {
+		ClientId id = remoteSender(link, msg);
+		if (id < 0)
+			return;
+		remoteLeave(id, msg.params[0].str(), relayed);
+		forwardLine(line, link);
+	} else if (command == "KICK" && msg.paramCount >= 2) {
+		if (remoteSender(link, msg) < 0)
+			return;
+		std::string channelName = msg.params[0].str();
+		ClientId victim = findClientByNick(msg.params[1].str());
+		if (victim < 0)
+			return;
+		// L'expulsé local, encore membre, reçoit le KICK avec les autres
+		remoteLeave(victim, channelName, relayed);
+		forwardLine(line, link);
+	} else if (command == "TOPIC" && msg.paramCount >= 2) {
+		// Préfixe : pseudo, ou serveur pendant une salve
+		ChannelLock lock(*shared, msg.params[0].str());
+		Channel *channel = lock.find();
+		std::string topic = msg.params[1].str();
+		if (channel == NULL || channel->topic == topic)
+			return;
+		channel->topic = topic;
+		broadcast(*channel, relayed);
+		forwardLine(line, link);
+	} else if (command == "MODE" && msg.paramCount >= 2) {
+		ChannelLock lock(*shared, msg.params[0].str());
+		Channel *channel = lock.find();
+		if (channel == NULL || !applyChannelMode(*channel, msg.params[1].str(), msg.paramCount > 2 ? msg.params[2].str() : ""))
+			return;
+		broadcast(*channel, relayed);
+		forwardLine(line, link);
+	} else {
+		LOG_DEBUG(LOG_NET, "Commande de lien ignorée : " << line);
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef LINK_HPP
+#define LINK_HPP
+
+#include <set>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <stdint.h>
+#include <pthread.h>
+#include "shard.hpp"
+#include "nametable.hpp"
+
+/*
+ * Liaison entre serveurs (--link-port, --connect) : plusieurs ircserv
+ * forment un arbre couvrant. Les liens et les utilisateurs distants
+ * appartiennent au shard 0 ; les autres shards lui postent ce qui doit
+ * partir vers les liens (ShardMessage::LINK_SEND).
+ *
+ * Un utilisateur distant reçoit un ClientId dont le "shard" vaut
+ * MAX_SHARDS + index du lien par lequel il est joignable : les listes de
+ * membres triées le regroupent par lien comme les locaux par shard, et
+ * hasShard() dit directement quels liens doivent recevoir un PRIVMSG.
+ */
+
+static const size_t MAX_LINKS = 32;
+static const size_t LINK_SENDQ = 32 * 1024 * 1024;   // Une salve peut être longue
+
+inline ClientId makeRemoteId(size_t link, uint64_t sequence) {
+	return makeClientId(MAX_SHARDS + link, 0, 0) + static_cast<ClientId>(sequence & ((1ULL << CLIENT_SHARD_SHIFT) - 1));
+}
+inline bool isRemote(ClientId id) {
+	return id >= 0 && clientShard(id) >= MAX_SHARDS;
+}
+inline size_t remoteLink(ClientId id) {
+	return clientShard(id) - MAX_SHARDS;
+}
+
+// Connexion vers un serveur voisin
+struct ServerLink {
+	size_t index;
+	int fd;                         // -1 : case libre
+	int peer;                       // Index dans --connect (lien sortant), -1 sinon
+	bool passOk;                    // PASS correct reçu
+	bool established;               // SERVER échangé, salve envoyée
+	std::string name;               // Voisin
+	std::set<std::string> servers;  // Serveurs joignables par ce lien, voisin compris
+	uint64_t nextUser;              // Jamais remis à zéro : un ancien ClientId ne revient pas
+
+	ServerLink() : index(0), fd(-1), peer(-1), passOk(false), established(false), nextUser(0) {}
+};
+
+// Utilisateur d'un autre serveur, vu depuis le shard 0
+struct RemoteUser {
+	std::string nick;
+	std::string server;               // Serveur où il est connecté
+	ChannelSet channels;              // Canaux rejoints (peut contenir des canaux déjà quittés)
+};
+
+// Liens sortants : un thread tente connect() en bloquant (délai borné)
+// vers chaque pair absent, puis remet le socket au shard 0 par sa boîte
+// aux lettres (LINK_CONNECTED). Le shard 0 signale la perte d'un lien
+// avec disconnected() et une nouvelle tentative suit.
+class LinkConnector {
+public:
+	static const unsigned RETRY_SECONDS = 5;
+
+	LinkConnector(const std::vector<std::string>& peers, Mailbox& mailbox);
+
+	bool start();
+	void disconnected(size_t peer);
+	const std::string& peerName(size_t peer) const;
+
+private:
+	struct Peer {
+		std::string address;   // "hôte:port"
+		std::string host;
+		std::string port;
+		int connected;         // Lu et écrit par les deux threads
+		time_t nextTry;
+	};
+
+	static void* run(void* arg);
+	int connectTo(const Peer& peer);
+
+	std::vector<Peer> peers;
+	Mailbox& mailbox;
+
+	LinkConnector(const LinkConnector&);
+	LinkConnector& operator=(const LinkConnector&);
+};
+
+#endif // LINK_HPP
@@ -0,0 +1,281 @@
+#include "log.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+int Logger::minLevel = LOG_LEVEL_INFO;
+unsigned Logger::categoryMask = ~0u;
+
+static const char* const levelNames[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+static const char* const categoryNames[] = { "server", "net", "irc", "channel" };
+
+/* ************************************************************************** */
+/*                                  Anneau                                    */
+/* ************************************************************************** */
+
+// File bornée à plusieurs producteurs (D. Vyukov) : chaque case porte un
+// numéro de séquence qui dit si elle est libre pour la position `tail` ou
+// remplie pour la position `head`. Un producteur réserve une position par
+// CAS sur `tail`, écrit la case puis la publie ; le thread d'écriture est
+// le seul consommateur.
+struct LogSlot {
+	size_t sequence;
+	uint64_t stamp;       // CLOCK_REALTIME, en ms
+	uint8_t level;
+	uint8_t category;
+	uint16_t len;
+	char text[Logger::LINE_MAX];
+};
+
+static const size_t RING_SLOTS = 4096;   // Puissance de deux
+
+static LogSlot* ring = NULL;
+static size_t ringTail = 0;              // Prochaine position à réserver
+static size_t ringHead = 0;              // Prochaine position à lire (consommateur)
+static uint64_t droppedLines = 0;
+static int outputFd = 2;
+static bool running = false;
+static bool stopping = false;
+static pthread_t writerThread;
+
+static uint64_t nowMs() {
+	struct timespec ts;
+#ifdef CLOCK_REALTIME_COARSE
+	clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+#else
+	clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+	return static_cast<uint64_t>(ts.tv_sec) * 1000 + static_cast<uint64_t>(ts.tv_nsec) / 1000000;
+}
+
+static bool ringPush(LogLevel level, LogCategory category, const char* text, size_t len) {
+	size_t pos = __atomic_load_n(&ringTail, __ATOMIC_RELAXED);
+	LogSlot* slot;
+	while (true) {
+		slot = &ring[pos & (RING_SLOTS - 1)];
+		size_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+		long diff = static_cast<long>(sequence) - static_cast<long>(pos);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&ringTail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			return false;   // Plein
+		} else {
+			pos = __atomic_load_n(&ringTail, __ATOMIC_RELAXED);
+		}
+	}
+	slot->stamp = nowMs();
+	slot->level = static_cast<uint8_t>(level);
+	slot->category = static_cast<uint8_t>(category);
+	slot->len = static_cast<uint16_t>(len);
+	std::memcpy(slot->text, text, len);
+	__atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/* ************************************************************************** */
+/*                                 Écriture                                   */
+/* ************************************************************************** */
+
+// "2026-01-31 12:34:56.789 INFO  net: texte\n" ; retourne la longueur
+static size_t formatLine(char* out, size_t size, uint64_t stamp, int level, int category,
+	const char* text, size_t len) {
+	time_t seconds = static_cast<time_t>(stamp / 1000);
+	struct tm tm;
+	localtime_r(&seconds, &tm);
+	int n = std::snprintf(out, size, "%04d-%02d-%02d %02d:%02d:%02d.%03u %-5s %s: ",
+		tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+		static_cast<unsigned>(stamp % 1000), levelNames[level], categoryNames[category]);
+	size_t used = n > 0 ? static_cast<size_t>(n) : 0;
+	if (used + len + 1 > size)
+		len = size - used - 1;
+	std::memcpy(out + used, text, len);
+	out[used + len] = '\n';
+	return used + len + 1;
+}
+
+static void writeAll(const char* data, size_t len) {
+	while (len > 0) {
+		ssize_t n = ::write(outputFd, data, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return;   // Sortie perdue : rien de mieux à faire
+		}
+		data += n;
+		len -= static_cast<size_t>(n);
+	}
+}
+
+// Vide l'anneau par paquets ; retourne le nombre de lignes écrites
+static size_t drainRing() {
+	static char batch[64 * 1024];
+	size_t used = 0;
+	size_t lines = 0;
+	while (true) {
+		LogSlot* slot = &ring[ringHead & (RING_SLOTS - 1)];
+		if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != ringHead + 1)
+			break;
+		if (used + Logger::LINE_MAX + 64 > sizeof(batch)) {
+			writeAll(batch, used);
+			used = 0;
+		}
+		used += formatLine(batch + used, sizeof(batch) - used, slot->stamp, slot->level, slot->category,
+			slot->text, slot->len);
+		__atomic_store_n(&slot->sequence, ringHead + RING_SLOTS, __ATOMIC_RELEASE);
+		++ringHead;
+		++lines;
+	}
+	if (used)
+		writeAll(batch, used);
+	return lines;
+}
+
+static void* writerLoop(void*) {
+	uint64_t reported = 0;
+	while (true) {
+		size_t lines = drainRing();
+		// Signaler les pertes dans le journal lui-même, une fois par rafale
+		uint64_t dropped = __atomic_load_n(&droppedLines, __ATOMIC_RELAXED);
+		if (dropped != reported) {
+			char text[96];
+			int n = std::snprintf(text, sizeof(text), "journal saturé : %lu lignes perdues",
+				static_cast<unsigned long>(dropped - reported));
+			char line[256];
+			writeAll(line, formatLine(line, sizeof(line), nowMs(), LOG_LEVEL_WARN, LOG_SERVER, text, n));
+			reported = dropped;
+		}
+		if (lines == 0) {
+			if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+				break;
+			struct timespec pause = { 0, 2000000 };   // 2 ms
+			nanosleep(&pause, NULL);
+		}
+	}
+	drainRing();
+	return NULL;
+}
+
+/* ************************************************************************** */
+/*                                  Logger                                    */
+/* ************************************************************************** */
+
+bool Logger::start(const std::string& path) {
+	if (running)
+		return true;
+	if (!path.empty()) {
+		int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (fd < 0)
+			return false;
+		outputFd = fd;
+	}
+	ring = new LogSlot[RING_SLOTS];
+	for (size_t i = 0; i < RING_SLOTS; ++i)
+		ring[i].sequence = i;
+	if (pthread_create(&writerThread, NULL, writerLoop, NULL) != 0)
+		return false;
+	__atomic_store_n(&running, true, __ATOMIC_RELEASE);
+	return true;
+}
+
+void Logger::stop() {
+	if (!running)
+		return;
+	__atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+	pthread_join(writerThread, NULL);
+	__atomic_store_n(&running, false, __ATOMIC_RELEASE);
+}
+
+void Logger::setLevel(LogLevel level) {
+	minLevel = level;
+}
+
+bool Logger::setLevel(const std::string& name) {
+	static const char* const names[] = { "debug", "info", "warn", "error" };
+	for (int i = 0; i < 4; ++i) {
+		if (name == names[i]) {
+			minLevel = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Logger::setCategories(const std::string& list) {
+	if (list == "all") {
+		categoryMask = ~0u;
+		return true;
+	}
+	unsigned mask = 0;
+	std::string::size_type start = 0;
+	while (start <= list.size()) {
+		std::string::size_type comma = list.find(',', start);
+		std::string name = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+		int found = -1;
+		for (int i = 0; i < LOG_CATEGORIES; ++i) {
+			if (name == categoryNames[i])
+				found = i;
+		}
+		if (found < 0)
+			return false;
+		mask |= 1u << found;
+		if (comma == std::string::npos)
+			break;
+		start = comma + 1;
+	}
+	categoryMask = mask;
+	return true;
+}
+
+void Logger::write(LogLevel level, LogCategory category, const char* text, size_t len) {
+	if (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+		if (!ringPush(level, category, text, len))
+			__atomic_fetch_add(&droppedLines, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	// Avant start() ou après stop() : écriture directe
+	char line[LINE_MAX + 96];
+	writeAll(line, formatLine(line, sizeof(line), nowMs(), level, category, text, len));
+}
+
+uint64_t Logger::dropped() {
+	return __atomic_load_n(&droppedLines, __ATOMIC_RELAXED);
+}
+
+/* ************************************************************************** */
+/*                                 LogLine                                    */
+/* ************************************************************************** */
+
+LogLine& LogLine::append(const char* s, size_t n) {
+	if (n > Logger::LINE_MAX - len)
+		n = Logger::LINE_MAX - len;
+	std::memcpy(buf + len, s, n);
+	len += n;
+	return *this;
+}
+
+LogLine& LogLine::operator<<(const char* s) {
+	return s ? append(s, std::strlen(s)) : append("(null)", 6);
+}
+
+LogLine& LogLine::number(unsigned long long n) {
+	char digits[24];
+	size_t i = sizeof(digits);
+	do {
+		digits[--i] = static_cast<char>('0' + n % 10);
+		n /= 10;
+	} while (n != 0);
+	return append(digits + i, sizeof(digits) - i);
+}
+
+LogLine& LogLine::signedNumber(long long n) {
+	if (n < 0) {
+		append("-", 1);
+		return number(0ULL - static_cast<unsigned long long>(n));
+	}
+	return number(static_cast<unsigned long long>(n));
+}
@@ -0,0 +1,116 @@
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+#include <pthread.h>
+#include "strview.hpp"
+
+enum LogLevel {
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_WARN,
+	LOG_LEVEL_ERROR
+};
+
+// Catégories, filtrables séparément (--log-categories)
+enum LogCategory {
+	LOG_SERVER,   // Démarrage, configuration, backends
+	LOG_NET,      // Connexions, lectures, envois
+	LOG_IRC,      // Commandes et enregistrement des clients
+	LOG_CHANNEL,  // Canaux, modes et diffusion
+	LOG_CATEGORIES
+};
+
+// Journal asynchrone : une ligne est formatée dans un tampon sur la pile,
+// copiée dans un anneau sans verrou (plusieurs producteurs, les shards),
+// puis écrite par un thread dédié. Anneau plein : la ligne est perdue et
+// comptée, la boucle d'événements n'attend jamais le disque ou le terminal.
+class Logger {
+public:
+	static const size_t LINE_MAX = 480;   // Au-delà, la ligne est tronquée
+
+	// Démarre le thread d'écriture vers `path` (vide : stderr). Sans
+	// start(), les lignes sont écrites directement sur stderr.
+	static bool start(const std::string& path);
+	// Écrit tout ce qui reste puis arrête le thread (appelé à la sortie)
+	static void stop();
+
+	static void setLevel(LogLevel level);
+	static bool setLevel(const std::string& name);
+	// Liste séparée par des virgules : "server,net,irc,channel" ou "all"
+	static bool setCategories(const std::string& list);
+
+	static bool enabled(LogLevel level, LogCategory category) {
+		return level >= minLevel && (categoryMask & (1u << category)) != 0;
+	}
+
+	static void write(LogLevel level, LogCategory category, const char* text, size_t len);
+	// Lignes perdues depuis le démarrage (anneau plein)
+	static uint64_t dropped();
+
+private:
+	static int minLevel;
+	static unsigned categoryMask;
+};
+
+// Une ligne en cours de formatage, envoyée au journal à sa destruction.
+// Formatage à la main, sans allocation ni flux C++.
+class LogLine {
+public:
+	LogLine(LogLevel level, LogCategory category) : level(level), category(category), len(0) {}
+	~LogLine() { Logger::write(level, category, buf, len); }
+
+	LogLine& operator<<(const char* s);
+	LogLine& operator<<(const std::string& s) { return append(s.data(), s.size()); }
+	LogLine& operator<<(const StrView& s) { return append(s.ptr, s.len); }
+	LogLine& operator<<(char c) { return append(&c, 1); }
+	LogLine& operator<<(int n) { return signedNumber(n); }
+	LogLine& operator<<(long n) { return signedNumber(n); }
+	LogLine& operator<<(unsigned n) { return number(n); }
+	LogLine& operator<<(unsigned long n) { return number(n); }
+	LogLine& operator<<(unsigned long long n) { return number(n); }
+
+private:
+	LogLine& append(const char* s, size_t n);
+	LogLine& number(unsigned long long n);
+	LogLine& signedNumber(long long n);
+
+	LogLevel level;
+	LogCategory category;
+	size_t len;
+	char buf[Logger::LINE_MAX];
+
+	LogLine(const LogLine&);
+	LogLine& operator=(const LogLine&);
+};
+
+// LOG_INFO(LOG_NET, "Client " << fd << " déconnecté") : les arguments ne sont
+// évalués que si le niveau et la catégorie sont actifs. Hors des builds de
+// debug (make DEBUG=1), LOG_DEBUG est une branche constante éliminée à la
+// compilation : l'expression est vérifiée mais aucun code n'est généré.
+#define LOG_AT(level, category, expr) \
+	do { \
+		if (Logger::enabled(level, category)) { \
+			LogLine logLine_(level, category); \
+			logLine_ << expr; \
+		} \
+	} while (0)
+
+#ifdef IRC_DEBUG
+# define LOG_DEBUG(category, expr) LOG_AT(LOG_LEVEL_DEBUG, category, expr)
+#else
+# define LOG_DEBUG(category, expr) \
+	do { \
+		if (false) { \
+			LogLine logLine_(LOG_LEVEL_DEBUG, category); \
+			logLine_ << expr; \
+		} \
+	} while (0)
+#endif
+#define LOG_INFO(category, expr) LOG_AT(LOG_LEVEL_INFO, category, expr)
+#define LOG_WARN(category, expr) LOG_AT(LOG_LEVEL_WARN, category, expr)
+#define LOG_ERROR(category, expr) LOG_AT(LOG_LEVEL_ERROR, category, expr)
+
+#endif // LOG_HPP
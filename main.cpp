@@ -1,31 +1,113 @@
 #include <csignal>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <cerrno>
 #include "server.hpp"
+#include <pthread.h>
 
-// Gestionnaire de signal pour une fermeture propre du serveur
-void signalHandler(int signal) {
-	std::cout << "Signal reçu : " << signal << ". Fermeture du serveur..." << std::endl;
-	exit(EXIT_SUCCESS);
+// Boucle d'un shard secondaire ; le shard 0 tourne dans le thread principal
+static void *runShard(void *arg) {
+	static_cast<Server *>(arg)->start();
+	return NULL;
 }
 
 int main(int argc, char *argv[]) {
 	// Configuration des gestionnaires de signaux
-	signal(SIGINT, signalHandler); // Intercepter Ctrl+C
+	Server::installStop();         // Intercepter Ctrl+C
 	signal(SIGPIPE, SIG_IGN);      // Ignorer les erreurs de pipe brisé
 
-	if (argc != 3) {
-		std::cerr << "Usage: ./ircserv <port> <password>" << std::endl;
+	if (argc < 3) {
+		std::cerr << "Usage: ./ircserv <port> <password> [--poller=auto|uring|epoll|select] [--threads=N] [--ping-interval=s] [--ping-timeout=s] [--flood-burst=N] [--flood-rate=N] [--recvq=octets] [--sendq=octets] [--metrics-port=N] [--history=N] [--history-dir=chemin] [--name=nom] [--link-port=N] [--link-password=mdp] [--connect=hôte:port] [--log-level=debug|info|warn|error] [--log-file=chemin] [--log-categories=server,net,irc,channel] [--trace-sample=N] [--trace-file=chemin]" << std::endl;
 		return 1;
 	}
 
 	int port = atoi(argv[1]);
 	std::string password = argv[2];
 
-	Server ircServer(port, password);
-	ircServer.start();
+	ServerConfig config;
+	for (int i = 3; i < argc; ++i) {
+		if (!config.parseOption(argv[i])) {
+			std::cerr << "Option invalide : " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+	if (config.linking() && config.linkPassword.empty()) {
+		std::cerr << "--link-port et --connect demandent --link-password" << std::endl;
+		return 1;
+	}
+
+	// Redémarrage à chaud : l'état et les sockets de l'ancien processus sont
+	// repris avant d'ouvrir quoi que ce soit d'autre
+	Upgrade::init(argc, argv, config.threads);
+	if (config.upgradeFd >= 0 && !Upgrade::receive(config.upgradeFd)) {
+		std::cerr << "Redémarrage à chaud : état de l'ancien processus illisible" << std::endl;
+		return 1;
+	}
 
-	return 0;
+	// Journal asynchrone : démarré avant les shards, vidé à la sortie
+	Logger::setLevel(config.logLevel);
+	if (!Logger::setCategories(config.logCategories)) {
+		std::cerr << "Catégories de journal invalides : " << config.logCategories << std::endl;
+		return 1;
+	}
+	if (!Logger::start(config.logFile)) {
+		std::cerr << "Impossible d'ouvrir le journal " << config.logFile << " : " << strerror(errno) << std::endl;
+		return 1;
+	}
+	atexit(Logger::stop);
+	// Suivi échantillonné : anneaux créés avant les shards, trace écrite à
+	// l'arrêt du serveur
+	Tracer::configure(config.traceSample, config.threads);
+	Tracer::setDumpPath(config.traceFile);
+	if (!config.traceFile.empty() && config.traceSample == 0)
+		LOG_WARN(LOG_SERVER, "--trace-file sans --trace-sample : aucune trace ne sera écrite");
+#ifndef IRC_DEBUG
+	if (config.logLevel == "debug")
+		LOG_WARN(LOG_SERVER, "niveau debug demandé, mais les traces de debug ne sont compilées qu'avec make DEBUG=1");
+#endif
+
+	// Un Server par shard, chacun avec sa boucle d'événements et ses connexions
+	SharedState shared(config.threads);
+	if (!shared.history().open(config.history, config.historyDir))
+		return 1;
+	std::vector<Server *> shards;
+	for (size_t i = 0; i < config.threads; ++i) {
+		shards.push_back(new Server(port, password, config, shared, i, config.name));
+	}
+	MetricsExporter exporter(shared.metrics());
+	if (Upgrade::restoring()) {
+		for (size_t i = 0; i < shards.size(); ++i) {
+			UpgradeReader state = Upgrade::reader(i);
+			if (!shards[i]->restoreState(state)) {
+				LOG_ERROR(LOG_SERVER, "redémarrage à chaud : état du shard " << i + 1 << " invalide");
+				return 1;
+			}
+		}
+		if (Upgrade::metricsFd() >= 0 && !exporter.adopt(Upgrade::metricsFd()))
+			return 1;
+	} else if (config.metricsPort && !exporter.start(config.metricsPort)) {
+		return 1;
+	}
+	Upgrade::setMetricsFd(exporter.fd());
+	Upgrade::install(shared.mailbox(0));
+	Server::setStopWake(shared.mailbox(0));
+	Upgrade::confirm();
+	for (size_t i = 1; i < shards.size(); ++i) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, runShard, shards[i]) != 0) {
+			LOG_ERROR(LOG_SERVER, "impossible de lancer le shard " << i);
+			return 1;
+		}
+		pthread_detach(thread);
+	}
+	shards[0]->start();
+
+	// Arrêt (SIGINT), hors du gestionnaire de signal : la trace est écrite
+	// ici, puis exit() vide le journal (atexit) sans détruire l'état que les
+	// autres shards utilisent encore
+	Tracer::dumpOnShutdown();
+	exit(EXIT_SUCCESS);
 }
 
 //int main(int ac, char **av)
@@ -0,0 +1,93 @@
+#include "message.hpp"
+
+static const char* skipSpaces(const char* p, const char* end) {
+	while (p < end && *p == ' ')
+		++p;
+	return p;
+}
+
+static const char* skipWord(const char* p, const char* end) {
+	while (p < end && *p != ' ')
+		++p;
+	return p;
+}
+
+bool parseMessage(const StrView& line, IrcMessage& msg) {
+	const char* p = line.ptr;
+	const char* end = line.ptr + line.len;
+
+	msg.prefix = StrView();
+	msg.paramCount = 0;
+	msg.hasTrailing = false;
+
+	if (p < end && *p == ':') {
+		const char* start = ++p;
+		p = skipWord(p, end);
+		msg.prefix = StrView(start, p - start);
+	}
+
+	p = skipSpaces(p, end);
+	const char* start = p;
+	p = skipWord(p, end);
+	msg.command = StrView(start, p - start);
+	if (msg.command.empty())
+		return false;
+
+	while (true) {
+		p = skipSpaces(p, end);
+		if (p == end)
+			break;
+		// Le trailing, ou le 15e paramètre, prend tout le reste de la ligne
+		if (*p == ':' || msg.paramCount == IrcMessage::MAX_PARAMS - 1) {
+			if (*p == ':')
+				++p;
+			msg.params[msg.paramCount++] = StrView(p, end - p);
+			msg.hasTrailing = true;
+			break;
+		}
+		start = p;
+		p = skipWord(p, end);
+		msg.params[msg.paramCount++] = StrView(start, p - start);
+	}
+	return true;
+}
+
+bool parseMessage(const StrView& line, const LineScan& scan, IrcMessage& msg) {
+	const char* base = line.ptr;
+	size_t end = line.len;
+	size_t p = 0;
+
+	msg.prefix = StrView();
+	msg.paramCount = 0;
+	msg.hasTrailing = false;
+
+	if (p < end && base[p] == ':') {
+		size_t start = ++p;
+		p = scan.nextSpace(p);
+		msg.prefix = StrView(base + start, p - start);
+	}
+
+	p = scan.nextNonSpace(p);
+	size_t start = p;
+	p = scan.nextSpace(p);
+	msg.command = StrView(base + start, p - start);
+	if (msg.command.empty())
+		return false;
+
+	while (true) {
+		p = scan.nextNonSpace(p);
+		if (p == end)
+			break;
+		if (base[p] == ':' || msg.paramCount == IrcMessage::MAX_PARAMS - 1) {
+			if (base[p] == ':')
+				++p;
+			msg.params[msg.paramCount++] = StrView(base + p, end - p);
+			msg.hasTrailing = true;
+			break;
+		}
+		start = p;
+		p = scan.nextSpace(p);
+		msg.params[msg.paramCount++] = StrView(base + start, p - start);
+	}
+	return true;
+}
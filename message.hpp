@@ -0,0 +1,27 @@
+#ifndef MESSAGE_HPP
+#define MESSAGE_HPP
+
+#include "strview.hpp"
+#include "linescan.hpp"
+
+// Message IRC découpé en une passe : [":" prefix " "] command {" " param}
+// [" :" trailing]. Tous les champs sont des vues sur la ligne d'origine,
+// aucune allocation n'est faite.
+struct IrcMessage {
+	static const size_t MAX_PARAMS = 15;
+
+	StrView prefix;
+	StrView command;
+	StrView params[MAX_PARAMS];
+	size_t paramCount;
+	bool hasTrailing;  // Le dernier paramètre est un "trailing" (peut contenir des espaces)
+
+	IrcMessage() : paramCount(0), hasTrailing(false) {}
+};
+
+// Retourne false si la ligne ne contient pas de commande
+bool parseMessage(const StrView& line, IrcMessage& msg);
+// Même découpage, en sautant d'espace en espace grâce au relevé de scanLine
+bool parseMessage(const StrView& line, const LineScan& scan, IrcMessage& msg);
+
+#endif // MESSAGE_HPP
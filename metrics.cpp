@@ -0,0 +1,325 @@
+#include "metrics.hpp"
+#include "log.hpp"
+#include "trace.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static uint64_t load(const uint64_t& counter) {
+	return __atomic_load_n(&counter, __ATOMIC_RELAXED);
+}
+
+/* ************************************************************************** */
+/*                                Histogrammes                                */
+/* ************************************************************************** */
+
+MetricHistogram::MetricHistogram(unsigned shift) : count(0), sum(0), shift(shift) {
+	std::memset(buckets, 0, sizeof(buckets));
+}
+
+uint64_t MetricHistogram::upperBound(size_t i) const {
+	return static_cast<uint64_t>(1) << (i + shift);
+}
+
+uint64_t MetricHistogram::percentile(double q) const {
+	uint64_t total = load(count);
+	if (total == 0)
+		return 0;
+	uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKETS; ++i) {
+		seen += load(buckets[i]);
+		if (seen > rank)
+			return upperBound(i);
+	}
+	return upperBound(BUCKETS - 1);
+}
+
+void metricRecord(MetricHistogram& histogram, uint64_t value) {
+	size_t bucket = 0;
+	uint64_t scaled = (value - (value != 0)) >> histogram.shift;
+	if (scaled != 0)
+		bucket = 64 - __builtin_clzll(scaled);
+	if (bucket >= MetricHistogram::BUCKETS)
+		bucket = MetricHistogram::BUCKETS - 1;
+	metricAdd(histogram.buckets[bucket]);
+	metricAdd(histogram.count);
+	metricAdd(histogram.sum, value);
+}
+
+static void accumulateHistogram(MetricHistogram& into, const MetricHistogram& from) {
+	for (size_t i = 0; i < MetricHistogram::BUCKETS; ++i)
+		into.buckets[i] += load(from.buckets[i]);
+	into.count += load(from.count);
+	into.sum += load(from.sum);
+}
+
+/* ************************************************************************** */
+/*                                  Shards                                    */
+/* ************************************************************************** */
+
+ShardMetrics::ShardMetrics()
+	: connectionsAccepted(0), connectionsClosed(0), registrations(0), bytesIn(0), bytesOut(0),
+	sendqDropped(0), recvqDropped(0), pingTimeouts(0), inputThrottled(0), readBudgetExhausted(0), unknownCommands(0),
+	connectionMemory(0), bufferBytes(0), bufferSpare(0), sendqDepth(DEPTH_SHIFT), fanout(FANOUT_SHIFT) {
+	std::memset(commands, 0, sizeof(commands));
+	for (size_t i = 0; i < MAX_COMMANDS; ++i)
+		commandLatency[i] = MetricHistogram(LATENCY_SHIFT);
+}
+
+void ShardMetrics::accumulate(const ShardMetrics& other) {
+	connectionsAccepted += load(other.connectionsAccepted);
+	connectionsClosed += load(other.connectionsClosed);
+	registrations += load(other.registrations);
+	bytesIn += load(other.bytesIn);
+	bytesOut += load(other.bytesOut);
+	sendqDropped += load(other.sendqDropped);
+	recvqDropped += load(other.recvqDropped);
+	pingTimeouts += load(other.pingTimeouts);
+	inputThrottled += load(other.inputThrottled);
+	readBudgetExhausted += load(other.readBudgetExhausted);
+	unknownCommands += load(other.unknownCommands);
+	connectionMemory += load(other.connectionMemory);
+	bufferBytes += load(other.bufferBytes);
+	bufferSpare += load(other.bufferSpare);
+	for (size_t i = 0; i < MAX_COMMANDS; ++i) {
+		commands[i] += load(other.commands[i]);
+		accumulateHistogram(commandLatency[i], other.commandLatency[i]);
+	}
+	accumulateHistogram(sendqDepth, other.sendqDepth);
+	accumulateHistogram(fanout, other.fanout);
+}
+
+MetricsRegistry::MetricsRegistry(size_t shardCount) : started(time(NULL)) {
+	for (size_t i = 0; i < shardCount; ++i)
+		shards.push_back(new ShardMetrics());
+	for (size_t i = 0; i < ShardMetrics::MAX_COMMANDS; ++i)
+		names[i] = NULL;
+}
+
+MetricsRegistry::~MetricsRegistry() {
+	for (size_t i = 0; i < shards.size(); ++i)
+		delete shards[i];
+}
+
+ShardMetrics& MetricsRegistry::shard(size_t index) {
+	return *shards[index];
+}
+
+void MetricsRegistry::setCommandName(size_t index, const char* name) {
+	if (index < ShardMetrics::MAX_COMMANDS)
+		names[index] = name;
+}
+
+const char* MetricsRegistry::commandName(size_t index) const {
+	return index < ShardMetrics::MAX_COMMANDS ? names[index] : NULL;
+}
+
+void MetricsRegistry::total(ShardMetrics& out) const {
+	for (size_t i = 0; i < shards.size(); ++i)
+		out.accumulate(*shards[i]);
+}
+
+time_t MetricsRegistry::startTime() const {
+	return started;
+}
+
+/* ************************************************************************** */
+/*                            Format Prometheus                               */
+/* ************************************************************************** */
+
+static void header(std::string& out, const char* name, const char* type, const char* help) {
+	out += "# HELP ";
+	out += name;
+	out += " ";
+	out += help;
+	out += "\n# TYPE ";
+	out += name;
+	out += " ";
+	out += type;
+	out += "\n";
+}
+
+static void sample(std::string& out, const char* name, const std::string& labels, double value) {
+	char line[256];
+	std::snprintf(line, sizeof(line), "%s%s%s%s %.10g\n", name, labels.empty() ? "" : "{",
+		labels.c_str(), labels.empty() ? "" : "}", value);
+	out += line;
+}
+
+static void counter(std::string& out, const char* name, const char* help, uint64_t value) {
+	header(out, name, "counter", help);
+	sample(out, name, "", static_cast<double>(value));
+}
+
+// Cases cumulées ; `scale` convertit vers l'unité exportée (ns -> s)
+static void histogramSamples(std::string& out, const char* name, const std::string& labels,
+	const MetricHistogram& h, double scale) {
+	std::string prefix = labels.empty() ? "" : labels + ",";
+	std::string bucketName = std::string(name) + "_bucket";
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i + 1 < MetricHistogram::BUCKETS; ++i) {
+		cumulative += h.buckets[i];
+		char le[64];
+		std::snprintf(le, sizeof(le), "le=\"%.10g\"", static_cast<double>(h.upperBound(i)) * scale);
+		sample(out, bucketName.c_str(), prefix + le, static_cast<double>(cumulative));
+	}
+	sample(out, bucketName.c_str(), prefix + "le=\"+Inf\"", static_cast<double>(h.count));
+	sample(out, (std::string(name) + "_sum").c_str(), labels, static_cast<double>(h.sum) * scale);
+	sample(out, (std::string(name) + "_count").c_str(), labels, static_cast<double>(h.count));
+}
+
+std::string MetricsRegistry::prometheus() const {
+	ShardMetrics t;
+	total(t);
+	std::string out;
+
+	header(out, "ircserv_uptime_seconds", "gauge", "Temps depuis le démarrage du serveur");
+	sample(out, "ircserv_uptime_seconds", "", static_cast<double>(time(NULL) - started));
+	header(out, "ircserv_connections", "gauge", "Connexions ouvertes");
+	sample(out, "ircserv_connections", "", static_cast<double>(t.connectionsAccepted - t.connectionsClosed));
+	counter(out, "ircserv_connections_accepted_total", "Connexions acceptées", t.connectionsAccepted);
+	counter(out, "ircserv_connections_closed_total", "Connexions fermées", t.connectionsClosed);
+	counter(out, "ircserv_registrations_total", "Clients enregistrés (PASS/NICK/USER)", t.registrations);
+	counter(out, "ircserv_received_bytes_total", "Octets reçus des clients", t.bytesIn);
+	counter(out, "ircserv_sent_bytes_total", "Octets envoyés aux clients", t.bytesOut);
+	counter(out, "ircserv_sendq_exceeded_total", "Clients fermés, file d'envoi pleine", t.sendqDropped);
+	counter(out, "ircserv_recvq_exceeded_total", "Clients fermés, trop de lignes retenues", t.recvqDropped);
+	counter(out, "ircserv_ping_timeouts_total", "Clients fermés, pas de réponse au PING", t.pingTimeouts);
+	counter(out, "ircserv_input_throttled_total", "Lignes retenues par le limiteur d'entrée", t.inputThrottled);
+	counter(out, "ircserv_read_budget_exhausted_total", "Passages arrêtés par le budget de lecture, client remis en file", t.readBudgetExhausted);
+	counter(out, "ircserv_log_dropped_total", "Lignes de journal perdues, anneau plein", Logger::dropped());
+	header(out, "ircserv_connection_memory_bytes", "gauge", "Mémoire tenue par les connexions, tampons compris");
+	sample(out, "ircserv_connection_memory_bytes", "", static_cast<double>(t.connectionMemory));
+	header(out, "ircserv_buffer_bytes", "gauge", "Tampons de connexion, empruntés ou en réserve");
+	sample(out, "ircserv_buffer_bytes", "state=\"borrowed\"", static_cast<double>(t.bufferBytes));
+	sample(out, "ircserv_buffer_bytes", "state=\"spare\"", static_cast<double>(t.bufferSpare));
+
+	header(out, "ircserv_commands_total", "counter", "Commandes traitées, par commande");
+	for (size_t i = 0; i < ShardMetrics::MAX_COMMANDS; ++i) {
+		if (names[i])
+			sample(out, "ircserv_commands_total", std::string("command=\"") + names[i] + "\"", static_cast<double>(t.commands[i]));
+	}
+	sample(out, "ircserv_commands_total", "command=\"unknown\"", static_cast<double>(t.unknownCommands));
+
+	header(out, "ircserv_command_duration_seconds", "histogram", "Durée de traitement d'une commande");
+	for (size_t i = 0; i < ShardMetrics::MAX_COMMANDS; ++i) {
+		if (names[i])
+			histogramSamples(out, "ircserv_command_duration_seconds", std::string("command=\"") + names[i] + "\"", t.commandLatency[i], 1e-9);
+	}
+	header(out, "ircserv_sendq_depth_bytes", "histogram", "Octets en file d'envoi au moment d'un envoi");
+	histogramSamples(out, "ircserv_sendq_depth_bytes", "", t.sendqDepth, 1);
+	header(out, "ircserv_fanout_recipients", "histogram", "Destinataires d'une diffusion de canal");
+	histogramSamples(out, "ircserv_fanout_recipients", "", t.fanout, 1);
+	return out;
+}
+
+/* ************************************************************************** */
+/*                               Point d'accès                                */
+/* ************************************************************************** */
+
+MetricsExporter::MetricsExporter(const MetricsRegistry& registry) : registry(registry), listenFd(-1) {}
+
+MetricsExporter::~MetricsExporter() {
+	if (listenFd >= 0)
+		close(listenFd);
+}
+
+bool MetricsExporter::start(int port) {
+	listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	if (listenFd < 0)
+		return false;
+	int reuse = 1;
+	setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	// Local uniquement : les métriques ne sont pas exposées au réseau
+	struct sockaddr_in address;
+	std::memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(static_cast<uint16_t>(port));
+	if (bind(listenFd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0
+		|| listen(listenFd, 16) < 0) {
+		LOG_ERROR(LOG_SERVER, "métriques indisponibles sur le port " << port << " : " << strerror(errno));
+		return false;
+	}
+	if (!adopt(listenFd))
+		return false;
+	LOG_INFO(LOG_SERVER, "Métriques Prometheus sur http://127.0.0.1:" << port << "/metrics");
+	return true;
+}
+
+bool MetricsExporter::adopt(int fd) {
+	listenFd = fd;
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, run, this) != 0)
+		return false;
+	pthread_detach(thread);
+	return true;
+}
+
+void* MetricsExporter::run(void* arg) {
+	MetricsExporter* self = static_cast<MetricsExporter*>(arg);
+	while (true) {
+		int fd = accept(self->listenFd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			return NULL;
+		}
+		self->serve(fd);
+		close(fd);
+	}
+}
+
+// Requête lue jusqu'à la ligne vide (ou 4 Ko), puis réponse complète ; un
+// client trop lent est abandonné au bout d'une seconde
+void MetricsExporter::serve(int fd) {
+	struct timeval timeout;
+	timeout.tv_sec = 1;
+	timeout.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	std::string request;
+	char buf[1024];
+	while (request.size() < 4096 && request.find("\r\n\r\n") == std::string::npos
+		&& request.find("\n\n") == std::string::npos) {
+		ssize_t n = recv(fd, buf, sizeof(buf), 0);
+		if (n <= 0)
+			break;
+		request.append(buf, static_cast<size_t>(n));
+	}
+
+	std::string body;
+	std::string status;
+	const char* type = "text/plain; version=0.0.4";
+	if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0) {
+		status = "200 OK";
+		body = registry.prometheus();
+	} else if (request.compare(0, 11, "GET /trace ") == 0 && Tracer::enabled()) {
+		// Suivi échantillonné (--trace-sample), au format Chrome trace
+		status = "200 OK";
+		type = "application/json";
+		body = Tracer::chromeJson();
+	} else {
+		status = "404 Not Found";
+		body = "GET /metrics\n";
+	}
+	char head[192];
+	std::snprintf(head, sizeof(head), "HTTP/1.0 %s\r\nContent-Type: %s\r\n"
+		"Content-Length: %lu\r\nConnection: close\r\n\r\n", status.c_str(), type, static_cast<unsigned long>(body.size()));
+	std::string response = head + body;
+	size_t sent = 0;
+	while (sent < response.size()) {
+		ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0)
+			break;
+		sent += static_cast<size_t>(n);
+	}
+}
@@ -0,0 +1,135 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <stdint.h>
+#include <cstddef>
+#include <pthread.h>
+
+// Histogramme à cases en puissances de deux : la case i compte les valeurs
+// comprises entre 2^(i-1+shift) exclu et 2^(i+shift) inclus, la dernière
+// tout le reste. Assez compact pour être exporté tel quel (Prometheus).
+struct MetricHistogram {
+	static const size_t BUCKETS = 24;
+
+	uint64_t buckets[BUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	unsigned shift;
+
+	explicit MetricHistogram(unsigned shift = 0);
+
+	// Borne haute de la case `i` (la dernière est illimitée)
+	uint64_t upperBound(size_t i) const;
+	// Borne haute de la case qui contient la fraction `q` des valeurs
+	uint64_t percentile(double q) const;
+};
+
+// Compteurs d'un shard. Seul le thread du shard écrit : une mise à jour est
+// une simple addition publiée par un store relâché (pas d'instruction
+// verrouillée), et les lecteurs (STATS, export) additionnent les shards
+// sans verrou, au prix d'instantanés légèrement décalés entre compteurs.
+struct ShardMetrics {
+	static const size_t MAX_COMMANDS = 32;
+	static const unsigned LATENCY_SHIFT = 8;   // ns : de 256 ns à ~2 s
+	static const unsigned DEPTH_SHIFT = 6;     // Octets : de 64 o à ~512 Mo
+	static const unsigned FANOUT_SHIFT = 0;    // Destinataires : de 1 à ~8 M
+
+	uint64_t connectionsAccepted;
+	uint64_t connectionsClosed;
+	uint64_t registrations;
+	uint64_t bytesIn;
+	uint64_t bytesOut;
+	uint64_t sendqDropped;      // Clients fermés : file d'envoi pleine
+	uint64_t recvqDropped;      // Clients fermés : trop de lignes retenues (Excess Flood)
+	uint64_t pingTimeouts;      // Clients fermés : pas de réponse au PING
+	uint64_t inputThrottled;    // Lectures retenues par le limiteur d'entrée
+	uint64_t readBudgetExhausted; // Passages arrêtés par le budget (client remis en file d'exécution)
+	uint64_t unknownCommands;
+	uint64_t connectionMemory;  // Jauge : octets tenus par les connexions (voir ClientTable::memoryUsage)
+	uint64_t bufferBytes;       // Jauge : dont tampons empruntés au BufferPool
+	uint64_t bufferSpare;       // Jauge : tampons rendus, gardés en réserve
+	uint64_t commands[MAX_COMMANDS];
+	MetricHistogram commandLatency[MAX_COMMANDS];
+	MetricHistogram sendqDepth; // Octets en file au moment de chaque envoi
+	MetricHistogram fanout;     // Destinataires de chaque diffusion de canal
+	char padding[64];           // Pas de faux partage avec l'allocation voisine
+
+	ShardMetrics();
+	// Ajoute les valeurs de `other` (lues sans verrou) à celles-ci
+	void accumulate(const ShardMetrics& other);
+};
+
+inline void metricAdd(uint64_t& counter, uint64_t n = 1) {
+	__atomic_store_n(&counter, __atomic_load_n(&counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+inline void metricSet(uint64_t& gauge, uint64_t value) {
+	__atomic_store_n(&gauge, value, __ATOMIC_RELAXED);
+}
+
+void metricRecord(MetricHistogram& histogram, uint64_t value);
+
+// Horloge des mesures de durée, en ns
+inline uint64_t metricNowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Compteurs de tous les shards, un bloc alloué séparément par shard
+class MetricsRegistry {
+public:
+	explicit MetricsRegistry(size_t shardCount);
+	~MetricsRegistry();
+
+	ShardMetrics& shard(size_t index);
+	// Noms des commandes, dans l'ordre des index de ShardMetrics::commands ;
+	// à fixer avant le démarrage des shards
+	void setCommandName(size_t index, const char* name);
+	const char* commandName(size_t index) const;
+
+	// Somme de tous les shards
+	void total(ShardMetrics& out) const;
+	time_t startTime() const;
+	// Texte au format d'exposition Prometheus (version 0.0.4)
+	std::string prometheus() const;
+
+private:
+	std::vector<ShardMetrics*> shards;
+	const char* names[ShardMetrics::MAX_COMMANDS];
+	time_t started;
+
+	MetricsRegistry(const MetricsRegistry&);
+	MetricsRegistry& operator=(const MetricsRegistry&);
+};
+
+// Point d'accès local en texte brut (--metrics-port) : un thread dédié
+// accepte sur 127.0.0.1, répond à chaque requête HTTP avec les métriques
+// (ou, sur GET /trace, avec le suivi échantillonné de trace.hpp) puis
+// ferme. Les boucles d'événements ne sont jamais sollicitées.
+class MetricsExporter {
+public:
+	explicit MetricsExporter(const MetricsRegistry& registry);
+	~MetricsExporter();
+
+	// Retourne false si le port ne peut pas être ouvert
+	bool start(int port);
+	// Redémarrage à chaud : reprend le socket d'écoute de l'ancien processus
+	bool adopt(int fd);
+	int fd() const { return listenFd; }
+
+private:
+	static void* run(void* arg);
+	void serve(int fd);
+
+	const MetricsRegistry& registry;
+	int listenFd;
+
+	MetricsExporter(const MetricsExporter&);
+	MetricsExporter& operator=(const MetricsExporter&);
+};
+
+#endif // METRICS_HPP
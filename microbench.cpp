@@ -0,0 +1,333 @@
+// Microbenchmarks des chemins chauds du serveur (make microbench) : pas de
+// réseau, les clients écrivent dans /dev/null. Chaque mesure donne ns/op,
+// allocations/op et octets alloués/op sur des corpus fixes, pour comparer
+// deux versions ou deux jeux d'options de compilation.
+#include "server.hpp"
+#include "linescan.hpp"
+#include <new>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/resource.h>
+
+#ifndef MICROBENCH_FLAGS
+# define MICROBENCH_FLAGS "?"
+#endif
+
+/* ************************************************************************** */
+/*                         Comptage des allocations                           */
+/* ************************************************************************** */
+
+// Un seul thread mesure : de simples compteurs suffisent
+static unsigned long long allocCount = 0;
+static unsigned long long allocBytes = 0;
+
+void* operator new(std::size_t size) throw(std::bad_alloc) {
+	++allocCount;
+	allocBytes += size;
+	void* p = std::malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](std::size_t size) throw(std::bad_alloc) {
+	return operator new(size);
+}
+
+// Hors ligne : sinon GCC voit free() sur un pointeur issu de operator new
+__attribute__((noinline)) void operator delete(void* p) throw() {
+	std::free(p);
+}
+
+void operator delete[](void* p) throw() {
+	operator delete(p);
+}
+
+/* ************************************************************************** */
+/*                                  Corpus                                    */
+/* ************************************************************************** */
+
+// Trafic client réaliste : conversations de canal, messages privés,
+// keepalive, commandes de canal, UTF-8 multi-octets et CTCP
+static const char* const trafficCorpus[] = {
+	"PRIVMSG #general :salut tout le monde, quelqu'un a testé la nouvelle version ?",
+	"PRIVMSG #general :oui, ça marche bien chez moi \xF0\x9F\x91\x8D",
+	"PRIVMSG alice :tu es dispo pour la réunion de 14h ?",
+	"PING :irc.example.net",
+	"PRIVMSG #dev :the build is red again, looks like a flaky test in the parser",
+	"PONG :irc.example.net",
+	"PRIVMSG #general :\x01" "ACTION s'étire et va chercher un café\x01",
+	"TOPIC #general :Canal général — soyez sympas, pas de spam",
+	"PRIVMSG #dev :https://example.org/ci/builds/48213?branch=main&job=unit#L1042",
+	"MODE #general +t",
+	"PRIVMSG #general :こんにちは、みなさん！ Привет всем! Γειά σας!",
+	"PRIVMSG alice :ok",
+	"NOTICE #dev :déploiement terminé sur les trois serveurs",
+	"PRIVMSG #dev :   espaces   multiples   entre   les   mots   ",
+	"JOIN #general",
+	"PRIVMSG #general :lol",
+};
+static const size_t TRAFFIC_LINES = sizeof(trafficCorpus) / sizeof(trafficCorpus[0]);
+
+static const char* const asciiCorpus[] = {
+	"PRIVMSG #dev :the build is red again, looks like a flaky test in the parser",
+	"PRIVMSG #general :anyone tried the new release yet? upgrade went smoothly here",
+	"PING :irc.example.net",
+	"PRIVMSG bob :can you review my patch when you get a minute",
+	"PRIVMSG #dev :https://example.org/ci/builds/48213?branch=main&job=unit#L1042",
+	"NOTICE #ops :disk usage on db-3 is back under 70 percent",
+};
+static const size_t ASCII_LINES = sizeof(asciiCorpus) / sizeof(asciiCorpus[0]);
+
+/* ************************************************************************** */
+/*                                  Mesure                                    */
+/* ************************************************************************** */
+
+static uint64_t nowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+class MicroBench {
+public:
+	MicroBench();
+	~MicroBench();
+	void runAll();
+
+private:
+	// Exécute `rounds` tours, retourne le nombre d'opérations effectuées
+	typedef size_t (MicroBench::*Body)(size_t rounds);
+
+	void measure(const char* name, Body body);
+	size_t benchUtf8Ascii(size_t rounds);
+	size_t benchUtf8Mixed(size_t rounds);
+	size_t benchLineSplit(size_t rounds);
+	size_t benchScanParse(size_t rounds);
+	size_t benchDispatch(size_t rounds);
+	size_t benchNickLookup(size_t rounds);
+	size_t benchFanout(size_t rounds);
+
+	int addClient(const std::string& nick);
+	void command(int fd, const std::string& line);
+
+	SharedState shared;
+	ServerConfig config;
+	Server* server;
+	std::vector<int> fds;
+	std::string stream;             // Corpus concaténé avec CRLF, pour le découpage
+	std::vector<std::string> nicks; // Pseudos enregistrés, casse mélangée pour la recherche
+	int talker;                     // Client qui émet le trafic
+	int fanoutTalker;               // Membre du canal #fanout
+};
+
+static const size_t NICK_TABLE = 10000;
+static const size_t FANOUT_MEMBERS = 500;
+
+MicroBench::MicroBench() : shared(1), server(NULL), talker(-1), fanoutTalker(-1) {
+	config.poller = "epoll";
+	server = new Server(0, "pw", config, shared, 0);
+
+	// Interlocuteurs du corpus, puis les membres du canal de diffusion
+	int alice = addClient("alice");
+	talker = addClient("talker");
+	command(alice, "JOIN #general");
+	command(talker, "JOIN #general");
+	command(talker, "JOIN #dev");
+	for (size_t i = 0; i < FANOUT_MEMBERS; ++i) {
+		char nick[32];
+		std::snprintf(nick, sizeof(nick), "member%lu", static_cast<unsigned long>(i));
+		int fd = addClient(nick);
+		command(fd, "JOIN #fanout");
+		if (i == 0)
+			fanoutTalker = fd;
+	}
+
+	// Pseudos seuls (sans connexion) pour la table de recherche
+	for (size_t i = 0; i < NICK_TABLE; ++i) {
+		char nick[32];
+		std::snprintf(nick, sizeof(nick), "User%lu", static_cast<unsigned long>(i));
+		shared.claimNick(StrView(nick, std::strlen(nick)), static_cast<ClientId>(i + 1));
+		// Recherche en minuscules (casse ignorée) ; un sur dix est inconnu
+		std::string lookup = nick;
+		lookup[0] = 'u';
+		if (i % 10 == 9)
+			lookup += "_";
+		nicks.push_back(lookup);
+	}
+
+	for (size_t i = 0; i < 64; ++i) {
+		stream += trafficCorpus[i % TRAFFIC_LINES];
+		stream += "\r\n";
+	}
+}
+
+MicroBench::~MicroBench() {
+	delete server;   // Ferme aussi les fds des clients
+}
+
+int MicroBench::addClient(const std::string& nick) {
+	int fd = open("/dev/null", O_WRONLY);
+	if (fd < 0) {
+		std::perror("open(/dev/null)");
+		std::exit(1);
+	}
+	Client& client = server->connections.insert(fd);
+	client.lastActivity = TimerWheel::nowMs();
+	fds.push_back(fd);
+	command(fd, "PASS pw");
+	command(fd, "NICK " + nick);
+	command(fd, "USER " + nick + " 0 * :microbench");
+	return fd;
+}
+
+void MicroBench::command(int fd, const std::string& line) {
+	server->processCommand(fd, StrView(line));
+	server->flushPendingClients();
+}
+
+void MicroBench::measure(const char* name, Body body) {
+	// Calibrage : doubler le nombre de tours jusqu'à ~100 ms
+	size_t rounds = 1;
+	while (true) {
+		uint64_t start = nowNs();
+		(this->*body)(rounds);
+		if (nowNs() - start > 100000000ULL || rounds >= (static_cast<size_t>(1) << 30))
+			break;
+		rounds *= 2;
+	}
+	// Meilleur de trois mesures
+	double bestNs = 0;
+	double allocs = 0;
+	double bytes = 0;
+	for (int run = 0; run < 3; ++run) {
+		unsigned long long allocsBefore = allocCount;
+		unsigned long long bytesBefore = allocBytes;
+		uint64_t start = nowNs();
+		size_t ops = (this->*body)(rounds);
+		uint64_t elapsed = nowNs() - start;
+		double ns = static_cast<double>(elapsed) / static_cast<double>(ops);
+		if (run == 0 || ns < bestNs)
+			bestNs = ns;
+		allocs = static_cast<double>(allocCount - allocsBefore) / static_cast<double>(ops);
+		bytes = static_cast<double>(allocBytes - bytesBefore) / static_cast<double>(ops);
+	}
+	std::printf("%-28s %12.1f ns/op %10.2f allocs/op %10.1f B/op\n", name, bestNs, allocs, bytes);
+}
+
+size_t MicroBench::benchUtf8Ascii(size_t rounds) {
+	size_t valid = 0;
+	for (size_t r = 0; r < rounds; ++r) {
+		for (size_t i = 0; i < ASCII_LINES; ++i)
+			valid += isValidUTF8(StrView(asciiCorpus[i], std::strlen(asciiCorpus[i])));
+	}
+	return rounds * ASCII_LINES + (valid & 0);
+}
+
+size_t MicroBench::benchUtf8Mixed(size_t rounds) {
+	size_t valid = 0;
+	for (size_t r = 0; r < rounds; ++r) {
+		for (size_t i = 0; i < TRAFFIC_LINES; ++i)
+			valid += isValidUTF8(StrView(trafficCorpus[i], std::strlen(trafficCorpus[i])));
+	}
+	return rounds * TRAFFIC_LINES + (valid & 0);
+}
+
+// Découpage en lignes comme handleClient : lectures de la taille d'un
+// segment TCP, puis nextLine jusqu'à NEED_MORE
+size_t MicroBench::benchLineSplit(size_t rounds) {
+	static const size_t SEGMENT = 1448;
+	LineBuffer buffer;
+	size_t lines = 0;
+	for (size_t r = 0; r < rounds; ++r) {
+		for (size_t offset = 0; offset < stream.size(); offset += SEGMENT) {
+			size_t len = std::min(SEGMENT, stream.size() - offset);
+			std::memcpy(buffer.prepare(len), stream.data() + offset, len);
+			buffer.commit(len);
+			StrView line;
+			while (buffer.nextLine(line) != LineBuffer::NEED_MORE)
+				++lines;
+		}
+	}
+	return lines;
+}
+
+size_t MicroBench::benchScanParse(size_t rounds) {
+	size_t params = 0;
+	for (size_t r = 0; r < rounds; ++r) {
+		for (size_t i = 0; i < TRAFFIC_LINES; ++i) {
+			StrView line(trafficCorpus[i], std::strlen(trafficCorpus[i]));
+			LineScan scan;
+			IrcMessage msg;
+			if (scanLine(line, scan) && parseMessage(line, scan, msg))
+				params += msg.paramCount;
+		}
+	}
+	return rounds * TRAFFIC_LINES + (params & 0);
+}
+
+// processCommand complet (validation, découpage, dispatch, réponse) et
+// envoi des réponses vers /dev/null
+size_t MicroBench::benchDispatch(size_t rounds) {
+	for (size_t r = 0; r < rounds; ++r) {
+		for (size_t i = 0; i < TRAFFIC_LINES; ++i) {
+			server->processCommand(talker, StrView(trafficCorpus[i], std::strlen(trafficCorpus[i])));
+			server->flushPendingClients();
+		}
+	}
+	return rounds * TRAFFIC_LINES;
+}
+
+size_t MicroBench::benchNickLookup(size_t rounds) {
+	size_t found = 0;
+	for (size_t r = 0; r < rounds; ++r) {
+		for (size_t i = 0; i < nicks.size(); i += 97)
+			found += server->findClientByNick(nicks[i]) != -1;
+	}
+	return rounds * ((nicks.size() + 96) / 97) + (found & 0);
+}
+
+// Un PRIVMSG vers un canal de FANOUT_MEMBERS membres, livré à tous
+size_t MicroBench::benchFanout(size_t rounds) {
+	static const std::string line = "PRIVMSG #fanout :diffusion à tout le canal, avec un peu de texte";
+	for (size_t r = 0; r < rounds; ++r) {
+		server->processCommand(fanoutTalker, StrView(line));
+		server->flushPendingClients();
+	}
+	return rounds;
+}
+
+void MicroBench::runAll() {
+	std::printf("microbench : compilé avec « %s », analyse %s\n", MICROBENCH_FLAGS, lineScanKernel());
+	measure("utf8/ascii", &MicroBench::benchUtf8Ascii);
+	measure("utf8/mixed", &MicroBench::benchUtf8Mixed);
+	measure("linebuffer/split", &MicroBench::benchLineSplit);
+	measure("message/scan+parse", &MicroBench::benchScanParse);
+	measure("processCommand/dispatch", &MicroBench::benchDispatch);
+	measure("nick/lookup-10k", &MicroBench::benchNickLookup);
+	measure("channel/fanout-500", &MicroBench::benchFanout);
+}
+
+int main() {
+	signal(SIGPIPE, SIG_IGN);
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	// Le journal tourne comme dans le serveur (formatage et anneau compris),
+	// mais écrit dans /dev/null
+	if (!Logger::start("/dev/null"))
+		return 1;
+	{
+		MicroBench bench;
+		bench.runAll();
+	}
+	Logger::stop();
+	return 0;
+}
@@ -0,0 +1,88 @@
+#include "nametable.hpp"
+
+NameTable::NameTable() : buckets(64, static_cast<InternedName*>(NULL)) {}
+
+NameTable::~NameTable() {
+	for (size_t b = 0; b < buckets.size(); ++b) {
+		InternedName* entry = buckets[b];
+		while (entry) {
+			InternedName* next = entry->next;
+			entries.destroy(entry);
+			entry = next;
+		}
+	}
+}
+
+// Le hachage départage presque toujours ; la forme repliée n'est comparée
+// qu'en cas d'égalité des hachages
+InternedName* NameTable::find(const StrView& name, size_t hash) const {
+	for (InternedName* entry = buckets[hash & (buckets.size() - 1)]; entry; entry = entry->next) {
+		if (entry->hash == hash && ircEquals(StrView(entry->folded), name))
+			return entry;
+	}
+	return NULL;
+}
+
+InternedName* NameTable::intern(const StrView& name, size_t hash) {
+	InternedName* entry = find(name, hash);
+	if (entry)
+		return entry;
+	if (entries.size() >= buckets.size())
+		grow();
+	entry = entries.create();
+	entry->display = name.str();
+	entry->folded = ircFold(name);
+	entry->hash = hash;
+	InternedName*& head = buckets[hash & (buckets.size() - 1)];
+	entry->next = head;
+	head = entry;
+	return entry;
+}
+
+bool NameTable::release(InternedName* entry) {
+	if (entry->owner >= 0 || entry->channel != NULL || entry->pins != 0)
+		return false;
+	InternedName** link = &buckets[entry->hash & (buckets.size() - 1)];
+	while (*link != entry)
+		link = &(*link)->next;
+	*link = entry->next;
+	entries.destroy(entry);
+	return true;
+}
+
+size_t NameTable::size() const {
+	return entries.size();
+}
+
+void NameTable::channels(std::vector<Channel*>& out) const {
+	for (size_t b = 0; b < buckets.size(); ++b) {
+		for (InternedName* entry = buckets[b]; entry; entry = entry->next) {
+			if (entry->channel)
+				out.push_back(entry->channel);
+		}
+	}
+}
+
+void NameTable::nicks(std::vector<std::pair<ClientId, std::string> >& out) const {
+	for (size_t b = 0; b < buckets.size(); ++b) {
+		for (InternedName* entry = buckets[b]; entry; entry = entry->next) {
+			if (entry->owner >= 0)
+				out.push_back(std::make_pair(entry->owner, entry->display));
+		}
+	}
+}
+
+void NameTable::grow() {
+	std::vector<InternedName*> old(buckets.size() * 2, static_cast<InternedName*>(NULL));
+	old.swap(buckets);
+	for (size_t b = 0; b < old.size(); ++b) {
+		InternedName* entry = old[b];
+		while (entry) {
+			InternedName* next = entry->next;
+			InternedName*& head = buckets[entry->hash & (buckets.size() - 1)];
+			entry->next = head;
+			head = entry;
+			entry = next;
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef NAMETABLE_HPP
+#define NAMETABLE_HPP
+
+#include <set>
+#include <string>
+#include <vector>
+#include <utility>
+#include "casemap.hpp"
+#include "pool.hpp"
+#include "shard.hpp"
+
+struct Channel;
+
+// Entrée unique pour un nom IRC (pseudo ou canal) : forme affichée, forme
+// repliée rfc1459 et hachage, calculés une seule fois. Elle vit tant qu'un
+// client porte ce pseudo, qu'un canal porte ce nom ou qu'un ChannelSet la
+// cite ; deux noms internés sont égaux si et seulement si leurs entrées
+// sont la même.
+struct InternedName {
+	std::string display;  // Casse du premier utilisateur du nom
+	std::string folded;
+	size_t hash;
+	ClientId owner;       // Pseudo : client qui le porte, -1 sinon
+	Channel* channel;     // Canal portant ce nom, NULL sinon
+	unsigned pins;        // ChannelSet qui la citent (ChannelLock::pin)
+	InternedName* next;   // Chaînage dans NameTable
+
+	InternedName() : hash(0), owner(-1), channel(NULL), pins(0), next(NULL) {}
+};
+
+// Canaux rejoints par un utilisateur : des entrées épinglées, comparées
+// par adresse ; ChannelLock les reprend sans repli ni hachage
+typedef std::set<InternedName*> ChannelSet;
+
+// Table d'internement, non synchronisée : SharedState en garde une par
+// segment, protégée par le verrou du segment. Le hachage est fourni par
+// l'appelant, qui le calcule une fois pour choisir le segment.
+class NameTable {
+public:
+	NameTable();
+	~NameTable();
+
+	InternedName* find(const StrView& name, size_t hash) const;
+	// Retourne l'entrée existante ou en crée une
+	InternedName* intern(const StrView& name, size_t hash);
+	// Supprime l'entrée si plus aucun pseudo, canal ni ChannelSet ne la
+	// porte ; retourne true si elle a été supprimée
+	bool release(InternedName* entry);
+	size_t size() const;
+	// Ajoute à `out` tous les canaux encore présents
+	void channels(std::vector<Channel*>& out) const;
+	// Ajoute à `out` chaque pseudo porté, avec son propriétaire
+	void nicks(std::vector<std::pair<ClientId, std::string> >& out) const;
+
+private:
+	void grow();
+
+	std::vector<InternedName*> buckets;  // Taille puissance de 2
+	Pool<InternedName> entries;
+
+	NameTable(const NameTable&);
+	NameTable& operator=(const NameTable&);
+};
+
+#endif // NAMETABLE_HPP
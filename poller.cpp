@@ -0,0 +1,193 @@
+#include "poller.hpp"
+#include "log.hpp"
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <unistd.h>
+#include <stdint.h>
+
+Poller* Poller::create(const std::string& backend) {
+#ifdef HAVE_IO_URING
+	if (backend == "uring") {
+		UringPoller* up = new UringPoller();
+		if (up->isValid())
+			return up;
+		LOG_WARN(LOG_SERVER, "io_uring indisponible, repli sur epoll");
+		delete up;
+	}
+#endif
+#ifdef __linux__
+	if (backend != "select") {
+		EpollPoller* ep = new EpollPoller();
+		if (ep->isValid())
+			return ep;
+		LOG_WARN(LOG_SERVER, "epoll indisponible (" << strerror(errno) << "), repli sur select()");
+		delete ep;
+	}
+#else
+	(void) backend;
+#endif
+	return new SelectPoller();
+}
+
+/* ************************************************************************** */
+/*                                   epoll                                    */
+/* ************************************************************************** */
+
+#ifdef __linux__
+
+static uint32_t toEpollEvents(unsigned events) {
+	uint32_t ev = EPOLLET | EPOLLRDHUP;
+	if (events & Poller::READ)
+		ev |= EPOLLIN;
+	if (events & Poller::WRITE)
+		ev |= EPOLLOUT;
+	return ev;
+}
+
+EpollPoller::EpollPoller() : epfd(epoll_create1(EPOLL_CLOEXEC)), buffer(1024) {}
+
+EpollPoller::~EpollPoller() {
+	if (epfd >= 0)
+		close(epfd);
+}
+
+bool EpollPoller::isValid() const {
+	return epfd >= 0;
+}
+
+bool EpollPoller::add(int fd, unsigned events) {
+	struct epoll_event ev;
+	std::memset(&ev, 0, sizeof(ev));
+	ev.events = toEpollEvents(events);
+	ev.data.fd = fd;
+	return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+bool EpollPoller::modify(int fd, unsigned events) {
+	struct epoll_event ev;
+	std::memset(&ev, 0, sizeof(ev));
+	ev.events = toEpollEvents(events);
+	ev.data.fd = fd;
+	return epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EpollPoller::remove(int fd) {
+	struct epoll_event ev;
+	epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+int EpollPoller::wait(std::vector<PollEvent>& out, int timeout_ms) {
+	out.clear();
+	int n = epoll_wait(epfd, &buffer[0], static_cast<int>(buffer.size()), timeout_ms);
+	if (n < 0)
+		return errno == EINTR ? 0 : -1;
+	for (int i = 0; i < n; ++i) {
+		PollEvent pe;
+		pe.fd = buffer[i].data.fd;
+		pe.events = 0;
+		pe.result = 0;
+		pe.data = NULL;
+		if (buffer[i].events & EPOLLIN)
+			pe.events |= READ;
+		if (buffer[i].events & EPOLLOUT)
+			pe.events |= WRITE;
+		if (buffer[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+			pe.events |= HANGUP;
+		out.push_back(pe);
+	}
+	// Tampon plein : agrandir pour le prochain tour
+	if (n == static_cast<int>(buffer.size()))
+		buffer.resize(buffer.size() * 2);
+	return n;
+}
+
+const char* EpollPoller::name() const {
+	return "epoll";
+}
+
+#endif
+
+/* ************************************************************************** */
+/*                                   select                                   */
+/* ************************************************************************** */
+
+SelectPoller::SelectPoller() : maxFd(-1) {
+	FD_ZERO(&readSet);
+	FD_ZERO(&writeSet);
+}
+
+bool SelectPoller::add(int fd, unsigned events) {
+	if (fd < 0 || fd >= FD_SETSIZE)
+		return false;
+	fds.push_back(fd);
+	if (fd > maxFd)
+		maxFd = fd;
+	return modify(fd, events);
+}
+
+bool SelectPoller::modify(int fd, unsigned events) {
+	if (fd < 0 || fd >= FD_SETSIZE)
+		return false;
+	FD_CLR(fd, &readSet);
+	FD_CLR(fd, &writeSet);
+	if (events & READ)
+		FD_SET(fd, &readSet);
+	if (events & WRITE)
+		FD_SET(fd, &writeSet);
+	return true;
+}
+
+void SelectPoller::remove(int fd) {
+	std::vector<int>::iterator it = std::find(fds.begin(), fds.end(), fd);
+	if (it == fds.end())
+		return;
+	*it = fds.back();
+	fds.pop_back();
+	FD_CLR(fd, &readSet);
+	FD_CLR(fd, &writeSet);
+	if (fd == maxFd) {
+		maxFd = -1;
+		for (size_t i = 0; i < fds.size(); ++i)
+			maxFd = std::max(maxFd, fds[i]);
+	}
+}
+
+int SelectPoller::wait(std::vector<PollEvent>& out, int timeout_ms) {
+	out.clear();
+	fd_set r = readSet;
+	fd_set w = writeSet;
+	struct timeval tv;
+	struct timeval* ptv = NULL;
+	if (timeout_ms >= 0) {
+		tv.tv_sec = timeout_ms / 1000;
+		tv.tv_usec = (timeout_ms % 1000) * 1000;
+		ptv = &tv;
+	}
+	int n = select(maxFd + 1, &r, &w, NULL, ptv);
+	if (n < 0)
+		return errno == EINTR ? 0 : -1;
+	for (size_t i = 0; i < fds.size() && n > 0; ++i) {
+		PollEvent pe;
+		pe.fd = fds[i];
+		pe.events = 0;
+		pe.result = 0;
+		pe.data = NULL;
+		if (FD_ISSET(fds[i], &r)) {
+			pe.events |= READ;
+			--n;
+		}
+		if (FD_ISSET(fds[i], &w)) {
+			pe.events |= WRITE;
+			--n;
+		}
+		if (pe.events)
+			out.push_back(pe);
+	}
+	return static_cast<int>(out.size());
+}
+
+const char* SelectPoller::name() const {
+	return "select";
+}
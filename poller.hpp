@@ -0,0 +1,207 @@
+#ifndef POLLER_HPP
+#define POLLER_HPP
+
+#include <string>
+#include <vector>
+#include <sys/select.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <stdint.h>
+#ifdef __linux__
+# include <sys/epoll.h>
+# if defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#   include <linux/io_uring.h>
+#   define HAVE_IO_URING 1
+#  endif
+# endif
+#endif
+
+// Événement remonté par un backend : un fd et les conditions prêtes
+struct PollEvent {
+	int fd;
+	unsigned events;
+	// Backends à complétion uniquement (voir Poller::completions())
+	int result;         // ACCEPTED : fd accepté ; RECEIVED / SENT : octets, ou -errno
+	const char* data;   // RECEIVED : données reçues, valides jusqu'au wait() suivant
+};
+
+// Interface commune des backends de multiplexage (epoll, select, io_uring).
+// Les fds sont enregistrés une seule fois avec leurs intérêts, wait() ne
+// renvoie que les fds actifs : le coût d'un réveil ne dépend pas du nombre
+// total de connexions (sauf pour le backend select, gardé en secours).
+//
+// Un backend à complétion (io_uring) fait lui-même accept, recv et send :
+// wait() remonte alors ACCEPTED, RECEIVED et SENT au lieu de READ/WRITE pour
+// les fds enregistrés avec addListener() et addConnection().
+class Poller {
+public:
+	enum {
+		READ = 1,
+		WRITE = 2,
+		HANGUP = 4,
+		ACCEPTED = 8,
+		RECEIVED = 16,
+		SENT = 32
+	};
+
+	virtual ~Poller() {}
+	virtual bool add(int fd, unsigned events) = 0;
+	virtual bool modify(int fd, unsigned events) = 0;
+	virtual void remove(int fd) = 0;
+	// Remplit `out` avec les fds prêts, retourne leur nombre ou -1
+	virtual int wait(std::vector<PollEvent>& out, int timeout_ms) = 0;
+	virtual const char* name() const = 0;
+
+	// Socket d'écoute et connexions : simple intérêt READ pour les backends
+	// à readiness, opérations multishot pour un backend à complétion
+	virtual bool addListener(int fd) { return add(fd, READ); }
+	virtual bool addConnection(int fd) { return add(fd, READ); }
+	virtual bool completions() const { return false; }
+	static const int MAX_SEND_IOV = 64;
+	// Envoi asynchrone (backend à complétion) : les données décrites doivent
+	// rester valides jusqu'à l'événement SENT correspondant
+	virtual bool send(int fd, const struct iovec* iov, int iovcnt) {
+		(void) fd; (void) iov; (void) iovcnt;
+		return false;
+	}
+
+	// Redémarrage à chaud : suspend() arrête les accept et recv en vol d'un
+	// backend à complétion (ce qu'ils ont déjà lu est remonté par les wait()
+	// suivants), resume() les relance. Sans effet pour les autres backends,
+	// où les données restent dans le noyau.
+	virtual void suspend() {}
+	virtual void resume() {}
+
+	// Équité des lectures : un client qui a épuisé son budget ne doit plus
+	// être lu avant son tour. Un backend à complétion arrête le recv de ce
+	// fd (ce qu'il a déjà lu est remonté) jusqu'à resumeReading() ; sans
+	// effet pour les autres, où le serveur cesse simplement d'appeler recv.
+	virtual void pauseReading(int fd) { (void) fd; }
+	virtual void resumeReading(int fd) { (void) fd; }
+
+	// "uring", "epoll", "select" ou "auto" (epoll si disponible, sinon select) ;
+	// un backend indisponible se replie sur le suivant
+	static Poller* create(const std::string& backend);
+};
+
+#ifdef __linux__
+// Backend epoll en mode edge-triggered : l'appelant doit vider les sockets
+// jusqu'à EAGAIN après chaque notification.
+class EpollPoller : public Poller {
+public:
+	EpollPoller();
+	~EpollPoller();
+	bool isValid() const;
+	bool add(int fd, unsigned events);
+	bool modify(int fd, unsigned events);
+	void remove(int fd);
+	int wait(std::vector<PollEvent>& out, int timeout_ms);
+	const char* name() const;
+
+private:
+	int epfd;
+	std::vector<struct epoll_event> buffer;
+
+	EpollPoller(const EpollPoller&);
+	EpollPoller& operator=(const EpollPoller&);
+};
+#endif
+
+#ifdef HAVE_IO_URING
+// Backend io_uring (noyau 6.0+) : accept et recv multishot avec tampons
+// fournis par un anneau partagé, envois regroupés et soumis avec l'attente
+// suivante. Un seul appel système par tour de boucle dans le cas courant.
+class UringPoller : public Poller {
+public:
+	UringPoller();
+	~UringPoller();
+	bool isValid() const;
+	bool add(int fd, unsigned events);
+	bool modify(int fd, unsigned events);
+	void remove(int fd);
+	int wait(std::vector<PollEvent>& out, int timeout_ms);
+	const char* name() const;
+	bool addListener(int fd);
+	bool addConnection(int fd);
+	bool completions() const;
+	bool send(int fd, const struct iovec* iov, int iovcnt);
+	void suspend();
+	void resume();
+	void pauseReading(int fd);
+	void resumeReading(int fd);
+
+private:
+	enum Kind { NONE, LISTENER, CONNECTION, POLL };
+	struct SendSlot {
+		struct msghdr msg;
+		struct iovec iov[MAX_SEND_IOV];
+	};
+	struct FdState {
+		Kind kind;
+		unsigned events;    // POLL : intérêts demandés
+		uint32_t gen;       // Invalide les complétions d'un fd retiré puis réutilisé
+		bool paused;        // CONNECTION : recv arrêté (pauseReading)
+		SendSlot* send;
+		FdState() : kind(NONE), events(0), gen(0), paused(false), send(NULL) {}
+	};
+
+	bool setup(unsigned entries);
+	bool setupBuffers();
+	void release();
+	FdState& state(int fd);
+	struct io_uring_sqe* getSqe();
+	int submit(unsigned waitFor, int timeout_ms);
+	void arm(int fd);
+	void recycle(uint16_t bid);
+	void stop(int fd);
+	void cancel(int fd);
+
+	int ringFd;
+	void* ringMap;                // Anneaux de soumission et de complétion
+	size_t ringMapSize;
+	unsigned* sqHead;
+	unsigned* sqTail;
+	unsigned sqMask;
+	unsigned sqEntries;
+	struct io_uring_sqe* sqes;
+	size_t sqesSize;
+	unsigned localTail;           // Entrées préparées, publiées par submit()
+	unsigned* cqHead;
+	unsigned* cqTail;
+	unsigned cqMask;
+	struct io_uring_cqe* cqes;
+	void* bufMap;                 // Tampons de réception fournis au noyau
+	size_t bufMapSize;
+	struct io_uring_buf_ring* bufRing;
+	char* bufBase;
+	uint16_t bufTail;
+	std::vector<uint16_t> lent;   // Remontés par wait(), rendus au suivant
+
+	std::vector<FdState> fds;
+	std::vector<int> rearm;       // Multishots terminés à relancer
+	bool suspended;               // accept et recv arrêtés (suspend)
+
+	UringPoller(const UringPoller&);
+	UringPoller& operator=(const UringPoller&);
+};
+#endif
+
+// Backend select() de secours, limité à FD_SETSIZE descripteurs
+class SelectPoller : public Poller {
+public:
+	SelectPoller();
+	bool add(int fd, unsigned events);
+	bool modify(int fd, unsigned events);
+	void remove(int fd);
+	int wait(std::vector<PollEvent>& out, int timeout_ms);
+	const char* name() const;
+
+private:
+	fd_set readSet;
+	fd_set writeSet;
+	std::vector<int> fds;
+	int maxFd;
+};
+
+#endif // POLLER_HPP
@@ -0,0 +1,98 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Allocateur par blocs (slabs) d'objets de même type. Les objets ne
+// bougent jamais, les cases libérées sont réutilisées en LIFO (encore
+// chaudes en cache) et la mémoire n'est rendue qu'à la destruction du pool.
+// Le pool ne détruit pas les objets encore vivants : c'est au propriétaire
+// de le faire avant (voir ClientTable, SharedState).
+template <typename T>
+class Pool {
+public:
+	static const size_t SLAB_OBJECTS = 64;
+
+	Pool() : freeList(NULL), live(0) {}
+
+	~Pool() {
+		for (size_t i = 0; i < slabs.size(); ++i)
+			::operator delete(slabs[i]);
+	}
+
+	T* create() {
+		void* cell = allocate();
+		return new (cell) T();
+	}
+
+	template <typename A1>
+	T* create(const A1& a1) {
+		void* cell = allocate();
+		return new (cell) T(a1);
+	}
+
+	template <typename A1, typename A2, typename A3>
+	T* create(const A1& a1, const A2& a2, const A3& a3) {
+		void* cell = allocate();
+		return new (cell) T(a1, a2, a3);
+	}
+
+	template <typename A1, typename A2, typename A3, typename A4>
+	T* create(const A1& a1, const A2& a2, const A3& a3, const A4& a4) {
+		void* cell = allocate();
+		return new (cell) T(a1, a2, a3, a4);
+	}
+
+	void destroy(T* object) {
+		object->~T();
+		FreeCell* cell = reinterpret_cast<FreeCell*>(object);
+		cell->next = freeList;
+		freeList = cell;
+		--live;
+	}
+
+	size_t size() const { return live; }
+	size_t capacity() const { return slabs.size() * SLAB_OBJECTS; }
+
+private:
+	struct FreeCell {
+		FreeCell* next;
+	};
+	// Une case contient soit un T, soit un lien de la liste libre
+	union Cell {
+		FreeCell free;
+		char storage[sizeof(T)];
+		void* alignPointer;
+		long double alignFloat;
+		long alignInteger;
+	};
+
+	void* allocate() {
+		if (freeList == NULL)
+			grow();
+		FreeCell* cell = freeList;
+		freeList = cell->next;
+		++live;
+		return cell;
+	}
+
+	void grow() {
+		Cell* slab = static_cast<Cell*>(::operator new(sizeof(Cell) * SLAB_OBJECTS));
+		slabs.push_back(slab);
+		for (size_t i = SLAB_OBJECTS; i-- > 0; ) {
+			slab[i].free.next = freeList;
+			freeList = &slab[i].free;
+		}
+	}
+
+	std::vector<Cell*> slabs;
+	FreeCell* freeList;
+	size_t live;
+
+	Pool(const Pool&);
+	Pool& operator=(const Pool&);
+};
+
+#endif // POOL_HPP
@@ -0,0 +1,104 @@
+#include "replies.hpp"
+
+struct NumericFormat {
+	const char* code;
+	const char* format;
+};
+
+// Indexée par Numeric : même ordre que l'énumération
+static const NumericFormat NUMERICS[] = {
+	{ "001", ":Welcome to the Internet Relay Network $1" },
+	{ "005", "CHATHISTORY=$1 :are supported by this server" },
+	{ "211", "$1 $2 $3 $4" },
+	{ "212", "$1 $2 0 0" },
+	{ "219", "$1 :End of STATS report" },
+	{ "242", ":Server Up $1" },
+	{ "249", "$1 :$2" },
+	{ "331", "$1 :No topic is set" },
+	{ "332", "$1 :$2" },
+	{ "341", "$1 $2 :Invitation envoyée" },
+	{ "400", ":Invalid UTF-8 encoding" },
+	{ "401", "$1 :No such nick/channel" },
+	{ "404", "$1 :Cannot send to channel" },
+	{ "417", ":Input line was too long" },
+	{ "421", "$1 :Unknown command" },
+	{ "431", ":No nickname given" },
+	{ "432", "$1 :Erroneous nickname" },
+	{ "433", "$1 :Nickname is already in use" },
+	{ "451", ":You have not registered" },
+	{ "461", "$1 :Not enough parameters" },
+	{ "462", ":You may not reregister" },
+	{ "464", ":Password incorrect" },
+	{ "471", "$1 :Cannot join channel (+l)" },
+	{ "473", "$1 :Cannot join channel (+i)" },
+};
+
+// Vérifiée à la compilation : une entrée par valeur de Numeric
+typedef char NumericTableComplete[sizeof(NUMERICS) / sizeof(NUMERICS[0]) == NUMERIC_COUNT ? 1 : -1];
+
+ReplyLine& ReplyLine::operator<<(const StrView& text) {
+	if (complete) {
+		cut = cut || text.len > 0;
+		return *this;
+	}
+	size_t n = text.len;
+	if (n > room()) {
+		// Recule jusqu'au début d'un caractère : jamais de séquence UTF-8
+		// coupée en deux dans ce qui part sur le réseau
+		n = room();
+		while (n > 0 && (static_cast<unsigned char>(text.ptr[n]) & 0xC0) == 0x80)
+			--n;
+		cut = true;
+	}
+	std::memcpy(buf + len, text.ptr, n);
+	len += n;
+	return *this;
+}
+
+ReplyLine& ReplyLine::operator<<(uint64_t n) {
+	char digits[20];
+	size_t count = 0;
+	do {
+		digits[count++] = static_cast<char>('0' + n % 10);
+		n /= 10;
+	} while (n != 0);
+	// Un nombre ne se tronque pas : tout ou rien
+	if (count > room()) {
+		cut = true;
+		return *this;
+	}
+	while (count > 0)
+		buf[len++] = digits[--count];
+	return *this;
+}
+
+ReplyLine& ReplyLine::end() {
+	if (complete) {
+		cut = true;
+		return *this;
+	}
+	buf[len++] = '\r';
+	buf[len++] = '\n';
+	complete = true;
+	return *this;
+}
+
+void formatNumeric(ReplyLine& out, const StrView& source, Numeric numeric, const StrView& nick,
+	const StrView* args, size_t argCount) {
+	const NumericFormat& entry = NUMERICS[numeric];
+	out << source << ' ' << entry.code << ' ' << (nick.empty() ? StrView("*", 1) : nick) << ' ';
+	const char* text = entry.format;
+	while (*text) {
+		const char* dollar = std::strchr(text, '$');
+		if (dollar == NULL || dollar[1] < '1' || dollar[1] > '4') {
+			out << text;
+			break;
+		}
+		out << StrView(text, static_cast<size_t>(dollar - text));
+		size_t index = static_cast<size_t>(dollar[1] - '1');
+		if (index < argCount)
+			out << args[index];
+		text = dollar + 2;
+	}
+	out.end();
+}
@@ -0,0 +1,78 @@
+#ifndef REPLIES_HPP
+#define REPLIES_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include "strview.hpp"
+#include "linebuffer.hpp"
+#include "sharedbuffer.hpp"
+
+// Réponses numériques, dans l'ordre de la table de replies.cpp
+enum Numeric {
+	RPL_WELCOME,            // 001
+	RPL_ISUPPORT,           // 005
+	RPL_STATSLINKINFO,      // 211
+	RPL_STATSCOMMANDS,      // 212
+	RPL_ENDOFSTATS,         // 219
+	RPL_STATSUPTIME,        // 242
+	RPL_STATSDEBUG,         // 249
+	RPL_NOTOPIC,            // 331
+	RPL_TOPIC,              // 332
+	RPL_INVITING,           // 341
+	ERR_UNKNOWNERROR,       // 400
+	ERR_NOSUCHNICK,         // 401
+	ERR_CANNOTSENDTOCHAN,   // 404
+	ERR_INPUTTOOLONG,       // 417
+	ERR_UNKNOWNCOMMAND,     // 421
+	ERR_NONICKNAMEGIVEN,    // 431
+	ERR_ERRONEUSNICKNAME,   // 432
+	ERR_NICKNAMEINUSE,      // 433
+	ERR_NOTREGISTERED,      // 451
+	ERR_NEEDMOREPARAMS,     // 461
+	ERR_ALREADYREGISTERED,  // 462
+	ERR_PASSWDMISMATCH,     // 464
+	ERR_CHANNELISFULL,      // 471
+	ERR_INVITEONLYCHAN,     // 473
+	NUMERIC_COUNT
+};
+
+// Ligne IRC formatée dans un tampon fixe de MAX_LINE octets (sur la pile
+// de l'appelant) : aucune std::string intermédiaire. Ce qui dépasse est
+// tronqué sur une frontière de caractère UTF-8 et signalé par truncated() ;
+// le CRLF final a toujours sa place. Après end(), la ligne est close et
+// tout ajout (y compris un second end()) est refusé.
+class ReplyLine {
+public:
+	static const size_t MAX = LineBuffer::MAX_LINE;
+
+	ReplyLine() : len(0), complete(false), cut(false) {}
+
+	ReplyLine& operator<<(const StrView& text);
+	ReplyLine& operator<<(const char* text) { return *this << StrView(text, std::strlen(text)); }
+	ReplyLine& operator<<(char c) { return *this << StrView(&c, 1); }
+	ReplyLine& operator<<(uint64_t n);
+	// Ajoute CRLF ; la ligne est complète
+	ReplyLine& end();
+
+	const char* data() const { return buf; }
+	size_t size() const { return len; }
+	// Place restante avant le CRLF final
+	size_t room() const { return complete ? 0 : MAX - 2 - len; }
+	// Vrai si un ajout a été raccourci ou refusé
+	bool truncated() const { return cut; }
+	// Copie exacte, à partager entre destinataires (diffusion, historique, liens)
+	BufferRef buffer() const { return BufferRef::copyOf(buf, len); }
+
+private:
+	char buf[MAX];
+	size_t len;
+	bool complete;
+	bool cut;
+};
+
+// "<source> <code> <pseudo> <paramètres>\r\n" d'après le modèle de la
+// table, où $1 à $4 sont remplacés par `args`. `nick` vide : "*".
+void formatNumeric(ReplyLine& out, const StrView& source, Numeric numeric, const StrView& nick,
+	const StrView* args, size_t argCount);
+
+#endif // REPLIES_HPP
@@ -0,0 +1,144 @@
+#include "sendqueue.hpp"
+#include "bufferpool.hpp"
+#include "trace.hpp"
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+SendQueue::SendQueue(BufferPool* pool, size_t maxBytes)
+	: pool(pool), first(0), headOffset(0), bytes(0), maxBytes(maxBytes) {}
+
+bool SendQueue::append(const char* data, size_t len) {
+	if (len == 0)
+		return true;
+	if (bytes + len > maxBytes)
+		return false;
+	// Regrouper les petites réponses dans le tampon privé de queue, de la
+	// taille d'un morceau du pool
+	if (segments.size() == first || segments.back().spare() < len) {
+		static const size_t PRIVATE_SIZE = BufferPool::CHUNK_SIZE - sizeof(SharedBuffer);
+		segments.push_back(BufferRef::withCapacity(len > PRIVATE_SIZE ? len : PRIVATE_SIZE, pool));
+	}
+	segments.back().append(data, len);
+	bytes += len;
+	return true;
+}
+
+bool SendQueue::append(const std::string& data) {
+	return append(data.data(), data.size());
+}
+
+bool SendQueue::append(const BufferRef& shared) {
+	if (bytes + shared.size() > maxBytes)
+		return false;
+	segments.push_back(shared);
+	bytes += shared.size();
+	if (shared.trace())
+		Tracer::queued(shared);
+	return true;
+}
+
+void SendQueue::appendFinal(const std::string& data) {
+	size_t limit = maxBytes;
+	maxBytes = bytes + data.size();
+	append(data);
+	maxBytes = limit;
+}
+
+SendQueue::FlushStatus SendQueue::flush(int fd) {
+	static const size_t MAX_IOV = 64;
+	struct iovec iov[MAX_IOV];
+
+	while (bytes > 0) {
+		size_t count = gather(iov, MAX_IOV);
+		ssize_t n = writev(fd, iov, static_cast<int>(count));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return FLUSH_PENDING;
+		if (n <= 0)
+			return FLUSH_ERROR;
+		consume(static_cast<size_t>(n));
+	}
+	return FLUSH_DONE;
+}
+
+size_t SendQueue::gather(struct iovec* iov, size_t maxIov) const {
+	size_t count = 0;
+	for (size_t i = first; i < segments.size() && count < maxIov; ++i) {
+		size_t skip = (count == 0) ? headOffset : 0;
+		iov[count].iov_base = const_cast<char*>(segments[i].data() + skip);
+		iov[count].iov_len = segments[i].size() - skip;
+		++count;
+	}
+	return count;
+}
+
+// Retire les segments entièrement envoyés ; leurs tampons sont libérés
+// tout de suite, la liste est tassée quand sa moitié avant est vide
+void SendQueue::consume(size_t sent) {
+	bytes -= sent;
+	while (sent > 0) {
+		size_t remaining = segments[first].size() - headOffset;
+		if (sent < remaining) {
+			headOffset += sent;
+			return;
+		}
+		sent -= remaining;
+		if (segments[first].trace())
+			Tracer::sent(segments[first]);
+		segments[first++] = BufferRef();
+		headOffset = 0;
+	}
+	if (bytes == 0) {
+		drained();
+	} else if (first * 2 >= segments.size()) {
+		segments.erase(segments.begin(), segments.begin() + first);
+		first = 0;
+	}
+}
+
+void SendQueue::discardUnsent() {
+	size_t keep = (headOffset != 0) ? 1 : 0;
+	while (segments.size() > first + keep)
+		segments.pop_back();
+	bytes = keep ? segments[first].size() - headOffset : 0;
+	if (bytes == 0)
+		drained();
+}
+
+// Plus rien à envoyer : la liste rend sa mémoire
+void SendQueue::drained() {
+	std::vector<BufferRef>().swap(segments);
+	first = 0;
+	headOffset = 0;
+}
+
+std::string SendQueue::contents() const {
+	std::string out;
+	out.reserve(bytes);
+	for (size_t i = first; i < segments.size(); ++i) {
+		size_t skip = (i == first) ? headOffset : 0;
+		out.append(segments[i].data() + skip, segments[i].size() - skip);
+	}
+	return out;
+}
+
+void SendQueue::setLimit(size_t limit) {
+	maxBytes = limit;
+}
+
+size_t SendQueue::size() const {
+	return bytes;
+}
+
+bool SendQueue::empty() const {
+	return bytes == 0;
+}
+
+size_t SendQueue::memoryUsage() const {
+	size_t total = segments.capacity() * sizeof(BufferRef);
+	for (size_t i = first; i < segments.size(); ++i)
+		total += segments[i].privateBytes();
+	return total;
+}
@@ -0,0 +1,71 @@
+#ifndef SENDQUEUE_HPP
+#define SENDQUEUE_HPP
+
+#include <vector>
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "sharedbuffer.hpp"
+
+class BufferPool;
+
+// File d'envoi bornée propre à chaque connexion. Elle contient des
+// références vers des tampons : les réponses privées sont regroupées dans
+// un tampon de queue, les diffusions de canal partagent le même tampon
+// entre tous les destinataires. flush() envoie plusieurs segments en un
+// seul writev() ; les écritures partielles et EAGAIN conservent simplement
+// le reste pour le prochain passage. Une file vide ne tient aucune mémoire :
+// le tampon privé est emprunté au pool du shard, et la liste des segments
+// est libérée dès que tout est envoyé.
+class SendQueue {
+public:
+	enum FlushStatus {
+		FLUSH_DONE,     // Tout a été envoyé
+		FLUSH_PENDING,  // Le socket est plein (EAGAIN), il reste des données
+		FLUSH_ERROR     // Erreur fatale, la connexion doit être fermée
+	};
+
+	static const size_t DEFAULT_MAX_BYTES = 1024 * 1024;
+
+	explicit SendQueue(BufferPool* pool = NULL, size_t maxBytes = DEFAULT_MAX_BYTES);
+
+	// Retourne false si l'ajout dépasserait la limite (rien n'est ajouté)
+	bool append(const char* data, size_t len);
+	bool append(const std::string& data);
+	bool append(const BufferRef& shared);
+	// Dernier message avant fermeture (ERROR) : ajouté même au-delà de la limite
+	void appendFinal(const std::string& data);
+	FlushStatus flush(int fd);
+
+	// Envoi asynchrone : décrit le début de la file sans la modifier, puis
+	// retire les octets confirmés. Les données décrites restent valides tant
+	// qu'elles n'ont pas été consommées, même si d'autres ajouts suivent.
+	size_t gather(struct iovec* iov, size_t maxIov) const;
+	void consume(size_t sent);
+
+	// Abandonne les segments dont l'envoi n'a pas commencé ; un segment
+	// entamé est gardé entier pour ne pas couper une ligne
+	void discardUnsent();
+
+	// Octets restant à envoyer, mis bout à bout (redémarrage à chaud)
+	std::string contents() const;
+
+	void setLimit(size_t limit);
+	size_t size() const;
+	bool empty() const;
+	// Mémoire tenue par la file : liste des segments et tampons privés (les
+	// tampons partagés ne sont pas comptés)
+	size_t memoryUsage() const;
+
+private:
+	void drained();
+
+	BufferPool* pool;
+	std::vector<BufferRef> segments;
+	size_t first;       // Premier segment non envoyé
+	size_t headOffset;  // Octets déjà envoyés de segments[first]
+	size_t bytes;       // Octets restant à envoyer
+	size_t maxBytes;
+};
+
+#endif // SENDQUEUE_HPP
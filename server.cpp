@@ -1,42 +1,98 @@
 #include "server.hpp"
 #include <iostream>
+#include <sstream>
 #include <cstring>
 #include <arpa/inet.h>
-#include <poll.h>
 #include <fcntl.h>
 #include <set>
-#include <sstream>
 #include <ctime>
+#include <cerrno>
+#include <csignal>
+
+Server::Server(int port, const std::string &password, const ServerConfig &config, SharedState &shared, size_t shardId, const std::string &name)
+	: server_fd(-1), port(port), serverPassword(password), serverName(name), serverPrefix(":" + name), shared(&shared), shardId(shardId),
+	  metrics(&shared.metrics().shard(shardId)), nextShard(0),
+	  outboxNewest(shared.shardCount(), static_cast<ShardMessage*>(NULL)), outboxOldest(shared.shardCount(), static_cast<ShardMessage*>(NULL)),
+	  poller(NULL), config(config), timers(TimerWheel::nowMs()),
+	  traceId(0), readStarted(0), readDone(0), readBytes(0), linking(config.linking()), linkListenFd(-1),
+	  connector(NULL), freezeRequested(false), upgrading(false), nextBatch(0) {
+
+	poller = Poller::create(this->config.poller);
+	for (size_t i = 0; i < commandCount; ++i)
+		shared.metrics().setCommandName(i, commandTable[i].name);
+
+	// Sans SO_REUSEPORT, seul le shard 0 écoute et répartit les connexions.
+	// Après un redémarrage à chaud, les sockets d'écoute sont repris
+	// (restoreState).
+	if (!Upgrade::restoring() && (shardId == 0 || shared.reusePort())) {
+		server_fd = openListener(port, true);
+	}
 
-Server::Server(int port, const std::string &password, const std::string &name)
-	: port(port), serverPassword(password), serverName(name) {
-	
-	server_fd = socket(AF_INET, SOCK_STREAM, 0);
-	if (server_fd == -1) {
-		std::cerr << "Erreur: impossible de créer le socket" << std::endl;
+	// Les liens entre serveurs sont tous tenus par le shard 0
+	if (shardId == 0 && linking) {
+		links.resize(MAX_LINKS);
+		for (size_t i = 0; i < MAX_LINKS; ++i)
+			links[i].index = i;
+		if (config.linkPort && !Upgrade::restoring())
+			linkListenFd = openListener(config.linkPort, false);
+		if (!config.connect.empty())
+			connector = new LinkConnector(config.connect, shared.mailbox(0));
+	}
+
+	// La boîte aux lettres est surveillée comme n'importe quel autre fd
+	if (!poller->add(shared.mailbox(shardId).fd(), Poller::READ)) {
+		LOG_ERROR(LOG_SERVER, "impossible d'enregistrer la boîte aux lettres du shard");
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Socket d'écoute sur `listenPort` ; `shareable` : un par shard avec SO_REUSEPORT
+int Server::openListener(int listenPort, bool shareable) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd == -1) {
+		LOG_ERROR(LOG_SERVER, "impossible de créer le socket");
 		exit(EXIT_FAILURE);
 	}
 
+	int reuse = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	if (shareable && shared->reusePort()) {
+#ifdef SO_REUSEPORT
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0)
+			shared->setReusePort(false);
+#else
+		shared->setReusePort(false);
+#endif
+	}
+
 	// Initialisation de l'adresse
 	address.sin_family = AF_INET;
 	address.sin_addr.s_addr = INADDR_ANY;
-	address.sin_port = htons(port);
+	address.sin_port = htons(listenPort);
 
-	if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
-		std::cerr << "Erreur: impossible de binder le socket" << std::endl;
+	if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+		LOG_ERROR(LOG_SERVER, "impossible de binder le socket sur le port " << listenPort << " : " << strerror(errno));
 		exit(EXIT_FAILURE);
 	}
 
-	if (listen(server_fd, 10) < 0) {
-		std::cerr << "Erreur: écoute impossible sur le socket" << std::endl;
+	if (listen(fd, SOMAXCONN) < 0) {
+		LOG_ERROR(LOG_SERVER, "écoute impossible sur le socket");
 		exit(EXIT_FAILURE);
 	}
+	setNonBlocking(fd);
+
+	// Le socket d'écoute est enregistré comme n'importe quel autre fd
+	if (!poller->addListener(fd)) {
+		LOG_ERROR(LOG_SERVER, "impossible d'enregistrer le socket d'écoute");
+		exit(EXIT_FAILURE);
+	}
+	return fd;
 }
 
 // void handleConnection(int clientSocket) {
 // 	// Step 3: Use protocol messages
 // 	std::string welcomeMessage = RPL_WELCOME; // Assuming PROTOCOL_WELCOME_MESSAGE is defined in messages.hpp
-// 	send(clientSocket, welcomeMessage.c_str(), welcomeMessage.size(), 0);
+// 	queueReply(clientSocket, welcomeMessage);
 
 // 	// Handle incoming messages
 // 	char buffer[1024];
@@ -46,16 +102,21 @@ Server::Server(int port, const std::string &password, const std::string &name)
 // 		if (receivedMessage == PROTOCOL_HELLO_MESSAGE) { // Assuming PROTOCOL_HELLO_MESSAGE is defined in messages.hpp
 // 			// Respond to hello message
 // 			std::string response = PROTOCOL_HELLO_RESPONSE;
-// 			send(clientSocket, response.c_str(), response.size(), 0);
+// 			queueReply(clientSocket, response);
 // 		}
 // 	}
 // }
 
 Server::~Server() {
-	close(server_fd);
-	for (size_t i = 0; i < clients.size(); ++i) {
-		close(clients[i]);
+	if (server_fd >= 0)
+		close(server_fd);
+	if (linkListenFd >= 0)
+		close(linkListenFd);
+	for (int fd = 0; fd < connections.fdLimit(); ++fd) {
+		if (connections.find(fd))
+			close(fd);
 	}
+	delete poller;
 }
 
 bool Server::checkPassword(int client_fd, const std::string &password) {
@@ -63,563 +124,1156 @@ bool Server::checkPassword(int client_fd, const std::string &password) {
 	return password == serverPassword;
 }
 
-#include <ctime>
-#include <iostream>
-
 void Server::start()
 {
-	std::cout << "Le serveur est en écoute sur le port " << port << std::endl;
-	
-	time_t lastPingTime = time(NULL);
+	Tracer::attach(shardId);
+	LOG_INFO(LOG_SERVER, "Le serveur est en écoute sur le port " << port << " (" << poller->name()
+		<< ", shard " << shardId + 1 << "/" << shared->shardCount() << ", analyse "
+		<< lineScanKernel() << ")");
+	if (linkListenFd >= 0)
+		LOG_INFO(LOG_SERVER, "Liens serveur acceptés sur le port " << config.linkPort << " (" << serverName << ")");
+	if (connector && !connector->start()) {
+		LOG_ERROR(LOG_SERVER, "impossible de lancer les connexions sortantes");
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<PollEvent> events;
+	std::vector<int> expired;
 
 	while (true) {
-		// 1. Utiliser select() pour surveiller les activités des sockets
-		fd_set readfds;
-		FD_ZERO(&readfds);
-		FD_SET(server_fd, &readfds);
-		int max_fd = server_fd;
-
-		// Ajouter tous les clients existants au set de descripteurs
-		for (std::map<int, Client>::iterator it = clientMap.begin(); it != clientMap.end(); ++it) {
-			FD_SET(it->first, &readfds);
-			if (it->first > max_fd) {
-				max_fd = it->first;
-			}
+		// 1. Attendre les fds actifs, au plus jusqu'à la prochaine échéance de
+		// minuterie ; sans attendre si des clients sont en file d'exécution
+		int activity = poller->wait(events, runQueue.empty() ? timers.timeoutMs(TimerWheel::nowMs()) : 0);
+		if (activity < 0) {
+			LOG_ERROR(LOG_SERVER, "Erreur de " << poller->name() << "(): " << strerror(errno));
+			exit(EXIT_FAILURE);
 		}
 
-		struct timeval timeout;
-		timeout.tv_sec = 1; // Intervalle court pour vérifier régulièrement
-		timeout.tv_usec = 0;
-
-		int activity = select(max_fd + 1, &readfds, NULL, NULL, &timeout);
-		if (activity < 0 && errno != EINTR) {
-			std::cerr << "Erreur de select()" << std::endl;
-			exit(EXIT_FAILURE);
+		// 2. Reprendre d'abord les clients dont le budget était épuisé au tour
+		// précédent, puis traiter les nouvelles connexions et messages
+		serveRunQueue();
+		for (size_t i = 0; i < events.size(); ++i) {
+			int fd = events[i].fd;
+			if (fd == server_fd) {
+				if (events[i].events & Poller::ACCEPTED)
+					acceptedClient(events[i].result);
+				else
+					acceptClients();
+			} else if (fd == linkListenFd) {
+				if (events[i].events & Poller::ACCEPTED)
+					acceptedLink(events[i].result);
+				else
+					acceptLinks();
+			} else if (fd == shared->mailbox(shardId).fd()) {
+				processMailbox();
+			} else if (events[i].events & Poller::RECEIVED) {
+				receiveClient(fd, events[i].data, events[i].result);
+			} else if (events[i].events & Poller::SENT) {
+				sendCompleted(fd, events[i].result);
+			} else {
+				if (connections.find(fd) && (events[i].events & (Poller::READ | Poller::HANGUP))) {
+					handleClient(fd);
+				}
+				Client *client = connections.find(fd);
+				if (client && (events[i].events & Poller::WRITE)) {
+					flushClient(*client);
+				}
+			}
 		}
 
-		// 2. Traiter les nouvelles connexions et messages des clients existants
-		if (FD_ISSET(server_fd, &readfds)) {
-			acceptClients();
+		// 3. Minuteries arrivées à échéance (PING, délai d'inactivité, reprise
+		// des lignes retenues par le limiteur d'entrée)
+		expired.clear();
+		timers.advance(TimerWheel::nowMs(), expired);
+		for (size_t i = 0; i < expired.size(); ++i) {
+			if (expired[i] & Client::INPUT_TIMER)
+				onInputTimer(expired[i] & ~Client::INPUT_TIMER);
+			else
+				onClientTimer(expired[i]);
 		}
 
-		for (std::map<int, Client>::iterator it = clientMap.begin(); it != clientMap.end(); ++it) {
-			int client_fd = it->first;
-			if (FD_ISSET(client_fd, &readfds)) {
-				handleClient(client_fd);
+		// 4. Envoyer en une fois tout ce qui a été mis en file pendant ce tour,
+		// d'abord vers les autres shards puis vers nos sockets
+		flushOutbox();
+		flushPendingClients();
+		publishMemory();
+
+		// 5. Redémarrage à chaud demandé (SIGUSR2) : le shard 0 prévient les
+		// autres, puis chacun gèle à la fin de son tour
+		if (shardId == 0 && Upgrade::takeRequest()) {
+			LOG_INFO(LOG_SERVER, "Redémarrage à chaud demandé");
+			for (size_t shard = 1; shard < shared->shardCount(); ++shard) {
+				postTo(shard, new ShardMessage(ShardMessage::UPGRADE));
 			}
+			flushOutbox();
+			freezeRequested = true;
 		}
+		if (freezeRequested)
+			freeze();
 
-		// 3. Appeler sendPingToClients toutes les 60 secondes
-		time_t currentTime = time(NULL);
-		if (currentTime - lastPingTime >= 60) {
-			sendPingToClients();
-			lastPingTime = currentTime;
+		// 6. Arrêt demandé (SIGINT) : main() termine le processus
+		if (shardId == 0 && stopRequested()) {
+			LOG_INFO(LOG_SERVER, "Signal d'arrêt reçu. Fermeture du serveur...");
+			return;
 		}
-
-		// 4. Appeler disconnectInactiveClients pour déconnecter les clients inactifs
-		disconnectInactiveClients();
 	}
 }
 
 
 void Server::acceptClients() {
-	struct pollfd fds[100];
-	int client_count = 0;
-
-	fds[0].fd = server_fd;
-	fds[0].events = POLLIN;
-
+	// Mode edge-triggered : accepter jusqu'à épuisement de la file d'attente
 	while (true) {
-		int poll_count = poll(fds, client_count + 1, -1);
-		if (poll_count < 0) {
-			std::cerr << "Erreur: poll() échoué - " << strerror(errno) << std::endl;
-			continue;
+		struct sockaddr_in client_address;
+		socklen_t client_len = sizeof(client_address);
+		int new_client = accept(server_fd, (struct sockaddr*)&client_address, &client_len);
+		if (new_client < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				LOG_WARN(LOG_NET, "Accept échoué - " << strerror(errno));
+			return;
 		}
 
-		if (fds[0].revents & POLLIN) {
-			struct sockaddr_in client_address;
-			socklen_t client_len = sizeof(client_address);
-			int new_client = accept(server_fd, (struct sockaddr*)&client_address, &client_len);
-			if (new_client < 0) {
-				std::cerr << "Erreur: Accept échoué - " << strerror(errno) << std::endl;
-				continue;
-			}
+		acceptedClient(new_client);
+	}
+}
 
-			setNonBlocking(new_client);
-			
-			// Activer SO_KEEPALIVE pour maintenir la connexion active
-			int optval = 1;
-			setsockopt(new_client, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
+// Nouvelle connexion acceptée (par accept() ou par le backend io_uring)
+void Server::acceptedClient(int new_client) {
+	if (new_client < 0) {
+		LOG_WARN(LOG_NET, "Accept échoué - " << strerror(-new_client));
+		return;
+	}
+	// Sans SO_REUSEPORT, répartir les connexions entre shards à tour de rôle
+	size_t target = shared->reusePort() ? shardId : nextShard++ % shared->shardCount();
+	if (target == shardId) {
+		adoptClient(new_client);
+	} else {
+		ShardMessage *msg = new ShardMessage(ShardMessage::NEW_CONNECTION);
+		msg->fd = new_client;
+		postTo(target, msg);
+	}
+}
 
-			std::cout << "Nouveau client connecté!" << std::endl;
-			client_count++;
-			fds[client_count].fd = new_client;
-			fds[client_count].events = POLLIN;
-		}
+// Surveille et enregistre une connexion acceptée ; NULL si elle est refusée
+Client *Server::adoptClient(int new_client) {
+	if (new_client >= (1 << CLIENT_FD_BITS)) {
+		close(new_client);
+		return NULL;
+	}
+	setNonBlocking(new_client);
+	
+	// Activer SO_KEEPALIVE pour maintenir la connexion active
+	int optval = 1;
+	setsockopt(new_client, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
+
+	if (!poller->addConnection(new_client)) {
+		LOG_WARN(LOG_NET, "impossible de surveiller le client " << new_client);
+		close(new_client);
+		return NULL;
+	}
+	Client &client = connections.insert(new_client);
+	client.sendq.setLimit(config.sendq);
+	metricAdd(metrics->connectionsAccepted);
+	client.lastActivity = TimerWheel::nowMs();
+	// Décalage aléatoire pour étaler les PING des clients connectés ensemble
+	uint64_t jitter = static_cast<uint64_t>(rand()) % (config.pingInterval * 250 + 1);
+	timers.schedule(client.timer, client.lastActivity + config.pingInterval * 1000 + jitter);
+	LOG_INFO(LOG_NET, "Nouveau client connecté!");
+	return &client;
+}
 
-		// Gestion des autres événements pour les clients connectés
-		for (int i = 1; i <= client_count; i++) {
-			if (fds[i].revents & POLLIN) {
-				handleClient(fds[i].fd);
-
-				if (fds[i].fd == -1) {
-					for (int j = i; j < client_count; ++j) {
-						fds[j] = fds[j + 1];
-					}
-					--client_count;
-					--i;
-				}
-			}
+void Server::removeClient(int client_fd, const std::string &reason) {
+	Client *client = connections.find(client_fd);
+	if (client && client->link) {
+		closeLink(*client->link);
+	} else if (client) {
+		// Ses canaux seulement, et un seul QUIT par voisin
+		ReplyLine line;
+		line << client->prefix << " QUIT :" << reason;
+		BufferRef quitLine = line.end().buffer();
+		std::set<ClientId> neighbors;
+		leaveChannels(idOf(client_fd), client->profile->channels, neighbors);
+		notifyNeighbors(neighbors, quitLine);
+		if (client->nickReceived) {
+			shared->releaseNick(client->nickname, idOf(client_fd));
+			if (linking)
+				propagate(quitLine);
 		}
 	}
+	poller->remove(client_fd);
+	close(client_fd);
+	connections.erase(client_fd);
+	metricAdd(metrics->connectionsClosed);
+	LOG_INFO(LOG_NET, "Client " << client_fd << " déconnecté et supprimé.");
 }
 
-void Server::removeClient(int client_fd) {
-	close(client_fd);
-	clientMap.erase(client_fd);
-	std::cout << "Client " << client_fd << " déconnecté et supprimé." << std::endl;
+// Retourne le client à qui écrire et planifie son envoi, ou NULL s'il
+// n'existe plus ou est en cours de fermeture
+Client *Server::replyTarget(int client_fd) {
+	Client *client = connections.find(client_fd);
+	if (client == NULL || client->closing)
+		return NULL;
+	if (!client->flushScheduled) {
+		client->flushScheduled = true;
+		pendingFlush.push_back(client_fd);
+	}
+	return client;
 }
 
-void Server::setNonBlocking(int fd) {
-	int flags = fcntl(fd, F_GETFL, 0);
-	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+// Le client ne lit pas assez vite : ce qui n'est pas encore parti est
+// abandonné pour que ERROR lui parvienne (sauf si un envoi asynchrone
+// décrit encore ces données), et la mémoire retenue reste bornée par --sendq
+void Server::sendQueueFull(Client &client) {
+	LOG_WARN(LOG_NET, "Client " << client.fd << " : file d'envoi pleine, déconnexion.");
+	metricAdd(metrics->sendqDropped);
+	if (!client.sendInFlight)
+		client.sendq.discardUnsent();
+	disconnectClient(client, "Max SendQ exceeded");
 }
 
-bool isValidUTF8(const std::string &str) {
-	int bytesToProcess = 0;
-	for (std::string::size_type i = 0; i < str.size(); ++i) {
-		unsigned char c = static_cast<unsigned char>(str[i]);
-		
-		if (bytesToProcess == 0) {
-			if ((c & 0x80) == 0) continue;                 // 0xxxxxxx (ASCII)
-			else if ((c & 0xE0) == 0xC0) bytesToProcess = 1; // 110xxxxx
-			else if ((c & 0xF0) == 0xE0) bytesToProcess = 2; // 1110xxxx
-			else if ((c & 0xF8) == 0xF0) bytesToProcess = 3; // 11110xxx
-			else return false;  // Caractère non valide pour UTF-8
-		} else {
-			if ((c & 0xC0) != 0x80) return false; // Les octets suivants doivent être 10xxxxxx
-			--bytesToProcess;
-		}
+// Ajoute une réponse à la file d'envoi du client ; l'envoi réel est fait
+// par flushPendingClients() à la fin du tour de boucle
+void Server::queueReply(int client_fd, const std::string& message) {
+	Client *client = replyTarget(client_fd);
+	if (client && !client->sendq.append(message))
+		sendQueueFull(*client);
+}
+
+void Server::queueReply(int client_fd, const BufferRef& message) {
+	Client *client = replyTarget(client_fd);
+	if (client && !client->sendq.append(message))
+		sendQueueFull(*client);
+}
+
+// Ligne formatée sur la pile : copiée directement dans la file d'envoi
+void Server::queueReply(int client_fd, const ReplyLine& line) {
+	Client *client = replyTarget(client_fd);
+	if (client && !client->sendq.append(line.data(), line.size()))
+		sendQueueFull(*client);
+}
+
+// Réponse numérique du serveur, d'après la table de replies.cpp
+void Server::reply(Client &client, Numeric numeric, const StrView &a1, const StrView &a2, const StrView &a3, const StrView &a4) {
+	const StrView args[] = { a1, a2, a3, a4 };
+	ReplyLine line;
+	formatNumeric(line, serverPrefix, numeric, client.nickname, args, 4);
+	queueReply(client.fd, line);
+}
+
+// Réponse standard IRCv3 : ":serveur FAIL <commande> <code> [contexte...] :<description>"
+void Server::fail(Client &client, const char *command, const char *code, const char *description,
+	const StrView &context, const StrView &context2) {
+	ReplyLine line;
+	line << serverPrefix << " FAIL " << command << ' ' << code;
+	if (!context.empty())
+		line << ' ' << context;
+	if (!context2.empty())
+		line << ' ' << context2;
+	line << " :" << description;
+	queueReply(client.fd, line.end());
+}
+
+// Recalculée à chaque NICK et à USER : l'hôte est l'adresse du pair
+void Server::updatePrefix(Client &client) {
+	char host[INET_ADDRSTRLEN] = "unknown";
+	struct sockaddr_in peer;
+	socklen_t len = sizeof(peer);
+	if (getpeername(client.fd, reinterpret_cast<struct sockaddr*>(&peer), &len) == 0 && peer.sin_family == AF_INET)
+		inet_ntop(AF_INET, &peer.sin_addr, host, sizeof(host));
+	ReplyLine line;
+	line << ':' << client.nickname << '!' << (client.profile->username.empty() ? StrView("*", 1) : StrView(client.profile->username))
+		<< '@' << host;
+	client.prefix.assign(line.data(), line.size());
+}
+
+// Formate le message une seule fois et en place une référence dans la file
+// de chaque membre du canal, sauf `except` (l'expéditeur le cas échéant)
+void Server::broadcast(const Channel &channel, const std::string &message, ClientId except) {
+	deliverToMembers(channel.members, BufferRef::copyOf(message), except);
+}
+
+void Server::broadcast(const Channel &channel, const BufferRef &message, ClientId except) {
+	deliverToMembers(channel.members, message, except);
+}
+
+// Les utilisateurs distants sont prévenus par leur serveur (propagate)
+static void addLocalMembers(const Channel &channel, ClientId except, std::set<ClientId> &out) {
+	for (MemberModes::const_iterator it = channel.clients.begin(); it != channel.clients.end(); ++it) {
+		if (!isRemote(it->first) && it->first != except)
+			out.insert(it->first);
 	}
-	return bytesToProcess == 0; // Vérifie que la chaîne s'est terminée correctement
 }
 
-/*Implementation IRC*/
+// Retire `id` de ses canaux (`channels` peut en contenir qu'il a déjà
+// quittés), ajoute à `neighbors` les membres locaux qui y restent et vide
+// `channels` en rendant ses entrées
+void Server::leaveChannels(ClientId id, ChannelSet &channels, std::set<ClientId> &neighbors) {
+	for (ChannelSet::const_iterator it = channels.begin(); it != channels.end(); ++it) {
+		ChannelLock lock(*shared, *it);
+		Channel *channel = lock.find();
+		lock.unpin();
+		if (channel == NULL || channel->clients.erase(id) == 0)
+			continue;
+		addLocalMembers(*channel, id, neighbors);
+		publishMembers(*channel);
+		if (channel->clients.empty())
+			lock.erase();
+	}
+	channels.clear();
+}
 
-// Fonction principale de traitement des commandes
-void Server::processCommand(int client_fd, const std::string &message) {
-	// Vérifier l'encodage UTF-8
-	if (!isValidUTF8(message)) {
-		std::string errorMsg = ":server 400 " + clientMap[client_fd].nickname + " :Invalid UTF-8 encoding\r\n";
-		send(client_fd, errorMsg.c_str(), errorMsg.size(), 0);
+// `id`, retiré du canal verrouillé par `lock` (KICK), n'en est plus membre :
+// son profil rend l'entrée épinglée. Le profil d'un client d'un autre shard
+// n'est touché que par ce shard, prévenu par message.
+void Server::dropMembership(ClientId id, ChannelLock &lock) {
+	if (isRemote(id))
+		return;
+	if (clientShard(id) != shardId) {
+		ShardMessage *msg = new ShardMessage(ShardMessage::CHANNEL_LEFT);
+		msg->target = id;
+		msg->channel = lock.interned()->display;
+		postTo(clientShard(id), msg);
 		return;
 	}
-	if (client_fd < 0 ) {
-		std::cerr << "Erreur: client non enregistré" << std::endl;
+	Client *client = localClient(id);
+	if (client != NULL && client->profile->channels.erase(lock.interned()))
+		lock.unpin();
+}
+
+// CHANNEL_LEFT : le client a pu revenir dans le canal (ou le quitter)
+// depuis l'envoi du message ; le canal, verrouillé, fait foi
+void Server::forgetChannel(ClientId id, const std::string &channelName) {
+	Client *client = localClient(id);
+	if (client == NULL)
+		return;
+	ChannelLock lock(*shared, channelName);
+	Channel *channel = lock.find();
+	if (lock.interned() == NULL || (channel != NULL && channel->clients.count(id) != 0))
 		return;
+	if (client->profile->channels.erase(lock.interned()))
+		lock.unpin();
+}
+
+// Membres locaux partageant au moins un canal avec `id`, lui excepté
+void Server::collectNeighbors(ClientId id, const ChannelSet &channels, std::set<ClientId> &neighbors) {
+	for (ChannelSet::const_iterator it = channels.begin(); it != channels.end(); ++it) {
+		ChannelLock lock(*shared, *it);
+		Channel *channel = lock.find();
+		if (channel && channel->clients.count(id))
+			addLocalMembers(*channel, id, neighbors);
 	}
-	std::istringstream iss(message);
-	std::string command;
-	iss >> command;
+}
 
-	Client &client = clientMap[client_fd];
-	std::cout << "[DEBUG]: Client: " << &client << " its fd: " << client_fd << std::endl;
-	if (!client.registered) {
-		if (command != "PASS" && command != "NICK" && command != "USER") {
-			std::string errorMsg = ":server 451 :You have not registered\r\n";
-			send(client_fd, errorMsg.c_str(), errorMsg.size(), 0);
-			return;
-		}
+// Un seul exemplaire par voisin, quel que soit le nombre de canaux communs
+void Server::notifyNeighbors(const std::set<ClientId> &neighbors, const BufferRef &line) {
+	if (!neighbors.empty())
+		deliverToMembers(MemberList(new MemberSnapshot(neighbors, 0)), line);
+}
+
+/* ************************************************************************** */
+/*                         Communication entre shards                         */
+/* ************************************************************************** */
+
+ClientId Server::idOf(int client_fd) const {
+	return makeClientId(shardId, connections.generation(client_fd), client_fd);
+}
+
+// Client de ce shard désigné par `id`, ou NULL s'il est parti depuis (même
+// si un autre client a repris son fd)
+Client *Server::localClient(ClientId id) const {
+	if (id < 0 || clientShard(id) != shardId)
+		return NULL;
+	Client *client = connections.find(clientFd(id));
+	if (client == NULL || client->generation != clientGeneration(id))
+		return NULL;
+	return client;
+}
+
+// Envoie une réponse à un client de n'importe quel shard
+void Server::sendTo(ClientId id, const std::string& message) {
+	sendTo(id, BufferRef::copyOf(message));
+}
+
+void Server::sendTo(ClientId id, const BufferRef& message) {
+	uint64_t started = 0;
+	if (traceId) {
+		started = metricNowNs();
+		Tracer::begin(message, traceId);
+	}
+	if (isRemote(id)) {
+		linkOutput(message, id, MemberList(), -1);
+	} else if (clientShard(id) == shardId) {
+		if (Client *client = localClient(id))
+			queueReply(client->fd, message);
+	} else {
+		ShardMessage *msg = new ShardMessage(ShardMessage::DELIVER);
+		msg->target = id;
+		msg->payload = message;
+		Tracer::hold(message);
+		postTo(clientShard(id), msg);
+	}
+	if (traceId)
+		Tracer::finish(message, started, 1);
+}
+
+// Les messages sont regroupés par shard et postés en fin de tour
+void Server::postTo(size_t shard, ShardMessage *msg) {
+	msg->next = outboxNewest[shard];
+	outboxNewest[shard] = msg;
+	if (outboxOldest[shard] == NULL)
+		outboxOldest[shard] = msg;
+}
+
+void Server::flushOutbox() {
+	for (size_t shard = 0; shard < outboxNewest.size(); ++shard) {
+		if (outboxNewest[shard] == NULL)
+			continue;
+		shared->mailbox(shard).post(outboxNewest[shard], outboxOldest[shard]);
+		outboxNewest[shard] = outboxOldest[shard] = NULL;
 	}
-	// Commande CAP pour la négociation des capacités
-	std::cout << "[DEBUG] Received command: " << command << " VS  Received message: " << message << std::endl;
-	if (command == "CAP") {
-		std::string subcommand;
-		iss >> subcommand;
-
-		if (subcommand == "LS") {
-			std::string capResponse = ":server CAP * LS :\r\n"; // Liste vide des capacités
-			send(client_fd, capResponse.c_str(), capResponse.size(), 0);
-		} else if (subcommand == "REQ") {
-			std::string capRequested;
-			iss >> capRequested;
-			std::string capAckResponse = ":server CAP * NAK :" + capRequested + "\r\n";
-			send(client_fd, capAckResponse.c_str(), capAckResponse.size(), 0);
-		} else if (subcommand == "END") {
-			std::string capEndResponse = ":server CAP * END\r\n";
-			send(client_fd, capEndResponse.c_str(), capEndResponse.size(), 0);
+}
+
+void Server::processMailbox() {
+	ShardMessage *msg = shared->mailbox(shardId).takeAll();
+	while (msg) {
+		switch (msg->type) {
+		case ShardMessage::NEW_CONNECTION:
+			adoptClient(msg->fd);
+			break;
+		case ShardMessage::DELIVER:
+			if (Client *client = localClient(msg->target))
+				queueReply(client->fd, msg->payload);
+			Tracer::release(msg->payload);
+			break;
+		case ShardMessage::DELIVER_CHANNEL:
+			deliverLocal(msg->members, msg->payload, msg->target);
+			Tracer::release(msg->payload);
+			break;
+		case ShardMessage::MEMBERS_CHANGED:
+			installMembers(msg->channel, msg->members);
+			break;
+		case ShardMessage::LINK_CONNECTED:
+			openLink(msg->fd, static_cast<int>(msg->target));
+			break;
+		case ShardMessage::LINK_SEND:
+			linkOutput(msg->payload, msg->target, msg->members, -1);
+			break;
+		case ShardMessage::DISCONNECT:
+			if (Client *client = localClient(msg->target))
+				disconnectClient(*client, std::string(msg->payload.data(), msg->payload.size()));
+			break;
+		case ShardMessage::CHANNEL_LEFT:
+			forgetChannel(msg->target, msg->channel);
+			break;
+		case ShardMessage::UPGRADE:
+			freezeRequested = true;
+			break;
 		}
+		ShardMessage *next = msg->next;
+		delete msg;
+		msg = next;
+	}
+}
+
+// Livre un message à tous les membres : directement pour ce shard, par un
+// seul message par shard distant qui fera lui-même la distribution locale.
+// Un message suivi (trace.hpp) garde un compte de ses destinataires ; les
+// gardes sont prises et rendues même sans suivi en cours, le tampon pouvant
+// en porter un d'une diffusion précédente.
+void Server::deliverToMembers(const MemberList &members, const BufferRef &message, ClientId except) {
+	if (members.isNull())
 		return;
+	size_t recipients = members->members.size() - (except >= 0 && members->contains(except));
+	metricRecord(metrics->fanout, recipients);
+	IRC_PROBE2(fanout, recipients, message.size());
+	uint64_t started = 0;
+	if (traceId) {
+		started = metricNowNs();
+		Tracer::begin(message, traceId);
 	}
+	for (size_t shard = 0; shard < shared->shardCount(); ++shard) {
+		if (!members->hasShard(shard))
+			continue;
+		if (shard == shardId) {
+			deliverLocal(members, message, except);
+		} else {
+			ShardMessage *msg = new ShardMessage(ShardMessage::DELIVER_CHANNEL);
+			msg->payload = message;
+			msg->members = members;
+			msg->target = except;
+			Tracer::hold(message);
+			postTo(shard, msg);
+		}
+	}
+	if (traceId)
+		Tracer::finish(message, started, recipients);
+}
 
-	if (command == "PASS") {
-		std::string password;
-		iss >> password;
-		if (!checkPassword(client_fd, password)) {
-			return;
+void Server::deliverLocal(const MemberList &members, const BufferRef &message, ClientId except) {
+	size_t begin, end;
+	members->shardRange(shardId, begin, end);
+	for (size_t i = begin; i < end; ++i) {
+		if (members->members[i] == except)
+			continue;
+		if (Client *client = localClient(members->members[i]))
+			queueReply(client->fd, message);
+	}
+}
+
+// À appeler sous ChannelLock après toute modification de channel.clients :
+// publie la nouvelle liste aux shards concernés (anciens et nouveaux membres)
+void Server::publishMembers(Channel &channel) {
+	MemberList previous = channel.members;
+	channel.members = MemberList(new MemberSnapshot(channel.clients, shared->nextVersion()));
+	for (size_t shard = 0; shard < shared->shardCount(); ++shard) {
+		if (!channel.members->hasShard(shard) && (previous.isNull() || !previous->hasShard(shard)))
+			continue;
+		if (shard == shardId) {
+			installMembers(channel.name, channel.members);
+		} else {
+			ShardMessage *msg = new ShardMessage(ShardMessage::MEMBERS_CHANGED);
+			msg->channel = channel.name;
+			msg->members = channel.members;
+			postTo(shard, msg);
 		}
-		client.passReceived = true;
-	} else if (command == "NICK") {
-		if (!client.passReceived && !serverPassword.empty()) {
+	}
+}
+
+// Les listes peuvent arriver dans le désordre depuis plusieurs shards :
+// seule une version plus récente remplace la réplique locale
+void Server::installMembers(const std::string &channelName, const MemberList &members) {
+	MemberList *current = channelMembers.find(channelName);
+	if (current != NULL && (*current)->version >= members->version)
+		return;
+	if (members->members.empty()) {
+		if (current != NULL)
+			channelMembers.erase(channelName);
+		return;
+	}
+	if (current != NULL)
+		*current = members;
+	else
+		channelMembers.insert(channelName, members);
+}
+
+void Server::flushClient(Client &client) {
+	if (poller->completions()) {
+		// Un seul envoi en vol par client : la suite part à sa complétion,
+		// et tous les envois du tour sont soumis avec l'attente suivante
+		if (client.sendInFlight || client.sendq.empty())
 			return;
-		}
-		std::string nickname;
-		iss >> nickname;
-		setNickname(client_fd, nickname);
-	} else if (command == "USER") {
-		std::cout << "[DEBUG] entering USER" << std::endl;
-		// if (!client.passReceived) {
-
-		// 	return;
-		// }
-		std::string username, realname;
-		iss >> username;
-		client.is_authenticated = true;
-		std::getline(iss, realname);
-		setUser(client_fd, username, realname);
-		std::cout << "[DEBUG] Finish up USER" << std::endl;
-		sendWelcomeMessages(client, client_fd);
-	} else if (command == "PING") {
-		std::string pongMessage = "PONG :" + command.substr(5) + "\r\n"; // Réponse au PING
-		send(client_fd, pongMessage.c_str(), pongMessage.size(), 0);
-	} else {
-		if (!client.registered) {
+		metricRecord(metrics->sendqDepth, client.sendq.size());
+		struct iovec iov[Poller::MAX_SEND_IOV];
+		size_t count = client.sendq.gather(iov, Poller::MAX_SEND_IOV);
+		if (!poller->send(client.fd, iov, static_cast<int>(count))) {
+			client.closing = true;
 			return;
 		}
+		client.sendInFlight = true;
+		return;
+	}
+	size_t queued = client.sendq.size();
+	if (queued != 0)
+		metricRecord(metrics->sendqDepth, queued);
+	SendQueue::FlushStatus status = client.sendq.flush(client.fd);
+	metricAdd(metrics->bytesOut, queued - client.sendq.size());
+	IRC_PROBE2(flush, client.fd, queued - client.sendq.size());
+	if (status == SendQueue::FLUSH_ERROR) {
+		client.closing = true;
+		return;
+	}
+	// N'écouter POLLOUT que tant qu'il reste des données à envoyer
+	bool wantWrite = (status == SendQueue::FLUSH_PENDING);
+	if (wantWrite != client.wantWrite) {
+		client.wantWrite = wantWrite;
+		poller->modify(client.fd, wantWrite ? (Poller::READ | Poller::WRITE) : Poller::READ);
+	}
+}
 
-		if (command == "/JOIN") {
-			std::string channel;
-			iss >> channel;
-			joinChannel(client_fd, channel);
-		} else if (command == "PART") {
-			std::string channel;
-			iss >> channel;
-			partChannel(client_fd, channel);
-		} else if (command == "KICK") {
-			std::string channel, user;
-			iss >> channel >> user;
-			kickUser(client_fd, channel, user);
-		} else if (command == "MODE") {
-			std::string channel, mode, parameter;
-			iss >> channel >> mode;
-			if (iss >> parameter) {
-				setChannelMode(client_fd, channel, mode, parameter);
-			} else {
-				setChannelMode(client_fd, channel, mode);
-			}
-		} else if (command == "TOPIC") {
-			std::string channel, topic;
-			iss >> channel;
-			std::getline(iss, topic);
-			topicChannel(client_fd, channel, topic);
-		} else if (command == "PRIVMSG") {
-			std::string recipient, messageBody;
-			iss >> recipient;
-			std::getline(iss, messageBody);
-			sendMessage(client_fd, recipient, messageBody);
-		} else if (command == "QUIT") {
-			close(client_fd);
+void Server::flushPendingClients() {
+	std::vector<int> pending;
+	pending.swap(pendingFlush);
+	for (size_t i = 0; i < pending.size(); ++i) {
+		Client *client = connections.find(pending[i]);
+		if (client == NULL)
+			continue;
+		client->flushScheduled = false;
+		// Même un client en fermeture reçoit ce qui reste (ERROR compris)
+		flushClient(*client);
+		// Envoi asynchrone en cours : fermer à sa complétion
+		if (client->closing && !client->sendInFlight)
+			removeClient(pending[i]);
+	}
+}
+
+// Complétion d'un envoi du backend io_uring : `result` octets ou -errno
+void Server::sendCompleted(int client_fd, int result) {
+	Client *found = connections.find(client_fd);
+	if (found == NULL)
+		return;
+	Client &client = *found;
+	client.sendInFlight = false;
+	if (result < 0) {
+		removeClient(client_fd);
+		return;
+	}
+	client.sendq.consume(static_cast<size_t>(result));
+	metricAdd(metrics->bytesOut, static_cast<uint64_t>(result));
+	IRC_PROBE2(flush, client_fd, result);
+	// Un client en fermeture reçoit d'abord la fin de sa file (ERROR compris)
+	flushClient(client);
+	if (client.closing && !client.sendInFlight)
+		removeClient(client_fd);
+}
+
+void Server::setNonBlocking(int fd) {
+	int flags = fcntl(fd, F_GETFL, 0);
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+void Server::handleClient(int client_fd) {
+	Client *client = connections.find(client_fd);
+	if (client == NULL)
+		return;
+	client->readable = true;
+	// Déjà dans la file d'exécution : il sera lu à son tour
+	if (!client->runQueued)
+		serveClient(*client);
+}
+
+// Un passage d'un client : ses lignes en attente puis, tant que son socket
+// n'est pas vidé, de nouvelles lectures. En edge-triggered il faut lire
+// jusqu'à EAGAIN, sinon le reste ne serait plus signalé ; pour qu'un client
+// chargé ne monopolise pas le tour, le passage s'arrête aussi après
+// READ_BUDGET octets ou COMMAND_BUDGET lignes, et le client va dans la file
+// d'exécution. Tout est lu dans la zone commune du shard ; processLines()
+// ne garde que ce qui n'a pas été traité.
+void Server::serveClient(Client &client) {
+	int client_fd = client.fd;
+	unsigned budget = COMMAND_BUDGET;
+	if (client.recvbuf.pending() != 0 && !processLines(client, budget))
+		return;
+	char *scratch = connections.buffers().scratch();
+	size_t received = 0;
+	while (client.readable && budget != 0 && received < READ_BUDGET) {
+		if (Tracer::enabled())
+			readStarted = metricNowNs();
+		ssize_t valread = recv(client_fd, scratch, BufferPool::SCRATCH_SIZE, 0);
+
+		if (valread > 0) {
+			received += static_cast<size_t>(valread);
+			client.recvbuf.feed(scratch, static_cast<size_t>(valread));
+			metricAdd(metrics->bytesIn, static_cast<uint64_t>(valread));
+			IRC_PROBE2(read, client_fd, valread);
+			if (!processInput(client, static_cast<size_t>(valread), budget))
+				return; // Le client est parti (QUIT)
+		} else if (valread == 0) {
+			// Déconnexion propre
+			LOG_DEBUG(LOG_NET, "Client déconnecté proprement !");
 			removeClient(client_fd);
+			return;
 		} else {
-			// Commande inconnue
-			std::string errorMsg = ":server 421 " + client.nickname + " " + command + " :Unknown command\r\n";
-			send(client_fd, errorMsg.c_str(), errorMsg.size(), 0);
-			std::cerr << "Commande inconnue reçue de " << client_fd << ": " << command << std::endl;
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				removeClient(client_fd);
+				return;
+			}
+			client.readable = false;
 		}
 	}
+	if (budget == 0 || client.readable)
+		scheduleRun(client);
 }
 
-void Server::handleClient(int client_fd) {
-	char buffer[1024] = {0};
-	int valread = read(client_fd, buffer, 1024);
-	std::
-	std::cout << "[DEBUG] ################## fun ##################" << std::endl;
-
-	if (valread > 0) {
-		std::cout << "[DEBUG] Reeceived message: " << buffer << std::endl;
-		// send(client_fd, "Bienvenue sur le serveur IRC!\n", strlen("Bienvenue sur le serveur IRC!\n"), 0);
-
-		std::string message(buffer);
-		std::stringstream ss(message);
-		std::string to;
-
-		while(std::getline(ss,to,'\n')){
-			std::cout << "[DEBUG] handling commmand: " << to << std::endl;
-			processCommand(client_fd, to);
-		}
-		// processCommand(client_fd, message);
-	} else if (valread == 0) {
-		// Déconnexion propre
-		std::cout << "Client déconnecté proprement !" << std::endl;
-		close(client_fd);
+// Budget épuisé : le client reprend au tour suivant, après ceux déjà en file
+void Server::scheduleRun(Client &client) {
+	if (client.runQueued)
+		return;
+	client.runQueued = true;
+	runQueue.push_back(client.fd);
+	poller->pauseReading(client.fd);
+	metricAdd(metrics->readBudgetExhausted);
+}
+
+// Un passage pour chaque client en file, dans l'ordre d'arrivée ; ceux qui
+// épuisent encore leur budget repassent en fin de file pour le tour suivant
+void Server::serveRunQueue() {
+	std::vector<int> queued;
+	queued.swap(runQueue);
+	for (size_t i = 0; i < queued.size(); ++i) {
+		Client *client = connections.find(queued[i]);
+		if (client == NULL || !client->runQueued)
+			continue;
+		client->runQueued = false;
+		if (!client->closing)
+			serveClient(*client);
+		// Son tour est fini sans reste : les lectures reprennent
+		client = connections.find(queued[i]);
+		if (client != NULL && !client->runQueued)
+			poller->resumeReading(client->fd);
+	}
+}
+
+// Données lues par le backend io_uring : `len` octets, 0 ou -errno en fin de connexion
+void Server::receiveClient(int client_fd, const char *data, int len) {
+	Client *client = connections.find(client_fd);
+	if (client == NULL)
+		return;
+	if (len <= 0) {
+		if (len == 0)
+			LOG_DEBUG(LOG_NET, "Client déconnecté proprement !");
 		removeClient(client_fd);
 		return;
 	}
+	if (Tracer::enabled())
+		readStarted = metricNowNs();   // Lecture faite par le noyau : durée nulle
+	client->recvbuf.feed(data, static_cast<size_t>(len));
+	metricAdd(metrics->bytesIn, static_cast<uint64_t>(len));
+	IRC_PROBE2(read, client_fd, len);
+	unsigned budget = COMMAND_BUDGET;
+	if (processInput(*client, static_cast<size_t>(len), budget) && budget == 0)
+		scheduleRun(*client);
+}
 
-	// Traiter les données reçues
-	// std::string message(buffer, valread); //valread = strlen(buffer)
-	// processCommand(client_fd, message);
+// Données reçues : le client est actif, puis ses lignes sont traitées dans
+// la limite de `budget`. Retourne false si le client a été supprimé ou est
+// en fermeture.
+bool Server::processInput(Client &client, size_t bytes, unsigned &budget) {
+	client.lastActivity = TimerWheel::nowMs();
+	client.pingSent = false;
+	// io_uring lit sans attendre : un client en file d'exécution garde ses
+	// lignes pour son tour, recopiées hors du tampon que le noyau va
+	// reprendre
+	if (client.runQueued) {
+		client.recvbuf.settle();
+		return true;
+	}
+	readBytes = bytes;
+	readDone = Tracer::enabled() ? metricNowNs() : 0;
+	bool alive = processLines(client, budget);
+	readDone = 0;   // Lignes reprises plus tard (limiteur, budget) : sans étape read
+	return alive;
 }
 
-void Server::setNickname(int client_fd, const std::string& nickname) {
-	if (clientMap.find(client_fd) == clientMap.end()) {
-		// Si le client n'est pas enregistré, créer une nouvelle entrée
-		clientMap[client_fd] = Client(client_fd);
+// Traite les lignes complètes que le limiteur d'entrée autorise, au plus
+// `budget` (décompté) ; le reste attend la lecture suivante, la reprise par
+// inputTimer ou la file d'exécution, recopié hors de la zone de lecture
+// (LineBuffer::settle) avant la lecture d'un autre client.
+//
+// Le limiteur est un seau à jetons exprimé en temps : chaque ligne avance
+// floodClock de 1/floodRate s, et une ligne n'est traitée que si floodClock
+// n'a pas plus de floodBurst - 1 lignes d'avance sur le présent. Les lignes
+// retenues restent dans recvbuf ; au-delà de --recvq octets, le client est
+// déconnecté ("Excess Flood") pour que la mémoire reste bornée. Les lignes
+// laissées par le budget ne sont pas un excès : les lectures du client
+// s'arrêtent jusqu'à son tour (Poller::pauseReading pour io_uring).
+bool Server::processLines(Client &client, unsigned &budget) {
+	int client_fd = client.fd;
+	uint64_t now = TimerWheel::nowMs();
+	uint64_t cost = (config.floodRate && client.link == NULL) ? 1000 / config.floodRate : 0;
+	uint64_t window = cost * (config.floodBurst - 1);
+
+	StrView line;
+	LineBuffer::Status status;
+	while (!client.closing && budget != 0) {
+		if (client.floodClock < now)
+			client.floodClock = now;
+		if (client.floodClock - now > window) {
+			if (client.recvbuf.pending() != 0 && !client.inputTimer.isScheduled()) {
+				metricAdd(metrics->inputThrottled);
+				timers.schedule(client.inputTimer, client.floodClock - window);
+			}
+			break;
+		}
+		if ((status = client.recvbuf.nextLine(line)) == LineBuffer::NEED_MORE)
+			break;
+		client.floodClock += cost;
+		--budget;
+		if (status == LineBuffer::LINE_TOO_LONG) {
+			reply(client, ERR_INPUTTOOLONG);
+			continue;
+		}
+		if (line.empty())
+			continue;
+		LOG_DEBUG(LOG_IRC, "handling commmand: " << line);
+		IRC_PROBE2(frame, client_fd, line.len);
+		if (Tracer::enabled() && (traceId = Tracer::sample()) != 0) {
+			uint64_t framed = metricNowNs();
+			if (readDone)
+				Tracer::record(traceId, TRACE_READ, readStarted, readDone, readBytes);
+			Tracer::record(traceId, TRACE_FRAME, readDone ? readDone : framed, framed, client_fd);
+		}
+		processCommand(client_fd, line);
+		traceId = 0;
+		if (connections.find(client_fd) == NULL)
+			return false;
 	}
+	client.recvbuf.settle();
+	if (!client.closing && budget != 0 && client.recvbuf.pending() > config.recvq) {
+		LOG_WARN(LOG_NET, "Client " << client_fd << " : trop de lignes en attente, déconnexion.");
+		metricAdd(metrics->recvqDropped);
+		disconnectClient(client, "Excess Flood");
+	}
+	return !client.closing;
+}
 
-	// Assigner le pseudo
-	clientMap[client_fd].nickname = nickname;
-	std::cout << "[DEBUG] Client set their nickname: " << nickname << std::endl;
-	// std::cout << "Client " << client_fd << " a défini son pseudo en {send back message}" << nickname << std::endl;
+// Retourne l'identifiant du client portant ce pseudo (casse ignorée), ou -1
+ClientId Server::findClientByNick(const StrView& nickname) {
+	return shared->findNick(nickname);
 }
 
-void Server::setUser(int client_fd, const std::string& username, const std::string& realname) {
-	if (clientMap.find(client_fd) == clientMap.end()) {
-		// Si le client n'est pas enregistré, créer une nouvelle entrée
-		clientMap[client_fd] = Client(client_fd);
+bool Server::setNickname(int client_fd, const std::string& nickname) {
+	Client &client = *connections.find(client_fd);
+
+	const InternedName *claimed = shared->claimNick(nickname, idOf(client_fd));
+	if (claimed == NULL) {
+		reply(client, ERR_NICKNAMEINUSE, nickname);
+		return false;
 	}
 
+	// Assigner le pseudo et libérer l'ancien (sauf simple changement de casse :
+	// même entrée). Le NICK porte encore l'ancienne source.
+	if (client.nickEntry != NULL && client.nickEntry != claimed) {
+		shared->releaseNick(client.nickname, idOf(client_fd));
+	}
+	client.nickEntry = claimed;
+	ReplyLine line;
+	line << client.prefix << " NICK :" << nickname;
+	BufferRef nickLine = line.end().buffer();
+	client.nickname = nickname;
+	updatePrefix(client);
+	if (client.registered) {
+		queueReply(client_fd, nickLine);
+		std::set<ClientId> neighbors;
+		collectNeighbors(idOf(client_fd), client.profile->channels, neighbors);
+		notifyNeighbors(neighbors, nickLine);
+	}
+	// Les autres serveurs connaissent chaque pseudo réservé, enregistré ou non
+	if (linking) {
+		if (client.nickReceived)
+			propagate(nickLine);
+		else
+			propagate("NICK " + nickname + " " + serverName + "\r\n");
+	}
+	LOG_DEBUG(LOG_IRC, "Client set their nickname: " << nickname);
+	return true;
+}
+
+void Server::setUser(int client_fd, const std::string& username, const std::string& realname) {
+	Client *client = connections.find(client_fd);
+	if (client == NULL)
+		return;
+
 	// Assigner le nom d'utilisateur et le nom réel
-	clientMap[client_fd].username = username;
-	clientMap[client_fd].realname = realname;
-	clientMap[client_fd].registered = true; // Marquer comme enregistré
-	std::cout << "Client " << client_fd << " s'est enregistré comme utilisateur : " << username << " (" << realname << ")" << std::endl;
+	client->profile->username = username;
+	client->profile->realname = realname;
+	updatePrefix(*client);
+	LOG_INFO(LOG_IRC, "Client " << client_fd << " s'est enregistré comme utilisateur : " << username << " (" << realname << ")");
 }
 
 void Server::joinChannel(int client_fd, const std::string& channelName) {
-	// Si le canal n'existe pas, le créer
-	if (channelMap.find(channelName) == channelMap.end()) {
-		channelMap[channelName] = Channel(channelName);
-		channelMap[channelName].operators.insert(client_fd); // Le premier utilisateur est opérateur
-	}
+	ClientId self = idOf(client_fd);
+	ChannelLock lock(*shared, channelName);
+	Channel *existing = lock.find();
+
+	// Si le canal n'existe pas, le créer ; le premier utilisateur est opérateur
+	bool created = (existing == NULL);
+	if (created)
+		existing = &lock.create();
 
-	Channel& channel = channelMap[channelName];
+	Channel& channel = *existing;
 	
 	// Vérifier les conditions du canal (mode `+i`, limite d’utilisateurs, etc.)
-	if (channel.inviteOnly && channel.operators.find(client_fd) == channel.operators.end()) {
-		send(client_fd, ":server 473 :Cannot join channel (+i)\r\n", 39, 0); // Erreur d'accès au canal sur invitation seulement
+	Client &client = *connections.find(client_fd);
+	if (channel.inviteOnly && !channel.hasMode(self, MEMBER_OP)) {
+		reply(client, ERR_INVITEONLYCHAN, channelName); // Erreur d'accès au canal sur invitation seulement
 		return;
 	}
 
 	if (channel.userLimit > 0 && channel.clients.size() >= static_cast<size_t>(channel.userLimit)) {
-		send(client_fd, ":server 471 :Cannot join channel (+l)\r\n", 39, 0); // Erreur si le canal a atteint sa limite d'utilisateurs
+		reply(client, ERR_CHANNELISFULL, channelName); // Erreur si le canal a atteint sa limite d'utilisateurs
 		return;
 	}
 
 	// Ajouter le client au canal
-	channel.clients.insert(client_fd);
-	std::cout << "Client " << client_fd << " a rejoint le canal : " << channelName << std::endl;
+	channel.clients.insert(std::make_pair(self, created ? static_cast<unsigned char>(MEMBER_OP) : 0));
+	publishMembers(channel);
+	if (client.profile->channels.insert(lock.interned()).second)
+		lock.pin();
+	LOG_DEBUG(LOG_CHANNEL, "Client " << client_fd << " a rejoint le canal : " << channelName);
 
 	// Message de confirmation JOIN pour les autres membres du canal
-	std::string joinMsg = ":" + clientMap[client_fd].nickname + " JOIN :" + channelName + "\r\n";
-	for (std::set<int>::iterator it = channel.clients.begin(); it != channel.clients.end(); ++it) {
-	int member_fd = *it;
-	send(member_fd, joinMsg.c_str(), joinMsg.size(), 0);
-}
+	ReplyLine line;
+	line << client.prefix << " JOIN :" << channelName;
+	BufferRef joinMsg = line.end().buffer();
+	broadcast(channel, joinMsg);
+	if (linking)
+		propagate(joinMsg);
 }
 
-void Server::sendMessage(int client_fd, const std::string& recipient, const std::string& message) {
-	if (channelMap.find(recipient) != channelMap.end()) {
-		// Envoyer le message à tous les membres du canal
-		std::set<int>& members = channelMap[recipient].clients;
-		for (std::set<int>::iterator it = members.begin(); it != members.end(); ++it) {
-			int member_fd = *it;
-			if (member_fd != client_fd) { // Ne pas renvoyer le message à l'expéditeur
-				send(member_fd, message.c_str(), message.size(), 0);
-			}
+// Le destinataire est lu dans la ligne reçue, sans copie : un seul
+// hachage (réplique des membres ou table des pseudos) par message
+void Server::sendMessage(int client_fd, const StrView& recipient, const StrView& text) {
+	Client &client = *connections.find(client_fd);
+	if (isChannelName(recipient)) {
+		// Envoyer le message à tous les membres du canal, d'après la réplique
+		// locale des membres ; seul l'historique (--history) prend un verrou
+		// sur ce chemin
+		MemberList *members = channelMembers.find(recipient);
+		if (members == NULL || !(*members)->contains(idOf(client_fd))) {
+			reply(client, ERR_CANNOTSENDTOCHAN, recipient);
+			return;
 		}
-		std::cout << "Message envoyé au canal " << recipient << " par " << client_fd << std::endl;
+		// Ne pas renvoyer le message à l'expéditeur ; les autres serveurs ne
+		// le reçoivent que s'ils ont des membres dans le canal
+		// Le préfixe complet s'ajoute au texte reçu : ce qui dépasse 510
+		// octets est coupé sur une frontière de caractère UTF-8
+		ReplyLine line;
+		line << client.prefix << " PRIVMSG " << recipient << " :" << text;
+		if (line.truncated())
+			LOG_DEBUG(LOG_IRC, "Message de " << client_fd << " tronqué à " << line.size() << " octets");
+		BufferRef payload = line.end().buffer();
+		deliverToMembers(*members, payload, idOf(client_fd));
+		shared->history().record(recipient, payload);
+		if (linking && isRemote((*members)->members.back()))
+			linkOutput(payload, -1, *members, -1);
+		LOG_DEBUG(LOG_CHANNEL, "Message envoyé au canal " << recipient << " par " << client_fd);
 	} else {
 		// Vérifier si le destinataire est un utilisateur
-		for (std::map<int, Client>::iterator it = clientMap.begin(); it != clientMap.end(); ++it) {
-			int fd = it->first;
-			Client& client = it->second;
-			if (client.nickname == recipient) {
-				send(fd, message.c_str(), message.size(), 0);
-				std::cout << "Message privé envoyé à " << recipient << " par " << client_fd << std::endl;
-				return;
-			}
+		ClientId target = findClientByNick(recipient);
+		if (target != -1) {
+			ReplyLine line;
+			line << client.prefix << " PRIVMSG " << recipient << " :" << text;
+			if (line.truncated())
+				LOG_DEBUG(LOG_IRC, "Message de " << client_fd << " tronqué à " << line.size() << " octets");
+			sendTo(target, line.end().buffer());
+			LOG_DEBUG(LOG_IRC, "Message privé envoyé à " << recipient << " par " << client_fd);
+			return;
 		}
-		std::cerr << "Erreur: destinataire inconnu " << recipient << std::endl;
+		reply(client, ERR_NOSUCHNICK, recipient);
+		LOG_DEBUG(LOG_IRC, "destinataire inconnu " << recipient);
 	}
 }
 
 void Server::kickUser(int client_fd, const std::string& channelName, const std::string& user) {
-	if (channelMap.find(channelName) == channelMap.end()) {
-		std::cerr << "Erreur: Le canal " << channelName << " n'existe pas." << std::endl;
+	ChannelLock lock(*shared, channelName);
+	Channel *existing = lock.find();
+	if (existing == NULL) {
+		LOG_DEBUG(LOG_CHANNEL, "Le canal " << channelName << " n'existe pas.");
 		return;
 	}
 
-	Channel &channel = channelMap[channelName];
+	Channel &channel = *existing;
 
-	if (channel.operators.find(client_fd) == channel.operators.end()) {
-		std::cerr << "Erreur: Le client " << client_fd << " n'est pas opérateur du canal " << channelName << "." << std::endl;
+	if (!channel.hasMode(idOf(client_fd), MEMBER_OP)) {
+		LOG_DEBUG(LOG_CHANNEL, "Le client " << client_fd << " n'est pas opérateur du canal " << channelName << ".");
 		return;
 	}
 
-	int user_fd = -1;
-	for (std::map<int, Client>::iterator it = clientMap.begin(); it != clientMap.end(); ++it) {
-		if (it->second.nickname == user) {
-			user_fd = it->first;
-			break;
-		}
-	}
+	ClientId user_id = findClientByNick(user);
 
-	if (user_fd == -1 || channel.clients.find(user_fd) == channel.clients.end()) {
-		std::cerr << "Erreur: L'utilisateur " << user << " n'est pas dans le canal " << channelName << std::endl;
+	if (user_id == -1 || channel.clients.find(user_id) == channel.clients.end()) {
+		LOG_DEBUG(LOG_CHANNEL, "L'utilisateur " << user << " n'est pas dans le canal " << channelName);
 		return;
 	}
 
-	std::string notifyMsg = ":" + clientMap[client_fd].nickname + " KICK " + channelName + " " + user + " :Expulsé par l'opérateur\r\n";
-	for (std::set<int>::iterator it = channel.clients.begin(); it != channel.clients.end(); ++it) {
-		int member_fd = *it;
-		send(member_fd, notifyMsg.c_str(), notifyMsg.size(), 0);
-	}
-
-	channel.clients.erase(user_fd);
-	std::string kickMessage = "Vous avez été expulsé du canal " + channelName + ".\r\n";
-	send(user_fd, kickMessage.c_str(), kickMessage.size(), 0);
-
-	std::cout << "Utilisateur " << user << " expulsé du canal " << channelName << " par " << client_fd << std::endl;
+	ReplyLine line;
+	line << connections.find(client_fd)->prefix << " KICK " << channelName << ' ' << user << " :Expulsé par l'opérateur";
+	BufferRef notifyMsg = line.end().buffer();
+	broadcast(channel, notifyMsg);
+
+	// L'expulsé, encore membre, a reçu le KICK ; un utilisateur distant le
+	// reçoit de son serveur
+	channel.clients.erase(user_id);
+	publishMembers(channel);
+	dropMembership(user_id, lock);
+	if (linking)
+		propagate(notifyMsg);
+
+	LOG_INFO(LOG_CHANNEL, "Utilisateur " << user << " expulsé du canal " << channelName << " par " << client_fd);
+	if (channel.clients.empty())
+		lock.erase();
 }
 
 void Server::inviteUser(int client_fd, const std::string& channelName, const std::string& user) {
-	if (channelMap.find(channelName) == channelMap.end()) {
-		std::cerr << "Erreur : Le canal " << channelName << " n'existe pas." << std::endl;
+	ChannelLock lock(*shared, channelName);
+	Channel *existing = lock.find();
+	if (existing == NULL) {
+		LOG_DEBUG(LOG_CHANNEL, "Le canal " << channelName << " n'existe pas.");
 		return;
 	}
 
-	Channel &channel = channelMap[channelName];
+	Channel &channel = *existing;
 
-	if (channel.operators.find(client_fd) == channel.operators.end()) {
-		std::cerr << "Erreur : Le client " << client_fd << " n'est pas opérateur du canal " << channelName << "." << std::endl;
+	if (!channel.hasMode(idOf(client_fd), MEMBER_OP)) {
+		LOG_DEBUG(LOG_CHANNEL, "Le client " << client_fd << " n'est pas opérateur du canal " << channelName << ".");
 		return;
 	}
 
-	int user_fd = -1;
-	for (std::map<int, Client>::iterator it = clientMap.begin(); it != clientMap.end(); ++it) {
-		if (it->second.nickname == user) {
-			user_fd = it->first;
-			break;
-		}
-	}
+	ClientId user_id = findClientByNick(user);
 
-	if (user_fd == -1) {
-		std::cerr << "Erreur : L'utilisateur " << user << " n'est pas connecté." << std::endl;
+	if (user_id == -1 || isRemote(user_id)) {
+		LOG_DEBUG(LOG_CHANNEL, "L'utilisateur " << user << " n'est pas connecté à ce serveur.");
 		return;
 	}
 
-	std::string inviteMessage = "Vous avez été invité à rejoindre le canal " + channelName + ".\r\n";
-	send(user_fd, inviteMessage.c_str(), inviteMessage.size(), 0);
-	
-	std::string confirmMsg = ":server 341 " + clientMap[client_fd].nickname + " " + user + " " + channelName + " :Invitation envoyée\r\n";
-	send(client_fd, confirmMsg.c_str(), confirmMsg.size(), 0);
+	Client &client = *connections.find(client_fd);
+	ReplyLine line;
+	line << client.prefix << " INVITE " << user << " :" << channelName;
+	sendTo(user_id, line.end().buffer());
 
-	std::cout << "Utilisateur " << user << " invité à rejoindre le canal " << channelName << " par " << client_fd << std::endl;
+	reply(client, RPL_INVITING, user, channelName);
+
+	LOG_INFO(LOG_CHANNEL, "Utilisateur " << user << " invité à rejoindre le canal " << channelName << " par " << client_fd);
 }
 
 void Server::partChannel(int client_fd, const std::string& channelName) {
-	if (channelMap.find(channelName) == channelMap.end()) {
-		std::cerr << "Erreur : Le canal " << channelName << " n'existe pas." << std::endl;
+	ChannelLock lock(*shared, channelName);
+	Channel *existing = lock.find();
+	if (existing == NULL) {
+		LOG_DEBUG(LOG_CHANNEL, "Le canal " << channelName << " n'existe pas.");
 		return;
 	}
 
-	Channel& channel = channelMap[channelName];
-	if (channel.clients.find(client_fd) == channel.clients.end()) {
-		std::cerr << "Erreur : Le client n'est pas dans le canal " << channelName << std::endl;
+	Channel& channel = *existing;
+	ClientId self = idOf(client_fd);
+	if (channel.clients.find(self) == channel.clients.end()) {
+		LOG_DEBUG(LOG_CHANNEL, "Le client n'est pas dans le canal " << channelName);
 		return;
 	}
 
 	// Envoyer le message PART à tous les membres du canal
-	std::string partMsg = ":" + clientMap[client_fd].nickname + " PART :" + channelName + "\r\n";
-	for (std::set<int>::iterator it = channel.clients.begin(); it != channel.clients.end(); ++it) {
-	int member_fd = *it;
-	send(member_fd, partMsg.c_str(), partMsg.size(), 0);
-}
+	ReplyLine line;
+	line << connections.find(client_fd)->prefix << " PART :" << channelName;
+	BufferRef partMsg = line.end().buffer();
+	broadcast(channel, partMsg);
+	if (linking)
+		propagate(partMsg);
 
 	// Retirer le client du canal
-	channel.clients.erase(client_fd);
-	std::cout << "Client " << client_fd << " a quitté le canal : " << channelName << std::endl;
+	channel.clients.erase(self);
+	publishMembers(channel);
+	if (connections.find(client_fd)->profile->channels.erase(lock.interned()))
+		lock.unpin();
+	LOG_DEBUG(LOG_CHANNEL, "Client " << client_fd << " a quitté le canal : " << channelName);
 
 	// Supprimer le canal si vide
 	if (channel.clients.empty()) {
-		channelMap.erase(channelName);
+		lock.erase();
 	}
 }
 
 void Server::setChannelMode(int client_fd, const std::string& channelName, const std::string& mode, const std::string& parameter) {
-	if (channelMap.find(channelName) == channelMap.end()) {
-		std::cerr << "Erreur : Le canal " << channelName << " n'existe pas." << std::endl;
+	ChannelLock lock(*shared, channelName);
+	Channel *existing = lock.find();
+	if (existing == NULL) {
+		LOG_DEBUG(LOG_CHANNEL, "Le canal " << channelName << " n'existe pas.");
 		return;
 	}
 
-	Channel &channel = channelMap[channelName];
+	Channel &channel = *existing;
 
-	if (channel.operators.find(client_fd) == channel.operators.end()) {
-		std::cerr << "Erreur : Le client " << client_fd << " n'est pas opérateur du canal " << channelName << "." << std::endl;
+	if (!channel.hasMode(idOf(client_fd), MEMBER_OP)) {
+		LOG_DEBUG(LOG_CHANNEL, "Le client " << client_fd << " n'est pas opérateur du canal " << channelName << ".");
 		return;
 	}
 
+	if (!applyChannelMode(channel, mode, parameter)) {
+		LOG_DEBUG(LOG_CHANNEL, "Mode inconnu ou paramètre manquant pour le mode " << mode);
+		return;
+	}
+	ReplyLine line;
+	line << connections.find(client_fd)->prefix << " MODE " << channelName << ' ' << mode;
+	if (!parameter.empty())
+		line << ' ' << parameter;
+	BufferRef modeMsg = line.end().buffer();
+	broadcast(channel, modeMsg);
+	if (linking)
+		propagate(modeMsg);
+}
+
+// Applique un mode de canal (+/-i, t, k, l, o, v) ; false si inconnu ou incomplet
+bool Server::applyChannelMode(Channel &channel, const std::string &mode, const std::string &parameter) {
+	const std::string &channelName = channel.name;
 	if (mode == "+i") {
 		channel.inviteOnly = true;
-		std::cout << "Le mode +i (invitation seulement) est activé pour le canal " << channelName << std::endl;
+		LOG_INFO(LOG_CHANNEL, "Le mode +i (invitation seulement) est activé pour le canal " << channelName);
 	} else if (mode == "-i") {
 		channel.inviteOnly = false;
-		std::cout << "Le mode -i (invitation seulement) est désactivé pour le canal " << channelName << std::endl;
+		LOG_INFO(LOG_CHANNEL, "Le mode -i (invitation seulement) est désactivé pour le canal " << channelName);
 	} else if (mode == "+t") {
 		channel.topicRestricted = true;
-		std::cout << "Le mode +t (sujet restreint) est activé pour le canal " << channelName << std::endl;
+		LOG_INFO(LOG_CHANNEL, "Le mode +t (sujet restreint) est activé pour le canal " << channelName);
 	} else if (mode == "-t") {
 		channel.topicRestricted = false;
-		std::cout << "Le mode -t (sujet restreint) est désactivé pour le canal " << channelName << std::endl;
+		LOG_INFO(LOG_CHANNEL, "Le mode -t (sujet restreint) est désactivé pour le canal " << channelName);
 	} else if (mode == "+k" && !parameter.empty()) {
 		channel.password = parameter;
-		std::cout << "Le mot de passe pour le canal " << channelName << " est défini." << std::endl;
+		LOG_INFO(LOG_CHANNEL, "Le mot de passe pour le canal " << channelName << " est défini.");
 	} else if (mode == "-k") {
 		channel.password.clear();
-		std::cout << "Le mot de passe pour le canal " << channelName << " est supprimé." << std::endl;
+		LOG_INFO(LOG_CHANNEL, "Le mot de passe pour le canal " << channelName << " est supprimé.");
 	} else if (mode == "+l" && !parameter.empty()) {
-		channel.userLimit = std::stoi(parameter);
-		std::cout << "Limite d'utilisateurs pour le canal " << channelName << " est définie à " << channel.userLimit << std::endl;
+		channel.userLimit = std::atoi(parameter.c_str());
+		LOG_INFO(LOG_CHANNEL, "Limite d'utilisateurs pour le canal " << channelName << " est définie à " << channel.userLimit);
 	} else if (mode == "-l") {
 		channel.userLimit = -1;
-		std::cout << "Limite d'utilisateurs pour le canal " << channelName << " est supprimée." << std::endl;
+		LOG_INFO(LOG_CHANNEL, "Limite d'utilisateurs pour le canal " << channelName << " est supprimée.");
+	} else if ((mode == "+o" || mode == "-o" || mode == "+v" || mode == "-v") && !parameter.empty()) {
+		MemberModes::iterator member = channel.clients.find(findClientByNick(parameter));
+		if (member == channel.clients.end())
+			return false;
+		unsigned char bit = (mode[1] == 'o') ? MEMBER_OP : MEMBER_VOICE;
+		if (mode[0] == '+')
+			member->second |= bit;
+		else
+			member->second &= static_cast<unsigned char>(~bit);
+		LOG_INFO(LOG_CHANNEL, "Mode " << mode << " pour " << parameter << " dans le canal " << channelName);
 	} else {
-		std::cerr << "Mode inconnu ou paramètre manquant pour le mode " << mode << std::endl;
+		return false;
 	}
+	return true;
 }
 
 void Server::topicChannel(int client_fd, const std::string& channelName, const std::string& topic) {
 	// Vérification de l'existence du canal
-	if (channelMap.find(channelName) == channelMap.end()) {
-		std::cerr << "Erreur : Le canal " << channelName << " n'existe pas." << std::endl;
+	ChannelLock lock(*shared, channelName);
+	Channel *existing = lock.find();
+	if (existing == NULL) {
+		LOG_DEBUG(LOG_CHANNEL, "Le canal " << channelName << " n'existe pas.");
 		return;
 	}
 
-	Channel &channel = channelMap[channelName];
+	Channel &channel = *existing;
 
 	// Vérification des permissions si le mode +t est activé
-	if (channel.topicRestricted && channel.operators.find(client_fd) == channel.operators.end()) {
-		std::cerr << "Erreur : Seuls les opérateurs peuvent modifier le sujet dans le canal " << channelName << " lorsque le mode +t est activé." << std::endl;
+	if (channel.topicRestricted && !channel.hasMode(idOf(client_fd), MEMBER_OP)) {
+		LOG_DEBUG(LOG_CHANNEL, "Seuls les opérateurs peuvent modifier le sujet dans le canal " << channelName << " lorsque le mode +t est activé.");
 		return;
 	}
 
 	// Définir ou afficher le sujet du canal
 	if (topic.empty()) {
-		std::string topicMsg = "Sujet actuel pour le canal " + channelName + " : " + channel.topic + "\r\n";
-		send(client_fd, topicMsg.c_str(), topicMsg.size(), 0);
+		Client &client = *connections.find(client_fd);
+		if (channel.topic.empty())
+			reply(client, RPL_NOTOPIC, channel.name);
+		else
+			reply(client, RPL_TOPIC, channel.name, channel.topic);
 	} else {
 		// Mettre à jour le sujet
 		channel.topic = topic;
-		std::string topicUpdateMsg = ":" + clientMap[client_fd].nickname + " TOPIC " + channelName + " :" + topic + "\r\n";
-		
+		ReplyLine line;
+		line << connections.find(client_fd)->prefix << " TOPIC " << channelName << " :" << topic;
+		BufferRef topicUpdateMsg = line.end().buffer();
+
 		// Notifier tous les membres du canal du nouveau sujet
-		for (std::set<int>::iterator it = channel.clients.begin(); it != channel.clients.end(); ++it) {
-			int member_fd = *it;
-			send(member_fd, topicUpdateMsg.c_str(), topicUpdateMsg.size(), 0);
-		}
+		broadcast(channel, topicUpdateMsg);
+		if (linking)
+			propagate(topicUpdateMsg);
 
-		std::cout << "Sujet du canal " << channelName << " mis à jour par le client " << client_fd << std::endl;
+		LOG_INFO(LOG_CHANNEL, "Sujet du canal " << channelName << " mis à jour par le client " << client_fd);
 	}
 }
 
@@ -634,36 +1288,68 @@ std::string Server::getServerCreationDate() {
 
 
 void Server::sendWelcomeMessages(Client &client, int client_fd) {
-	std::string nick = client.nickname;
-	std::string user = client.username;
-	std::string host = "localhost"; // Remplacez par le nom de votre serveur ou l'IP
+	LOG_DEBUG(LOG_IRC, "Send welcome message to: " << client.nickname << " fd: " << client_fd);
+	// Source sans le ':' initial : pseudo!utilisateur@hôte
+	reply(client, RPL_WELCOME, StrView(client.prefix.data() + 1, client.prefix.size() - 1));
+	if (shared->history().enabled()) {
+		ReplyLine replay;
+		replay << static_cast<uint64_t>(ChannelHistory::MAX_REPLAY);
+		reply(client, RPL_ISUPPORT, StrView(replay.data(), replay.size()));
+	}
+}
 
-	std::cout << "[DEBUG] Send welcome message to: " << nick << " fd: " << client_fd << std::endl;
-	std::string msg001 = "001 " + nick + " :Welcome to ircserv \r\n";
+// Une seule minuterie par client : PING après pingInterval sans trafic,
+// puis déconnexion si rien n'est reçu dans les pingTimeout qui suivent.
+// Le trafic entrant ne touche pas la roue : il met seulement lastActivity à
+// jour, et la minuterie se reprogramme d'elle-même quand elle expire.
+void Server::onClientTimer(int client_fd) {
+	Client *found = connections.find(client_fd);
+	if (found == NULL || found->closing)
+		return;
+	Client &client = *found;
+	uint64_t now = TimerWheel::nowMs();
+	uint64_t interval = config.pingInterval * 1000;
+
+	if (now - client.lastActivity < interval) {
+		timers.schedule(client.timer, client.lastActivity + interval);
+	} else if (!client.pingSent) {
+		queueReply(client_fd, "PING :" + serverName + "\r\n");
+		client.pingSent = true;
+		timers.schedule(client.timer, now + config.pingTimeout * 1000);
+	} else {
+		LOG_INFO(LOG_NET, "Client " << client_fd << " déconnecté pour inactivité.");
+		metricAdd(metrics->pingTimeouts);
+		disconnectClient(client, "Ping timeout");
+	}
+}
 
-	send(client_fd, msg001.c_str(), msg001.size(), 0);
+// Jauges de mémoire du shard, pour STATS z et l'export. Les chaînes et
+// canaux de chaque client n'y sont pas : seul STATS l les compte, pour
+// la connexion du demandeur.
+void Server::publishMemory() {
+	BufferPool &buffers = connections.buffers();
+	metricSet(metrics->connectionMemory, connections.size() * ClientTable::baseMemory() + buffers.borrowedBytes());
+	metricSet(metrics->bufferBytes, buffers.borrowedBytes());
+	metricSet(metrics->bufferSpare, buffers.spareBytes());
 }
 
-void Server::sendPingToClients() {
-	std::string pingMessage = "PING :server\r\n";
-	for (std::map<int, Client>::iterator it = clientMap.begin(); it != clientMap.end(); ++it) {
-		int client_fd = it->first;
-		send(client_fd, pingMessage.c_str(), pingMessage.size(), 0);
-	}
+// Le crédit du limiteur permet de nouveau une ligne : reprendre celles
+// qui attendent dans recvbuf (sans compter comme du trafic reçu)
+void Server::onInputTimer(int client_fd) {
+	Client *client = connections.find(client_fd);
+	if (client == NULL || client->closing || client->runQueued)
+		return;
+	serveClient(*client);
 }
 
-void Server::disconnectInactiveClients() {
-	time_t currentTime = time(NULL);
-	for (std::map<int, Client>::iterator it = clientMap.begin(); it != clientMap.end(); ) {
-		if (currentTime - it->second.lastPing > 120) { // 120 secondes de délai
-			int client_fd = it->first;
-			close(client_fd);
-			it = clientMap.erase(it);
-			std::cout << "Client " << client_fd << " déconnecté pour inactivité." << std::endl;
-		} else {
-			++it;
-		}
-	}
+// Envoie ERROR puis ferme la connexion après le prochain envoi ; ERROR
+// passe même si la file d'envoi est à sa limite
+void Server::disconnectClient(Client &client, const std::string &reason) {
+	if (client.closing)
+		return;
+	replyTarget(client.fd);
+	client.sendq.appendFinal("ERROR :Closing Link: " + (client.nickname.empty() ? "*" : client.nickname) + " (" + reason + ")\r\n");
+	client.closing = true;
 }
 
 int Server::get_port(char *ag)
@@ -704,3 +1390,34 @@ void Server::check_signal(int signal)
 	_exit(0);
 
 }
+
+static volatile sig_atomic_t stopSignal = 0;
+static Mailbox* stopMailbox = NULL;
+
+// Gestionnaire de SIGINT : seulement des opérations sûres (drapeau, write)
+void Server::onStopSignal(int signal) {
+	(void) signal;
+	stopSignal = 1;
+	if (stopMailbox)
+		stopMailbox->wake();
+}
+
+void Server::installStop() {
+	struct sigaction action;
+	std::memset(&action, 0, sizeof(action));
+	action.sa_handler = onStopSignal;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	sigaction(SIGINT, &action, NULL);
+}
+
+// Un signal reçu avant que la boîte aux lettres existe n'a réveillé personne
+void Server::setStopWake(Mailbox &wake) {
+	stopMailbox = &wake;
+	if (stopSignal)
+		wake.wake();
+}
+
+bool Server::stopRequested() {
+	return stopSignal != 0;
+}
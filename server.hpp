@@ -12,6 +12,21 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <signal.h>
+#include "poller.hpp"
+#include "config.hpp"
+#include "sendqueue.hpp"
+#include "linebuffer.hpp"
+#include "message.hpp"
+#include "ircmap.hpp"
+#include "channel.hpp"
+#include "sharedstate.hpp"
+#include "timerwheel.hpp"
+#include "clienttable.hpp"
+#include "link.hpp"
+#include "log.hpp"
+#include "upgrade.hpp"
+#include "replies.hpp"
+#include "trace.hpp"
 
 //colors
 #define RED "\033[0;31m"
@@ -20,38 +35,8 @@
 #define YELLOW "\033[0;33m"
 #include <arpa/inet.h>
 
-// Définir les structures Client et Channel
-struct Client {
-	int fd;
-	bool is_authenticated;
-	std::string nickname;
-	time_t lastPing;
-	std::string username;
-	std::string realname;
-	bool registered;    // Indique si le client est entièrement authentifié
-	bool passReceived;  // Pour vérifier si le mot de passe a été reçu
-	bool nickReceived;  // Pour vérifier si le pseudo (NICK) a été reçu
-	bool userReceived;  // Pour vérifier si le nom d'utilisateur (USER) a été reçu
-
-	Client() : fd(-42), is_authenticated(false), registered(false), passReceived(false), nickReceived(false), userReceived(false){}
-	Client(int fd) : fd(fd), is_authenticated(false), registered(false), passReceived(false), nickReceived(false), userReceived(false) {}
-};
-
-struct Channel {
-	std::string name;
-	std::set<int> clients;
-	std::set<int> operators;
-	bool inviteOnly;         // Mode `i` : invitation seulement
-	bool topicRestricted;    // Mode `t` : sujet restreint aux opérateurs
-	std::string password;    // Mode `k` : mot de passe du canal
-	int userLimit;           // Mode `l` : limite d’utilisateurs
-	std::string topic;       // Sujet du canal
-
-	Channel() : inviteOnly(false), topicRestricted(false), userLimit(-1) {}
-	Channel(const std::string& name) : name(name), inviteOnly(false), topicRestricted(false), userLimit(-1) {}
-};
-
 class Server {
+	friend class MicroBench; // Mesures des chemins internes (microbench.cpp)
 private:
 	int server_fd; // Descripteur de fichier pour le serveur
 	int port; // Port sur lequel le serveur écoute
@@ -59,39 +44,176 @@ private:
 	std::vector<int> clients; // Liste des descripteurs de fichiers clients
 	void catch_signal();
 	static bool _signal;
+	static void onStopSignal(int signal);
+	static bool stopRequested();
 
 	std::string serverPassword; // Mot de passe du serveur
-	std::map<int, Client> clientMap; // Associe les FDs aux instances Client
-	std::map<std::string, Channel> channelMap; // Associe les noms de canaux aux instances Channel
+	ClientTable connections; // Clients de ce shard, indexés par fd
 	std::string serverName;
+	std::string serverPrefix; // ":" + serverName, source des réponses du serveur
+	SharedState *shared; // Pseudos, canaux et boîtes aux lettres communs aux shards
+	size_t shardId;
+	ShardMetrics *metrics; // Compteurs de ce shard (écrits par lui seul)
+	size_t nextShard; // Répartition des connexions quand SO_REUSEPORT est indisponible
+	IrcMap<MemberList> channelMembers; // Réplique locale des membres (casse ignorée), pour PRIVMSG
+	std::vector<ShardMessage*> outboxNewest; // Messages à poster par shard en fin de tour
+	std::vector<ShardMessage*> outboxOldest;
+	Poller *poller; // Backend de multiplexage (epoll ou select)
+	ServerConfig config;
+	TimerWheel timers; // Échéances PING et inactivité des clients de ce shard
+	std::vector<int> pendingFlush; // Clients ayant des réponses à envoyer ce tour-ci
+	// Équité des lectures : budget d'un client par passage (serveClient) ;
+	// au-delà il attend dans runQueue, reprise à tour de rôle à chaque tour
+	static const size_t READ_BUDGET = 64 * 1024;   // Octets lus
+	static const unsigned COMMAND_BUDGET = 64;     // Lignes traitées
+	std::vector<int> runQueue;
+	uint64_t traceId; // Ligne en cours suivie par Tracer (trace.hpp), 0 sinon
+	uint64_t readStarted; // Dernière lecture, si le suivi est actif : début, fin
+	uint64_t readDone;    // (0 : ligne reprise hors lecture) et octets lus
+	size_t readBytes;
+
+	// Liaison entre serveurs (link.cpp) : liens et utilisateurs distants
+	// n'existent que dans le shard 0
+	bool linking; // --link-port ou --connect : les changements d'état sont propagés
+	int linkListenFd;
+	std::vector<ServerLink> links; // MAX_LINKS cases, jamais réallouées
+	std::map<ClientId, RemoteUser> remoteUsers;
+	LinkConnector *connector;
 
 	void setNonBlocking(int fd);
-	void removeClient(int client_fd);
+	int openListener(int port, bool shareable);
+	void acceptedClient(int fd);
+	Client *adoptClient(int fd);
+	bool processInput(Client &client, size_t bytes, unsigned &budget);
+	bool processLines(Client &client, unsigned &budget);
+	void serveClient(Client &client);
+	void scheduleRun(Client &client);
+	void serveRunQueue();
+	void receiveClient(int client_fd, const char *data, int len);
+	void sendCompleted(int client_fd, int result);
+	ClientId idOf(int client_fd) const;
+	Client *localClient(ClientId id) const;
+	void sendTo(ClientId id, const std::string& message);
+	void sendTo(ClientId id, const BufferRef& message);
+	void postTo(size_t shard, ShardMessage *msg);
+	void flushOutbox();
+	void processMailbox();
+	void deliverToMembers(const MemberList &members, const BufferRef &message, ClientId except = -1);
+	void deliverLocal(const MemberList &members, const BufferRef &message, ClientId except);
+	void publishMembers(Channel &channel);
+	void installMembers(const std::string &channelName, const MemberList &members);
+	void removeClient(int client_fd, const std::string &reason = "Client Quit");
+	void leaveChannels(ClientId id, ChannelSet &channels, std::set<ClientId> &neighbors);
+	void dropMembership(ClientId id, ChannelLock &lock);
+	void forgetChannel(ClientId id, const std::string &channelName);
+	void collectNeighbors(ClientId id, const ChannelSet &channels, std::set<ClientId> &neighbors);
+	void notifyNeighbors(const std::set<ClientId> &neighbors, const BufferRef &line);
+	Client *replyTarget(int client_fd);
+	void sendQueueFull(Client &client);
+	void queueReply(int client_fd, const std::string& message);
+	void queueReply(int client_fd, const BufferRef& message);
+	void queueReply(int client_fd, const ReplyLine& line);
+	void reply(Client &client, Numeric numeric, const StrView &a1 = StrView(), const StrView &a2 = StrView(),
+		const StrView &a3 = StrView(), const StrView &a4 = StrView());
+	void fail(Client &client, const char *command, const char *code, const char *description,
+		const StrView &context = StrView(), const StrView &context2 = StrView());
+	void updatePrefix(Client &client);
+	void broadcast(const Channel &channel, const std::string &message, ClientId except = -1);
+	void broadcast(const Channel &channel, const BufferRef &message, ClientId except = -1);
+	void flushClient(Client &client);
+	void flushPendingClients();
 	bool checkPassword(int client_fd, const std::string& password);
-	void processCommand(int client_fd, const std::string& message);
-	void setNickname(int client_fd, const std::string& nickname);
+	void processCommand(int client_fd, const StrView& line);
+	bool setNickname(int client_fd, const std::string& nickname);
+	ClientId findClientByNick(const StrView& nickname);
 	void setUser(int client_fd, const std::string& username, const std::string& realname);
 	void joinChannel(int client_fd, const std::string& channel);
 	void partChannel(int client_fd, const std::string& channelName);
-	void sendMessage(int client_fd, const std::string& recipient, const std::string& message);
+	void sendMessage(int client_fd, const StrView& recipient, const StrView& text);
 	void kickUser(int client_fd, const std::string& channelName, const std::string& user);
 	void inviteUser(int client_fd, const std::string& channelName, const std::string& user);
 	void setChannelMode(int client_fd, const std::string& channelName, const std::string& mode, const std::string& parameter = "");
 	void topicChannel(int client_fd, const std::string& channelName, const std::string& topic);
 	void sendWelcomeMessages(Client &client, int client_fd);
 	std::string getServerCreationDate();
-	void sendPingToClients();
-	void disconnectInactiveClients();
+	void onClientTimer(int client_fd);
+	void onInputTimer(int client_fd);
+	void publishMemory();
+	void disconnectClient(Client &client, const std::string &reason);
+	void disconnectAnywhere(ClientId id, const std::string &reason);
+	bool applyChannelMode(Channel &channel, const std::string &mode, const std::string &parameter);
 	bool CAP_LS;
 
+	void acceptLinks();
+	void acceptedLink(int fd);
+	void openLink(int fd, int peer);
+	void closeLink(ServerLink &link);
+	void processLinkMessage(ServerLink &link, const StrView &line, const IrcMessage &msg);
+	void linkHandshake(ServerLink &link, const IrcMessage &msg);
+	void sendBurst(ServerLink &link);
+	void propagate(const std::string &line);
+	void propagate(const BufferRef &line);
+	void linkOutput(const BufferRef &line, ClientId target, const MemberList &members, int exceptLink);
+	void forwardLine(const StrView &line, const ServerLink &from);
+	ClientId remoteSender(const ServerLink &link, const IrcMessage &msg);
+	void introduceRemote(ServerLink &link, const std::string &nick, const std::string &server);
+	void renameRemote(ClientId id, const std::string &nick);
+	void removeRemoteUser(ClientId id, const std::string &quitLine);
+	void remoteJoin(ClientId id, const std::string &channelName, bool burst, unsigned char modes);
+	void remoteLeave(ClientId id, const std::string &channelName, const std::string &line);
+	bool knownServer(const std::string &name) const;
+
+	// Redémarrage à chaud (upgrade.cpp)
+	bool freezeRequested; // SIGUSR2 (shard 0) ou ShardMessage::UPGRADE : geler en fin de tour
+	bool upgrading;       // Gel en cours : plus de nouveaux liens
+	void freeze();
+	void saveState(UpgradeWriter &out);
+	void saveChannels(UpgradeWriter &out);
+	void restoreChannels(UpgradeReader &in);
+
+	// Table de dispatch des commandes (voir commands.cpp)
+	struct CommandSpec {
+		const char *name;
+		void (Server::*handler)(Client &client, const IrcMessage &msg);
+		bool needsRegistration;   // Refusée (451) tant que le client n'est pas enregistré
+		size_t minParams;         // En dessous : 461 ERR_NEEDMOREPARAMS
+	};
+	static const CommandSpec commandTable[];
+	static const size_t commandCount;
+	static const CommandSpec *findCommand(const StrView &name);
+	void tryRegister(Client &client);
+	void cmdCap(Client &client, const IrcMessage &msg);
+	void cmdPass(Client &client, const IrcMessage &msg);
+	void cmdNick(Client &client, const IrcMessage &msg);
+	void cmdUser(Client &client, const IrcMessage &msg);
+	void cmdPing(Client &client, const IrcMessage &msg);
+	void cmdPong(Client &client, const IrcMessage &msg);
+	void cmdQuit(Client &client, const IrcMessage &msg);
+	void cmdJoin(Client &client, const IrcMessage &msg);
+	void cmdPart(Client &client, const IrcMessage &msg);
+	void cmdKick(Client &client, const IrcMessage &msg);
+	void cmdInvite(Client &client, const IrcMessage &msg);
+	void cmdMode(Client &client, const IrcMessage &msg);
+	void cmdTopic(Client &client, const IrcMessage &msg);
+	void cmdPrivmsg(Client &client, const IrcMessage &msg);
+	void cmdStats(Client &client, const IrcMessage &msg);
+	void cmdChathistory(Client &client, const IrcMessage &msg);
+	void replayHistory(Client &client, const std::string &target, const std::vector<HistoryEntry> &entries);
+	uint64_t nextBatch; // Identifiants BATCH de ce shard
+
 public:
-	Server(int port, const std::string &password, const std::string &name = "myircserver");
+	Server(int port, const std::string &password, const ServerConfig &config, SharedState &shared, size_t shardId = 0, const std::string &name = "myircserver");
 	~Server();
 	void start(); // Méthode pour démarrer le serveur
-	void acceptClients(); // Accepter les connexions clients
+	bool restoreState(UpgradeReader &in); // Nouveau processus, avant start()
+	void acceptClients(); // Accepter les connexions clients (jusqu'à EAGAIN)
 	void handleClient(int client_fd); // Gérer la communication avec un client
 	// void handleConnection(int clientSocket);
 	static void check_signal(int signal);
+	// SIGINT : le gestionnaire ne fait que lever un drapeau et réveiller le
+	// shard 0 par sa boîte aux lettres ; start() rend alors la main à main()
+	static void installStop();
+	static void setStopWake(Mailbox &wake);
 	static int get_port(char *ag); // Récupérer le port à partir des arguments
 	bool                        getCapStatus();
     void                        setCapStatus(bool value);
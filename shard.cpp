@@ -0,0 +1,124 @@
+#include "shard.hpp"
+#include "log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <stdint.h>
+#include <unistd.h>
+#ifdef __linux__
+# include <sys/eventfd.h>
+#endif
+
+MemberSnapshot::MemberSnapshot(const std::set<ClientId>& clients, unsigned long version)
+	: refs(0), version(version), members(clients.begin(), clients.end()) {}
+
+MemberSnapshot::MemberSnapshot(const MemberModes& clients, unsigned long version)
+	: refs(0), version(version) {
+	members.reserve(clients.size());
+	for (MemberModes::const_iterator it = clients.begin(); it != clients.end(); ++it)
+		members.push_back(it->first);
+}
+
+bool MemberSnapshot::contains(ClientId id) const {
+	return std::binary_search(members.begin(), members.end(), id);
+}
+
+bool MemberSnapshot::hasShard(size_t shard) const {
+	size_t begin, end;
+	shardRange(shard, begin, end);
+	return begin != end;
+}
+
+void MemberSnapshot::shardRange(size_t shard, size_t& begin, size_t& end) const {
+	std::vector<ClientId>::const_iterator first =
+		std::lower_bound(members.begin(), members.end(), makeClientId(shard, 0, 0));
+	std::vector<ClientId>::const_iterator last =
+		std::lower_bound(first, members.end(), makeClientId(shard + 1, 0, 0));
+	begin = static_cast<size_t>(first - members.begin());
+	end = static_cast<size_t>(last - members.begin());
+}
+
+/* ************************************************************************** */
+
+#ifndef __linux__
+static void setNonBlockingCloexec(int fd) {
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+#endif
+
+Mailbox::Mailbox() : head(NULL), signaled(0), readFd(-1), writeFd(-1) {
+#ifdef __linux__
+	readFd = writeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+	int fds[2];
+	if (pipe(fds) == 0) {
+		readFd = fds[0];
+		writeFd = fds[1];
+		setNonBlockingCloexec(readFd);
+		setNonBlockingCloexec(writeFd);
+	}
+#endif
+	if (readFd < 0) {
+		LOG_ERROR(LOG_SERVER, "impossible de créer la boîte aux lettres du shard");
+		exit(EXIT_FAILURE);
+	}
+}
+
+Mailbox::~Mailbox() {
+	ShardMessage* msg = takeAll();
+	while (msg) {
+		ShardMessage* next = msg->next;
+		delete msg;
+		msg = next;
+	}
+	close(readFd);
+	if (writeFd != readFd)
+		close(writeFd);
+}
+
+int Mailbox::fd() const {
+	return readFd;
+}
+
+void Mailbox::post(ShardMessage* newest, ShardMessage* oldest) {
+	ShardMessage* old;
+	do {
+		old = head;
+		oldest->next = old;
+	} while (!__sync_bool_compare_and_swap(&head, old, newest));
+
+	// Un seul réveil tant que le consommateur n'a pas vidé la file
+	if (__sync_lock_test_and_set(&signaled, 1) == 0) {
+		uint64_t one = 1;
+		ssize_t ret = write(writeFd, &one, sizeof(one));
+		(void) ret;
+	}
+}
+
+void Mailbox::wake() {
+	uint64_t one = 1;
+	ssize_t ret = write(writeFd, &one, sizeof(one));
+	(void) ret;
+}
+
+ShardMessage* Mailbox::takeAll() {
+	uint64_t value;
+	while (read(readFd, &value, sizeof(value)) > 0)
+		;
+	// Réarmer le signal avant de vider : un envoi concurrent réveillera à nouveau
+	__sync_lock_release(&signaled);
+	ShardMessage* stack = __sync_lock_test_and_set(&head, static_cast<ShardMessage*>(NULL));
+
+	// La pile est en ordre inverse d'envoi
+	ShardMessage* ordered = NULL;
+	while (stack) {
+		ShardMessage* next = stack->next;
+		stack->next = ordered;
+		ordered = stack;
+		stack = next;
+	}
+	return ordered;
+}
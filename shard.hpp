@@ -0,0 +1,128 @@
+#ifndef SHARD_HPP
+#define SHARD_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "sharedbuffer.hpp"
+#include "sharedref.hpp"
+
+/*
+ * Modèle de propriété en mode multi-thread (--threads=N) :
+ *  - chaque shard (un Server, une boucle d'événements, un thread) possède
+ *    seul ses connexions : sockets, Client, tampons d'entrée et de sortie ;
+ *  - pseudos et canaux vivent dans SharedState, découpés en segments
+ *    verrouillés séparément, et ne sont touchés que par les commandes qui
+ *    les modifient (NICK, JOIN, PART, KICK, MODE, TOPIC...) ;
+ *  - la livraison vers les clients d'un autre shard passe toujours par la
+ *    boîte aux lettres (Mailbox) de ce shard, jamais par un accès direct.
+ */
+
+// Identifiant global d'un client : numéro de shard dans les bits de poids
+// fort (les ClientId triés sont donc groupés par shard), génération de la
+// connexion au milieu, fd local dans les 24 bits de poids faible. Un
+// identifiant conservé après la déconnexion ne peut pas désigner le client
+// suivant sur le même fd. -1 : aucun client.
+typedef int64_t ClientId;
+
+static const int CLIENT_FD_BITS = 24;
+static const int CLIENT_SHARD_SHIFT = 56;
+static const size_t MAX_SHARDS = 64;
+
+inline ClientId makeClientId(size_t shard, uint32_t generation, int fd) {
+	return static_cast<ClientId>((static_cast<uint64_t>(shard) << CLIENT_SHARD_SHIFT)
+		| (static_cast<uint64_t>(generation) << CLIENT_FD_BITS) | static_cast<uint64_t>(fd));
+}
+inline size_t clientShard(ClientId id) {
+	return static_cast<size_t>(static_cast<uint64_t>(id) >> CLIENT_SHARD_SHIFT);
+}
+inline uint32_t clientGeneration(ClientId id) {
+	return static_cast<uint32_t>(static_cast<uint64_t>(id) >> CLIENT_FD_BITS);
+}
+inline int clientFd(ClientId id) {
+	return static_cast<int>(id & ((1 << CLIENT_FD_BITS) - 1));
+}
+
+// Modes d'un membre de canal : un octet par appartenance, dans la table des
+// membres elle-même (Channel::clients)
+enum MemberMode {
+	MEMBER_OP = 1,      // +o
+	MEMBER_VOICE = 2    // +v
+};
+typedef std::map<ClientId, unsigned char> MemberModes;
+
+// Liste immuable des membres d'un canal, triée par ClientId (donc groupée
+// par shard). Elle est republiée à chaque changement de membres, ce qui
+// permet aux PRIVMSG de diffuser sans prendre de verrou.
+struct MemberSnapshot {
+	int refs;
+	unsigned long version;         // Croissant globalement (SharedState::nextVersion)
+	std::vector<ClientId> members;
+
+	MemberSnapshot(const std::set<ClientId>& clients, unsigned long version);
+	MemberSnapshot(const MemberModes& clients, unsigned long version);
+
+	bool contains(ClientId id) const;
+	bool hasShard(size_t shard) const;
+	// Intervalle [begin, end) des membres appartenant au shard
+	void shardRange(size_t shard, size_t& begin, size_t& end) const;
+};
+
+typedef SharedRef<MemberSnapshot> MemberList;
+
+// Message échangé entre shards
+struct ShardMessage {
+	enum Type {
+		NEW_CONNECTION,   // fd accepté par un autre shard, à adopter
+		DELIVER,          // payload pour un client précis
+		DELIVER_CHANNEL,  // payload pour les membres locaux de `members`
+		MEMBERS_CHANGED,  // Nouvelle liste de membres pour `channel`
+		LINK_CONNECTED,   // Shard 0 : `fd` connecté au pair n° `target` (--connect)
+		LINK_SEND,        // Shard 0 : `payload` vers les liens (voir Server::linkOutput)
+		DISCONNECT,       // Fermer le client `target` (KILL), raison dans `payload`
+		CHANNEL_LEFT,     // `target` a été retiré de `channel` (KICK) : mettre son profil à jour
+		UPGRADE           // Redémarrage à chaud : geler le shard (Server::freeze)
+	};
+
+	Type type;
+	ShardMessage* next;
+	int fd;
+	ClientId target;   // DELIVER : destinataire ; DELIVER_CHANNEL : expéditeur exclu ;
+	                   // LINK_SEND : utilisateur distant visé, -1 pour tous les liens
+	BufferRef payload;
+	std::string channel;
+	MemberList members;
+
+	explicit ShardMessage(Type type) : type(type), next(NULL), fd(-1), target(-1) {}
+};
+
+// File multi-producteurs / un consommateur sans verrou. Les producteurs
+// empilent par CAS, le shard propriétaire récupère tout d'un coup.
+// Un eventfd (un pipe hors Linux) réveille la boucle du shard.
+class Mailbox {
+public:
+	Mailbox();
+	~Mailbox();
+
+	// fd à surveiller en lecture dans la boucle du shard
+	int fd() const;
+	// Publie une chaîne liée par `next` du plus récent au plus ancien
+	void post(ShardMessage* newest, ShardMessage* oldest);
+	// Retire tous les messages, dans l'ordre d'envoi
+	ShardMessage* takeAll();
+	// Réveille le consommateur sans message ; utilisable dans un gestionnaire de signal
+	void wake();
+
+private:
+	ShardMessage* volatile head;
+	volatile int signaled;
+	int readFd;
+	int writeFd;
+
+	Mailbox(const Mailbox&);
+	Mailbox& operator=(const Mailbox&);
+};
+
+#endif // SHARD_HPP
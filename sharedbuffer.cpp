@@ -0,0 +1,94 @@
+#include "sharedbuffer.hpp"
+#include "bufferpool.hpp"
+#include "trace.hpp"
+#include <cstring>
+#include <new>
+
+SharedBuffer* SharedBuffer::allocate(size_t capacity, BufferPool* pool) {
+	size_t total = sizeof(SharedBuffer) + capacity;
+	void* raw;
+	if (pool) {
+		raw = pool->allocate(total);
+		capacity = BufferPool::sizeFor(total) - sizeof(SharedBuffer);
+	} else {
+		raw = ::operator new(total);
+	}
+	SharedBuffer* buffer = static_cast<SharedBuffer*>(raw);
+	buffer->refs = 1;
+	buffer->size = 0;
+	buffer->capacity = capacity;
+	buffer->pool = pool;
+	buffer->trace = NULL;
+	return buffer;
+}
+
+BufferRef::BufferRef() : buffer(NULL) {}
+
+BufferRef::BufferRef(SharedBuffer* buffer) : buffer(buffer) {}
+
+BufferRef::BufferRef(const BufferRef& other) : buffer(other.buffer) {
+	if (buffer)
+		__sync_add_and_fetch(&buffer->refs, 1);
+}
+
+BufferRef& BufferRef::operator=(const BufferRef& other) {
+	if (other.buffer)
+		__sync_add_and_fetch(&other.buffer->refs, 1);
+	release();
+	buffer = other.buffer;
+	return *this;
+}
+
+BufferRef::~BufferRef() {
+	release();
+}
+
+void BufferRef::release() {
+	if (buffer && __sync_sub_and_fetch(&buffer->refs, 1) == 0) {
+		delete buffer->trace;
+		if (buffer->pool)
+			buffer->pool->release(buffer, sizeof(SharedBuffer) + buffer->capacity);
+		else
+			::operator delete(buffer);
+	}
+	buffer = NULL;
+}
+
+BufferRef BufferRef::withCapacity(size_t capacity, BufferPool* pool) {
+	return BufferRef(SharedBuffer::allocate(capacity, pool));
+}
+
+BufferRef BufferRef::copyOf(const char* data, size_t len) {
+	BufferRef ref(SharedBuffer::allocate(len));
+	ref.append(data, len);
+	return ref;
+}
+
+BufferRef BufferRef::copyOf(const std::string& data) {
+	return copyOf(data.data(), data.size());
+}
+
+const char* BufferRef::data() const {
+	return buffer ? buffer->bytes() : NULL;
+}
+
+size_t BufferRef::size() const {
+	return buffer ? buffer->size : 0;
+}
+
+size_t BufferRef::spare() const {
+	if (buffer == NULL || buffer->refs != 1)
+		return 0;
+	return buffer->capacity - buffer->size;
+}
+
+size_t BufferRef::privateBytes() const {
+	if (buffer == NULL || buffer->refs != 1)
+		return 0;
+	return sizeof(SharedBuffer) + buffer->capacity;
+}
+
+void BufferRef::append(const char* data, size_t len) {
+	std::memcpy(buffer->bytes() + buffer->size, data, len);
+	buffer->size += len;
+}
@@ -0,0 +1,60 @@
+#ifndef SHAREDBUFFER_HPP
+#define SHAREDBUFFER_HPP
+
+#include <cstddef>
+#include <string>
+
+class BufferPool;
+struct TraceSpan;
+
+// Tampon d'octets à compteur de références. Un message diffusé à un canal
+// est formaté une seule fois dans un SharedBuffer, puis chaque membre n'en
+// reçoit qu'une référence dans sa file d'envoi. Le compteur est atomique :
+// un même tampon peut être référencé par des clients de plusieurs shards.
+struct SharedBuffer {
+	size_t refs;
+	size_t size;
+	size_t capacity;
+	BufferPool* pool;   // Tampon privé emprunté à ce pool, NULL : tas
+	TraceSpan* trace;   // Message suivi (trace.hpp), NULL le plus souvent
+
+	char* bytes() { return reinterpret_cast<char*>(this + 1); }
+
+	static SharedBuffer* allocate(size_t capacity, BufferPool* pool = NULL);
+};
+
+// Référence partagée vers un SharedBuffer (libéré à la dernière référence)
+class BufferRef {
+public:
+	BufferRef();
+	BufferRef(const BufferRef& other);
+	BufferRef& operator=(const BufferRef& other);
+	~BufferRef();
+
+	// Nouveau tampon privé pouvant contenir au moins `capacity` octets. Pris
+	// dans `pool`, il doit rester privé au thread du pool : c'est lui qui le
+	// libère (file d'envoi d'un client).
+	static BufferRef withCapacity(size_t capacity, BufferPool* pool = NULL);
+	static BufferRef copyOf(const char* data, size_t len);
+	static BufferRef copyOf(const std::string& data);
+
+	const char* data() const;
+	size_t size() const;
+	// Place restante ; toujours 0 si le tampon est partagé
+	size_t spare() const;
+	// Ajoute à la fin, uniquement si spare() >= len
+	void append(const char* data, size_t len);
+	// Mémoire du tampon s'il n'est référencé qu'ici, 0 s'il est partagé
+	size_t privateBytes() const;
+	// Suivi du message (trace.hpp) ; libéré avec le tampon
+	TraceSpan* trace() const { return buffer ? buffer->trace : NULL; }
+	void setTrace(TraceSpan* span) const { buffer->trace = span; }
+
+private:
+	explicit BufferRef(SharedBuffer* buffer);
+	void release();
+
+	SharedBuffer* buffer;
+};
+
+#endif // SHAREDBUFFER_HPP
@@ -0,0 +1,44 @@
+#ifndef SHAREDREF_HPP
+#define SHAREDREF_HPP
+
+#include <cstddef>
+
+// Pointeur à compteur de références intrusif et atomique. T doit exposer
+// un membre `int refs` initialisé à 0.
+template <typename T>
+class SharedRef {
+public:
+	SharedRef() : ptr(NULL) {}
+	explicit SharedRef(T* p) : ptr(p) { retain(); }
+	SharedRef(const SharedRef& other) : ptr(other.ptr) { retain(); }
+	~SharedRef() { release(); }
+
+	SharedRef& operator=(const SharedRef& other) {
+		T* previous = ptr;
+		ptr = other.ptr;
+		retain();
+		if (previous && __sync_sub_and_fetch(&previous->refs, 1) == 0)
+			delete previous;
+		return *this;
+	}
+
+	T* get() const { return ptr; }
+	T* operator->() const { return ptr; }
+	T& operator*() const { return *ptr; }
+	bool isNull() const { return ptr == NULL; }
+
+private:
+	void retain() {
+		if (ptr)
+			__sync_add_and_fetch(&ptr->refs, 1);
+	}
+	void release() {
+		if (ptr && __sync_sub_and_fetch(&ptr->refs, 1) == 0)
+			delete ptr;
+		ptr = NULL;
+	}
+
+	T* ptr;
+};
+
+#endif // SHAREDREF_HPP
@@ -0,0 +1,167 @@
+#include "sharedstate.hpp"
+
+SharedState::SharedState(size_t shardCount)
+	: shards(shardCount), version(0), reuse(shardCount > 1), registry(shardCount) {
+	for (size_t i = 0; i < shards; ++i)
+		mailboxes.push_back(new Mailbox());
+	for (size_t i = 0; i < STRIPES; ++i)
+		pthread_mutex_init(&stripes[i].mutex, NULL);
+}
+
+SharedState::~SharedState() {
+	for (size_t i = 0; i < mailboxes.size(); ++i)
+		delete mailboxes[i];
+	for (size_t i = 0; i < STRIPES; ++i) {
+		std::vector<Channel*> channels;
+		stripes[i].names.channels(channels);
+		for (size_t c = 0; c < channels.size(); ++c)
+			stripes[i].channels.destroy(channels[c]);
+		pthread_mutex_destroy(&stripes[i].mutex);
+	}
+}
+
+size_t SharedState::shardCount() const {
+	return shards;
+}
+
+Mailbox& SharedState::mailbox(size_t shard) {
+	return *mailboxes[shard];
+}
+
+unsigned long SharedState::nextVersion() {
+	return __sync_add_and_fetch(&version, 1);
+}
+
+MetricsRegistry& SharedState::metrics() {
+	return registry;
+}
+
+ChannelHistory& SharedState::history() {
+	return channelHistory;
+}
+
+bool SharedState::reusePort() const {
+	return reuse;
+}
+
+void SharedState::setReusePort(bool value) {
+	reuse = value;
+}
+
+SharedState::NameStripe& SharedState::stripeFor(size_t hash) {
+	return stripes[hash % STRIPES];
+}
+
+const InternedName* SharedState::claimNick(const StrView& nick, ClientId id) {
+	if (isChannelName(nick))
+		return NULL;
+	size_t hash = ircHash(nick);
+	NameStripe& stripe = stripeFor(hash);
+	pthread_mutex_lock(&stripe.mutex);
+	InternedName* entry = stripe.names.intern(nick, hash);
+	if (entry->owner < 0 || entry->owner == id) {
+		entry->owner = id;
+		entry->display = nick.str();
+	} else {
+		entry = NULL;
+	}
+	pthread_mutex_unlock(&stripe.mutex);
+	return entry;
+}
+
+void SharedState::releaseNick(const StrView& nick, ClientId id) {
+	size_t hash = ircHash(nick);
+	NameStripe& stripe = stripeFor(hash);
+	pthread_mutex_lock(&stripe.mutex);
+	InternedName* entry = stripe.names.find(nick, hash);
+	if (entry != NULL && entry->owner == id) {
+		entry->owner = -1;
+		stripe.names.release(entry);
+	}
+	pthread_mutex_unlock(&stripe.mutex);
+}
+
+ClientId SharedState::findNick(const StrView& nick) {
+	size_t hash = ircHash(nick);
+	NameStripe& stripe = stripeFor(hash);
+	pthread_mutex_lock(&stripe.mutex);
+	InternedName* entry = stripe.names.find(nick, hash);
+	ClientId id = entry ? entry->owner : -1;
+	pthread_mutex_unlock(&stripe.mutex);
+	return id;
+}
+
+void SharedState::nicks(std::vector<std::pair<ClientId, std::string> >& out) {
+	for (size_t i = 0; i < STRIPES; ++i) {
+		pthread_mutex_lock(&stripes[i].mutex);
+		stripes[i].names.nicks(out);
+		pthread_mutex_unlock(&stripes[i].mutex);
+	}
+}
+
+void SharedState::channelNames(std::vector<std::string>& out) {
+	std::vector<Channel*> channels;
+	for (size_t i = 0; i < STRIPES; ++i) {
+		pthread_mutex_lock(&stripes[i].mutex);
+		channels.clear();
+		stripes[i].names.channels(channels);
+		for (size_t c = 0; c < channels.size(); ++c)
+			out.push_back(channels[c]->name);
+		pthread_mutex_unlock(&stripes[i].mutex);
+	}
+}
+
+/* ************************************************************************** */
+
+ChannelLock::ChannelLock(SharedState& state, const StrView& name)
+	: state(state), name(name), hash(ircHash(name)), stripe(state.stripeFor(hash)), entry(NULL) {
+	pthread_mutex_lock(&stripe.mutex);
+	entry = stripe.names.find(name, hash);
+}
+
+ChannelLock::ChannelLock(SharedState& state, InternedName* pinned)
+	: state(state), name(pinned->display), hash(pinned->hash), stripe(state.stripeFor(hash)), entry(pinned) {
+	pthread_mutex_lock(&stripe.mutex);
+}
+
+ChannelLock::~ChannelLock() {
+	pthread_mutex_unlock(&stripe.mutex);
+}
+
+Channel* ChannelLock::find() {
+	return entry ? entry->channel : NULL;
+}
+
+Channel& ChannelLock::create() {
+	if (entry == NULL)
+		entry = stripe.names.intern(name, hash);
+	if (entry->channel == NULL) {
+		entry->channel = stripe.channels.create(name.str());
+		state.history().adopt(name);
+	}
+	return *entry->channel;
+}
+
+void ChannelLock::pin() {
+	if (entry == NULL)
+		entry = stripe.names.intern(name, hash);
+	++entry->pins;
+}
+
+void ChannelLock::unpin() {
+	if (entry == NULL || entry->pins == 0)
+		return;
+	--entry->pins;
+	if (stripe.names.release(entry))
+		entry = NULL;
+}
+
+void ChannelLock::erase() {
+	if (entry == NULL || entry->channel == NULL)
+		return;
+	state.history().retire(name);
+	stripe.channels.destroy(entry->channel);
+	entry->channel = NULL;
+	stripe.names.release(entry);
+	entry = NULL;
+}
@@ -0,0 +1,105 @@
+#ifndef SHAREDSTATE_HPP
+#define SHAREDSTATE_HPP
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "channel.hpp"
+#include "nametable.hpp"
+#include "pool.hpp"
+#include "shard.hpp"
+#include "metrics.hpp"
+#include "history.hpp"
+
+// État commun à tous les shards : pseudos, canaux, historique des canaux et
+// boîtes aux lettres.
+// Pseudos et canaux sont internés dans une même table (un nom = une
+// entrée, quelle que soit sa casse) répartie en segments, chacun avec son
+// propre verrou, pour que deux shards ne se bloquent que sur le même segment.
+class SharedState {
+public:
+	static const size_t STRIPES = 64;
+
+	explicit SharedState(size_t shardCount);
+	~SharedState();
+
+	size_t shardCount() const;
+	Mailbox& mailbox(size_t shard);
+	unsigned long nextVersion();
+	MetricsRegistry& metrics();
+	ChannelHistory& history();
+
+	// SO_REUSEPORT : chaque shard a son propre socket d'écoute ; sinon le
+	// shard 0 accepte et répartit les connexions
+	bool reusePort() const;
+	void setReusePort(bool value);
+
+	// Entrée du pseudo, désormais à `id` ; NULL s'il appartient déjà à un
+	// autre client ou a la forme d'un nom de canal
+	const InternedName* claimNick(const StrView& nick, ClientId id);
+	// Libère le pseudo seulement s'il appartient encore à `id`
+	void releaseNick(const StrView& nick, ClientId id);
+	// Retourne le ClientId du propriétaire ou -1
+	ClientId findNick(const StrView& nick);
+
+	// Instantanés pour la salve d'un lien serveur, segment par segment
+	void nicks(std::vector<std::pair<ClientId, std::string> >& out);
+	void channelNames(std::vector<std::string>& out);
+
+private:
+	struct NameStripe {
+		pthread_mutex_t mutex;
+		NameTable names;
+		Pool<Channel> channels;   // Canaux de ce segment
+	};
+
+	NameStripe& stripeFor(size_t hash);
+
+	size_t shards;
+	std::vector<Mailbox*> mailboxes;
+	unsigned long version;
+	bool reuse;
+	MetricsRegistry registry;
+	ChannelHistory channelHistory;
+	NameStripe stripes[STRIPES];
+
+	friend class ChannelLock;
+
+	SharedState(const SharedState&);
+	SharedState& operator=(const SharedState&);
+};
+
+// Verrouille le segment d'un canal pour la durée de vie de l'objet. Le nom
+// n'est replié et haché qu'une fois, à la construction.
+class ChannelLock {
+public:
+	ChannelLock(SharedState& state, const StrView& name);
+	// Entrée épinglée (ChannelSet) : ni repli ni hachage
+	ChannelLock(SharedState& state, InternedName* pinned);
+	~ChannelLock();
+
+	Channel* find();
+	// Le canal prend la casse du nom donné à sa création ; création et
+	// suppression sont signalées à l'historique
+	Channel& create();
+	void erase();
+
+	// Entrée du nom, NULL tant qu'il n'est ni interné ni épinglé
+	InternedName* interned() const { return entry; }
+	// Un ChannelSet va citer l'entrée (internée au besoin) ; unpin() rend
+	// cette référence, avant erase() le cas échéant
+	void pin();
+	void unpin();
+
+private:
+	SharedState& state;
+	StrView name;
+	size_t hash;
+	SharedState::NameStripe& stripe;
+	InternedName* entry;
+
+	ChannelLock(const ChannelLock&);
+	ChannelLock& operator=(const ChannelLock&);
+};
+
+#endif // SHAREDSTATE_HPP
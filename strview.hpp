@@ -0,0 +1,32 @@
+#ifndef STRVIEW_HPP
+#define STRVIEW_HPP
+
+#include <cstring>
+#include <string>
+#include <ostream>
+
+// Vue non possédante sur une suite d'octets (équivalent C++98 de
+// std::string_view). Ne reste valide que tant que le tampon source existe.
+struct StrView {
+	const char* ptr;
+	size_t len;
+
+	StrView() : ptr(""), len(0) {}
+	StrView(const char* p, size_t n) : ptr(p), len(n) {}
+	StrView(const std::string& s) : ptr(s.data()), len(s.size()) {}
+
+	bool empty() const { return len == 0; }
+	std::string str() const { return std::string(ptr, len); }
+	char operator[](size_t i) const { return ptr[i]; }
+
+	bool operator==(const char* s) const {
+		return std::strlen(s) == len && std::memcmp(ptr, s, len) == 0;
+	}
+	bool operator!=(const char* s) const { return !(*this == s); }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const StrView& v) {
+	return os.write(v.ptr, static_cast<std::streamsize>(v.len));
+}
+
+#endif // STRVIEW_HPP
@@ -0,0 +1,150 @@
+#include "timerwheel.hpp"
+#include <ctime>
+
+Timer::Timer(int id) : id(id), prev(this), next(this), wheel(NULL), expires(0) {}
+
+Timer::Timer(const Timer& other) : id(other.id), prev(this), next(this), wheel(NULL), expires(0) {}
+
+Timer& Timer::operator=(const Timer& other) {
+	if (this != &other) {
+		cancel();
+		id = other.id;
+	}
+	return *this;
+}
+
+Timer::~Timer() {
+	cancel();
+}
+
+bool Timer::isScheduled() const {
+	return wheel != NULL;
+}
+
+void Timer::cancel() {
+	if (wheel)
+		wheel->unlink(*this);
+}
+
+/* ************************************************************************** */
+
+TimerWheel::TimerWheel(uint64_t nowMs) : current(nowMs / TICK_MS), count(0) {}
+
+TimerWheel::~TimerWheel() {
+	for (int level = 0; level < LEVELS; ++level) {
+		for (uint64_t slot = 0; slot < SLOTS; ++slot) {
+			Timer& head = slots[level][slot];
+			while (head.next != &head)
+				unlink(*head.next);
+		}
+	}
+}
+
+uint64_t TimerWheel::nowMs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000 + static_cast<uint64_t>(ts.tv_nsec) / 1000000;
+}
+
+size_t TimerWheel::size() const {
+	return count;
+}
+
+void TimerWheel::schedule(Timer& timer, uint64_t whenMs) {
+	timer.cancel();
+	uint64_t tick = (whenMs + TICK_MS - 1) / TICK_MS;
+	timer.expires = tick < current ? current : tick;
+	timer.wheel = this;
+	++count;
+	insert(timer);
+}
+
+// Range la minuterie au niveau correspondant à son éloignement
+void TimerWheel::insert(Timer& timer) {
+	uint64_t delta = timer.expires - current;
+	int level = 0;
+	while (level < LEVELS - 1 && delta >= (SLOTS << (SLOT_BITS * level)))
+		++level;
+	uint64_t expires = timer.expires;
+	// Au-delà du dernier niveau : garder la minuterie dans la dernière case
+	uint64_t maxDelta = (SLOTS << (SLOT_BITS * (LEVELS - 1))) - 1;
+	if (delta > maxDelta)
+		expires = current + maxDelta;
+	Timer& head = slots[level][(expires >> (SLOT_BITS * level)) & SLOT_MASK];
+
+	timer.prev = head.prev;
+	timer.next = &head;
+	head.prev->next = &timer;
+	head.prev = &timer;
+}
+
+void TimerWheel::unlink(Timer& timer) {
+	timer.prev->next = timer.next;
+	timer.next->prev = timer.prev;
+	timer.prev = timer.next = &timer;
+	timer.wheel = NULL;
+	--count;
+}
+
+// Redescend le contenu de la case courante d'un niveau vers les niveaux inférieurs
+void TimerWheel::cascade(int level) {
+	Timer& head = slots[level][(current >> (SLOT_BITS * level)) & SLOT_MASK];
+	Timer pending;
+	if (head.next == &head)
+		return;
+	// Détacher la liste entière, puis réinsérer chaque minuterie
+	pending.next = head.next;
+	pending.prev = head.prev;
+	pending.next->prev = &pending;
+	pending.prev->next = &pending;
+	head.next = head.prev = &head;
+	while (pending.next != &pending) {
+		Timer& timer = *pending.next;
+		pending.next = timer.next;
+		timer.next->prev = &pending;
+		insert(timer);
+	}
+}
+
+void TimerWheel::advance(uint64_t nowMs, std::vector<int>& expired) {
+	uint64_t target = nowMs / TICK_MS;
+	if (count == 0) {
+		if (target > current)
+			current = target;
+		return;
+	}
+	while (current <= target) {
+		uint64_t index = current & SLOT_MASK;
+		// Début d'un tour du niveau 0 : redescendre les niveaux supérieurs
+		for (int level = 1; index == 0 && level < LEVELS; ++level) {
+			cascade(level);
+			index = (current >> (SLOT_BITS * level)) & SLOT_MASK;
+		}
+		Timer& head = slots[0][current & SLOT_MASK];
+		while (head.next != &head) {
+			Timer& timer = *head.next;
+			unlink(timer);
+			expired.push_back(timer.id);
+		}
+		++current;
+		if (count == 0 && target > current) {
+			current = target;
+		}
+	}
+}
+
+int TimerWheel::timeoutMs(uint64_t nowMs) const {
+	if (count == 0)
+		return -1;
+	// Prochaine case non vide du niveau 0, sinon prochaine redistribution
+	uint64_t ticks = SLOTS - (current & SLOT_MASK);
+	for (uint64_t i = 0; i < SLOTS - (current & SLOT_MASK); ++i) {
+		const Timer& head = slots[0][(current + i) & SLOT_MASK];
+		if (head.next != &head) {
+			ticks = i;
+			break;
+		}
+	}
+	uint64_t wake = (current + ticks) * TICK_MS;
+	return wake <= nowMs ? 0 : static_cast<int>(wake - nowMs);
+}
@@ -0,0 +1,72 @@
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include <vector>
+#include <stdint.h>
+#include <cstddef>
+
+class TimerWheel;
+
+// Minuterie intrusive : elle vit dans l'objet qui la possède (un Client)
+// et se retire d'elle-même de la roue à sa destruction. Une copie n'est
+// jamais programmée.
+class Timer {
+public:
+	explicit Timer(int id = -1);
+	Timer(const Timer& other);
+	Timer& operator=(const Timer& other);
+	~Timer();
+
+	bool isScheduled() const;
+	void cancel();
+
+	int id;             // Rendu par TimerWheel::advance() à l'expiration
+
+private:
+	friend class TimerWheel;
+	Timer* prev;
+	Timer* next;
+	TimerWheel* wheel;  // NULL si non programmée
+	uint64_t expires;   // En ticks
+};
+
+// Roue hiérarchique (4 niveaux de 64 cases, tick de 100 ms) : programmer,
+// annuler et expirer coûtent O(1) ; chaque tick ne touche que les minuteries
+// qui arrivent à échéance, plus une redistribution toutes les 64 cases.
+class TimerWheel {
+public:
+	static const uint64_t TICK_MS = 100;
+
+	explicit TimerWheel(uint64_t nowMs);
+	~TimerWheel();
+
+	void schedule(Timer& timer, uint64_t whenMs);
+	// Fait avancer la roue jusqu'à `nowMs` et ajoute les ids expirés
+	void advance(uint64_t nowMs, std::vector<int>& expired);
+	// Délai avant le prochain tick utile, à passer à Poller::wait (-1 : aucun)
+	int timeoutMs(uint64_t nowMs) const;
+	size_t size() const;
+
+	static uint64_t nowMs();
+
+private:
+	static const int LEVELS = 4;
+	static const int SLOT_BITS = 6;
+	static const uint64_t SLOTS = 1 << SLOT_BITS;
+	static const uint64_t SLOT_MASK = SLOTS - 1;
+
+	void insert(Timer& timer);
+	void unlink(Timer& timer);
+	void cascade(int level);
+
+	Timer slots[LEVELS][SLOTS];  // Sentinelles des listes circulaires
+	uint64_t current;            // Prochain tick à traiter
+	size_t count;
+
+	friend class Timer;
+
+	TimerWheel(const TimerWheel&);
+	TimerWheel& operator=(const TimerWheel&);
+};
+
+#endif // TIMERWHEEL_HPP
@@ -0,0 +1,197 @@
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "log.hpp"
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+
+unsigned Tracer::every = 0;
+
+namespace {
+
+std::vector<TraceRing*> rings;
+std::string dumpPath;
+
+// Contexte du thread courant : shard, anneau et lignes vues
+__thread TraceRing* localRing = NULL;
+__thread uint64_t localShard = 0;
+__thread uint64_t localLines = 0;
+
+const char* const STAGE_NAMES[TRACE_STAGES] = { "read", "frame", "parse", "dispatch", "fanout", "flush" };
+
+const size_t EVENT_WORDS = sizeof(TraceEvent) / sizeof(uint64_t);
+
+// Champ par champ : l'anneau peut être lu pendant l'écriture
+void storeEvent(TraceEvent& to, const TraceEvent& from) {
+	uint64_t* dst = reinterpret_cast<uint64_t*>(&to);
+	const uint64_t* src = reinterpret_cast<const uint64_t*>(&from);
+	for (size_t i = 0; i < EVENT_WORDS; ++i)
+		__atomic_store_n(&dst[i], src[i], __ATOMIC_RELAXED);
+}
+
+void loadEvent(TraceEvent& to, const TraceEvent& from) {
+	uint64_t* dst = reinterpret_cast<uint64_t*>(&to);
+	const uint64_t* src = reinterpret_cast<const uint64_t*>(&from);
+	for (size_t i = 0; i < EVENT_WORDS; ++i)
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+}
+
+// Microsecondes avec trois décimales, l'unité des horodatages Chrome
+void appendMicros(std::string& out, uint64_t ns) {
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%llu.%03llu", static_cast<unsigned long long>(ns / 1000),
+		static_cast<unsigned long long>(ns % 1000));
+	out += buf;
+}
+
+} // namespace
+
+TraceRing::TraceRing() : head(0) {
+	std::memset(slots, 0, sizeof(slots));
+}
+
+void TraceRing::push(const TraceEvent& event) {
+	uint64_t n = head;
+	Slot& slot = slots[n % CAPACITY];
+	__atomic_store_n(&slot.sequence, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	storeEvent(slot.event, event);
+	__atomic_store_n(&slot.sequence, n + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&head, n + 1, __ATOMIC_RELEASE);
+}
+
+void TraceRing::snapshot(std::vector<TraceEvent>& out) const {
+	uint64_t end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+	uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+	for (uint64_t n = begin; n < end; ++n) {
+		const Slot& slot = slots[n % CAPACITY];
+		uint64_t before = __atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE);
+		if (before != n + 1)
+			continue;   // Déjà remplacée, ou en cours d'écriture
+		TraceEvent event;
+		loadEvent(event, slot.event);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot.sequence, __ATOMIC_RELAXED) == before)
+			out.push_back(event);
+	}
+}
+
+void Tracer::configure(unsigned sampleEvery, size_t shards) {
+	every = sampleEvery;
+	if (every == 0)
+		return;
+	for (size_t i = 0; i < shards; ++i)
+		rings.push_back(new TraceRing());
+}
+
+void Tracer::attach(size_t shard) {
+	localShard = shard;
+	localRing = (shard < rings.size()) ? rings[shard] : NULL;
+}
+
+uint64_t Tracer::sample() {
+	if (++localLines % every != 0)
+		return 0;
+	return (localShard << 48) | (localLines & ((1ULL << 48) - 1));
+}
+
+void Tracer::record(uint64_t id, TraceStage stage, uint64_t start, uint64_t end, uint64_t detail) {
+	if (localRing == NULL)
+		return;
+	TraceEvent event;
+	event.id = id;
+	event.start = start;
+	event.duration = end > start ? end - start : 0;
+	event.stage = stage;
+	event.detail = detail;
+	event.shard = localShard;
+	localRing->push(event);
+}
+
+void Tracer::begin(const BufferRef& message, uint64_t id) {
+	TraceSpan* span = message.trace();
+	if (span == NULL) {
+		span = new TraceSpan();
+		span->id = id;
+		span->queued = 0;
+		span->pending = 1;
+		message.setTrace(span);
+		return;
+	}
+	__atomic_add_fetch(&span->pending, 1, __ATOMIC_RELAXED);
+}
+
+void Tracer::finish(const BufferRef& message, uint64_t started, size_t recipients) {
+	TraceSpan* span = message.trace();
+	uint64_t now = metricNowNs();
+	record(span->id, TRACE_FANOUT, started, now, recipients);
+	span->queued = now;
+	release(message);
+}
+
+void Tracer::hold(const BufferRef& message) {
+	if (TraceSpan* span = message.trace())
+		__atomic_add_fetch(&span->pending, 1, __ATOMIC_RELAXED);
+}
+
+void Tracer::release(const BufferRef& message) {
+	TraceSpan* span = message.trace();
+	if (span && __atomic_sub_fetch(&span->pending, 1, __ATOMIC_ACQ_REL) == 0)
+		record(span->id, TRACE_FLUSH, span->queued, metricNowNs());
+}
+
+std::string Tracer::chromeJson() {
+	std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	std::vector<TraceEvent> events;
+	for (size_t shard = 0; shard < rings.size(); ++shard) {
+		char meta[128];
+		std::snprintf(meta, sizeof(meta), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,"
+			"\"args\":{\"name\":\"shard %lu\"}}", first ? "" : ",", static_cast<unsigned long>(shard + 1),
+			static_cast<unsigned long>(shard + 1));
+		out += meta;
+		first = false;
+
+		events.clear();
+		rings[shard]->snapshot(events);
+		for (size_t i = 0; i < events.size(); ++i) {
+			const TraceEvent& event = events[i];
+			char head[160];
+			std::snprintf(head, sizeof(head), ",{\"name\":\"%s\",\"cat\":\"ircserv\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":",
+				STAGE_NAMES[event.stage < TRACE_STAGES ? event.stage : 0], static_cast<unsigned long>(event.shard + 1));
+			out += head;
+			appendMicros(out, event.start);
+			out += ",\"dur\":";
+			appendMicros(out, event.duration);
+			char args[96];
+			std::snprintf(args, sizeof(args), ",\"args\":{\"id\":\"%llx\",\"detail\":%llu}}",
+				static_cast<unsigned long long>(event.id), static_cast<unsigned long long>(event.detail));
+			out += args;
+		}
+	}
+	out += "]}\n";
+	return out;
+}
+
+bool Tracer::dump(const std::string& path) {
+	FILE* file = std::fopen(path.c_str(), "w");
+	if (file == NULL) {
+		LOG_ERROR(LOG_SERVER, "Impossible d'écrire la trace " << path << " : " << std::strerror(errno));
+		return false;
+	}
+	std::string json = chromeJson();
+	bool ok = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+	ok = (std::fclose(file) == 0) && ok;
+	if (ok)
+		LOG_INFO(LOG_SERVER, "Trace écrite dans " << path);
+	return ok;
+}
+
+void Tracer::setDumpPath(const std::string& path) {
+	dumpPath = path;
+}
+
+void Tracer::dumpOnShutdown() {
+	if (enabled() && !dumpPath.empty())
+		dump(dumpPath);
+}
@@ -0,0 +1,128 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+#include "sharedbuffer.hpp"
+
+/*
+ * Suivi d'un message, étape par étape (--trace-sample=N) : une ligne
+ * reçue sur N est suivie de la lecture jusqu'au dernier envoi à ses
+ * destinataires. Chaque étape devient un événement dans l'anneau du shard
+ * qui l'a traitée ; les anneaux sont exportés au format Chrome trace
+ * (chrome://tracing, Perfetto) par GET /trace sur --metrics-port, et dans
+ * --trace-file à l'arrêt du serveur (SIGINT).
+ *
+ * Indépendamment de l'échantillonnage, les mêmes étapes portent des sondes
+ * statiques USDT (make USDT=1, sys/sdt.h requis) pour perf ou bpftrace ;
+ * sans USDT=1 elles ne génèrent aucun code.
+ */
+
+enum TraceStage {
+	TRACE_READ,       // recv() qui a apporté la fin de la ligne
+	TRACE_FRAME,      // Fin de la lecture -> ligne extraite de recvbuf
+	TRACE_PARSE,      // Vérification UTF-8 et découpage
+	TRACE_DISPATCH,   // Exécution de la commande
+	TRACE_FANOUT,     // Mise en file chez les destinataires (deliverToMembers, sendTo)
+	TRACE_FLUSH,      // Fin de la mise en file -> envoi au dernier destinataire
+	TRACE_STAGES
+};
+
+// Message suivi, attaché au tampon diffusé (SharedBuffer::trace) : compte
+// les files d'envoi qui le contiennent encore, plus une garde par shard
+// qui n'a pas fini de le distribuer. Le dernier envoi enregistre
+// TRACE_FLUSH. Un destinataire déconnecté avant l'envoi ne rend pas sa
+// part : l'événement manque alors, sans autre effet.
+struct TraceSpan {
+	uint64_t id;
+	uint64_t queued;   // Fin de la mise en file (ns)
+	size_t pending;
+};
+
+// Un événement : durée [start, start + duration] en ns, horloge monotone
+struct TraceEvent {
+	uint64_t id;       // (shard << 48) | numéro de la ligne dans ce shard
+	uint64_t start;
+	uint64_t duration;
+	uint64_t stage;
+	uint64_t detail;   // READ : octets ; FRAME : fd ; DISPATCH : commande ; FANOUT : destinataires
+	uint64_t shard;
+};
+
+// Anneau d'événements d'un shard : un seul écrivain (le thread du shard),
+// lu sans verrou par l'export. Chaque case porte un numéro de séquence
+// (verrou de séquence) : une case réécrite pendant la copie est ignorée.
+class TraceRing {
+public:
+	static const size_t CAPACITY = 16384;
+
+	TraceRing();
+	void push(const TraceEvent& event);
+	// Les événements encore présents, du plus ancien au plus récent
+	void snapshot(std::vector<TraceEvent>& out) const;
+
+private:
+	struct Slot {
+		uint64_t sequence;   // Numéro de l'événement + 1 ; 0 : en cours d'écriture
+		TraceEvent event;
+	};
+
+	Slot slots[CAPACITY];
+	uint64_t head;
+
+	TraceRing(const TraceRing&);
+	TraceRing& operator=(const TraceRing&);
+};
+
+class Tracer {
+public:
+	// Avant le démarrage des shards ; `every` 0 : désactivé
+	static void configure(unsigned every, size_t shards);
+	// Thread d'un shard : ses événements iront dans l'anneau `shard`
+	static void attach(size_t shard);
+	static bool enabled() { return every != 0; }
+
+	// Une ligne sur `every` : identifiant du suivi, 0 sinon
+	static uint64_t sample();
+	static void record(uint64_t id, TraceStage stage, uint64_t start, uint64_t end, uint64_t detail = 0);
+
+	// Fan-out d'un message suivi : attache le suivi au tampon (s'il n'en a
+	// pas déjà un) et prend la garde de ce shard, rendue par finish()
+	static void begin(const BufferRef& message, uint64_t id);
+	static void finish(const BufferRef& message, uint64_t started, size_t recipients);
+	// Garde d'un shard destinataire : avant de poster, rendue après
+	// distribution locale
+	static void hold(const BufferRef& message);
+	static void release(const BufferRef& message);
+	// Files d'envoi (SendQueue) : ajout et envoi complet d'un tampon suivi
+	static void queued(const BufferRef& message) { hold(message); }
+	static void sent(const BufferRef& message) { release(message); }
+
+	// {"traceEvents":[...]} de tous les anneaux
+	static std::string chromeJson();
+	// Écrit chromeJson() dans `path`
+	static bool dump(const std::string& path);
+	// --trace-file : écrit par main() à l'arrêt normal du serveur
+	static void setDumpPath(const std::string& path);
+	static void dumpOnShutdown();
+
+private:
+	static unsigned every;
+};
+
+// Sondes statiques : IRC_PROBE2(read, fd, octets) devient
+// DTRACE_PROBE2(ircserv, read, fd, octets) avec make USDT=1
+#ifdef IRC_USDT
+# include <sys/sdt.h>
+# define IRC_PROBE1(name, a) DTRACE_PROBE1(ircserv, name, a)
+# define IRC_PROBE2(name, a, b) DTRACE_PROBE2(ircserv, name, a, b)
+# define IRC_PROBE3(name, a, b, c) DTRACE_PROBE3(ircserv, name, a, b, c)
+#else
+# define IRC_PROBE1(name, a) do {} while (0)
+# define IRC_PROBE2(name, a, b) do {} while (0)
+# define IRC_PROBE3(name, a, b, c) do {} while (0)
+#endif
+
+#endif // TRACE_HPP
@@ -0,0 +1,695 @@
+#include "server.hpp"
+#include "upgrade.hpp"
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sstream>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+/* ************************************************************************** */
+/*                               Sérialisation                                */
+/* ************************************************************************** */
+
+void UpgradeWriter::put8(uint8_t value) {
+	buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void UpgradeWriter::put32(uint32_t value) {
+	buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void UpgradeWriter::put64(uint64_t value) {
+	buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void UpgradeWriter::putString(const StrView& value) {
+	put32(static_cast<uint32_t>(value.len));
+	buffer.append(value.ptr, value.len);
+}
+
+void UpgradeWriter::putFd(int fd) {
+	put32(static_cast<uint32_t>(fd));
+	if (fd >= 0)
+		sockets.push_back(fd);
+}
+
+void UpgradeWriter::clear() {
+	buffer.clear();
+	sockets.clear();
+}
+
+bool UpgradeReader::take(void* out, size_t len) {
+	if (failed || len > left) {
+		failed = true;
+		std::memset(out, 0, len);
+		return false;
+	}
+	std::memcpy(out, ptr, len);
+	ptr += len;
+	left -= len;
+	return true;
+}
+
+uint8_t UpgradeReader::get8() {
+	uint8_t value;
+	take(&value, sizeof(value));
+	return value;
+}
+
+uint32_t UpgradeReader::get32() {
+	uint32_t value;
+	take(&value, sizeof(value));
+	return value;
+}
+
+uint64_t UpgradeReader::get64() {
+	uint64_t value;
+	take(&value, sizeof(value));
+	return value;
+}
+
+std::string UpgradeReader::getString() {
+	uint32_t len = get32();
+	if (failed || len > left) {
+		failed = true;
+		return std::string();
+	}
+	std::string value(ptr, len);
+	ptr += len;
+	left -= len;
+	return value;
+}
+
+/* ************************************************************************** */
+/*                                  Upgrade                                   */
+/* ************************************************************************** */
+
+static const size_t FD_BATCH = 250;   // SCM_RIGHTS : au plus 253 fds par message
+
+static std::vector<std::string> command;   // argv, sans --upgrade-fd
+static std::string program;                // Relancé par execv
+static size_t shardCount = 0;
+static std::vector<UpgradeWriter> writers;
+static pthread_barrier_t freezeBarrier;
+static bool handedOff = false;
+static int exporterFd = -1;
+static volatile sig_atomic_t requested = 0;
+static Mailbox* wakeMailbox = NULL;
+
+// Nouveau processus
+static int upgradeFd = -1;
+static std::vector<std::string> sections;  // État reçu, un par shard
+static int restoredMetricsFd = -1;
+
+static bool writeAll(int fd, const char* data, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		len -= static_cast<size_t>(n);
+	}
+	return true;
+}
+
+static bool readAll(int fd, char* data, size_t len) {
+	while (len > 0) {
+		ssize_t n = read(fd, data, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		len -= static_cast<size_t>(n);
+	}
+	return true;
+}
+
+// Un octet porte chaque lot de fds : les lots ne peuvent pas fusionner
+static bool sendFds(int sock, const int* fds, size_t count) {
+	char byte = 'F';
+	struct iovec iov;
+	iov.iov_base = &byte;
+	iov.iov_len = 1;
+	union {
+		char buf[CMSG_SPACE(FD_BATCH * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct msghdr msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+	std::memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+	ssize_t n;
+	while ((n = sendmsg(sock, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+		;
+	return n == 1;
+}
+
+static bool receiveFds(int sock, std::vector<int>& out) {
+	char byte;
+	struct iovec iov;
+	iov.iov_base = &byte;
+	iov.iov_len = 1;
+	union {
+		char buf[CMSG_SPACE(FD_BATCH * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct msghdr msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	ssize_t n;
+	while ((n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR)
+		;
+	if (n != 1 || (msg.msg_flags & MSG_CTRUNC))
+		return false;
+	for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		const int* fds = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+		out.insert(out.end(), fds, fds + count);
+	}
+	return true;
+}
+
+// Ferme tout ce que le processus hérite à part stdin/stdout/stderr et
+// `keep` : les sockets non marqués FD_CLOEXEC de l'ancien processus
+// occuperaient sinon les numéros à reprendre
+static void closeInherited(int keep) {
+#ifdef SYS_close_range
+	if (syscall(SYS_close_range, 3, keep - 1, 0) == 0 && syscall(SYS_close_range, keep + 1, ~0U, 0) == 0)
+		return;
+#endif
+	long limit = sysconf(_SC_OPEN_MAX);
+	for (long fd = 3; fd < limit; ++fd) {
+		if (fd != keep)
+			close(static_cast<int>(fd));
+	}
+}
+
+void Upgrade::init(int argc, char** argv, size_t shards) {
+	for (int i = 0; i < argc; ++i) {
+		if (std::strncmp(argv[i], "--upgrade-fd=", 13) != 0)
+			command.push_back(argv[i]);
+	}
+	// Le chemin d'origine plutôt que /proc/self/exe : c'est le binaire
+	// installé à sa place qui doit démarrer
+	program = std::strchr(argv[0], '/') ? argv[0] : "/proc/self/exe";
+	shardCount = shards;
+	writers.resize(shards);
+	pthread_barrier_init(&freezeBarrier, NULL, static_cast<unsigned>(shards));
+}
+
+bool Upgrade::placeFds(const std::vector<int>& received, const std::vector<int>& original) {
+	int base = 3;
+	for (size_t i = 0; i < original.size(); ++i) {
+		if (original[i] >= base)
+			base = original[i] + 1;
+	}
+	// D'abord au-delà de tous les numéros d'origine, pour qu'aucun dup2()
+	// n'écrase un fd reçu pas encore placé
+	std::vector<int> moved(received.size());
+	for (size_t i = 0; i < received.size(); ++i) {
+		moved[i] = fcntl(received[i], F_DUPFD_CLOEXEC, base);
+		close(received[i]);
+		if (moved[i] < 0)
+			return false;
+	}
+	for (size_t i = 0; i < moved.size(); ++i) {
+		if (original[i] < 3 || original[i] == upgradeFd || dup2(moved[i], original[i]) < 0)
+			return false;
+		close(moved[i]);
+	}
+	return true;
+}
+
+bool Upgrade::receive(int fd) {
+	upgradeFd = fd;
+	closeInherited(fd);
+	struct timeval timeout = { READY_TIMEOUT_MS / 1000, 0 };
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	// En-tête : taille de l'état, puis numéros d'origine des fds transmis
+	char header[12];
+	if (!readAll(fd, header, sizeof(header)))
+		return false;
+	UpgradeReader sizes(header, sizeof(header));
+	uint64_t stateLen = sizes.get64();
+	uint32_t fdCount = sizes.get32();
+	std::string numbers(fdCount * sizeof(uint32_t), '\0');
+	std::string state(stateLen, '\0');
+	if (!readAll(fd, &numbers[0], numbers.size()) || !readAll(fd, &state[0], state.size()))
+		return false;
+	std::vector<int> original;
+	UpgradeReader numberReader(numbers.data(), numbers.size());
+	for (uint32_t i = 0; i < fdCount; ++i)
+		original.push_back(numberReader.getFd());
+
+	std::vector<int> received;
+	while (received.size() < fdCount) {
+		if (!receiveFds(fd, received))
+			return false;
+	}
+	if (received.size() != fdCount || !placeFds(received, original))
+		return false;
+
+	UpgradeReader in(state.data(), state.size());
+	if (in.get32() != MAGIC || in.get32() != VERSION || in.get32() != shardCount)
+		return false;
+	restoredMetricsFd = in.getFd();
+	for (size_t shard = 0; shard < shardCount; ++shard)
+		sections.push_back(in.getString());
+	return in.ok();
+}
+
+bool Upgrade::restoring() {
+	return upgradeFd >= 0;
+}
+
+UpgradeReader Upgrade::reader(size_t shard) {
+	if (shard >= sections.size())
+		return UpgradeReader();
+	return UpgradeReader(sections[shard].data(), sections[shard].size());
+}
+
+int Upgrade::metricsFd() {
+	return restoredMetricsFd;
+}
+
+void Upgrade::confirm() {
+	if (upgradeFd < 0)
+		return;
+	writeAll(upgradeFd, "K", 1);
+	close(upgradeFd);
+	upgradeFd = -1;
+	std::vector<std::string>().swap(sections);
+}
+
+void Upgrade::onSignal(int signal) {
+	(void) signal;
+	requested = 1;
+	if (wakeMailbox)
+		wakeMailbox->wake();
+}
+
+void Upgrade::install(Mailbox& wake) {
+	wakeMailbox = &wake;
+	struct sigaction action;
+	std::memset(&action, 0, sizeof(action));
+	action.sa_handler = onSignal;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	sigaction(SIGUSR2, &action, NULL);
+}
+
+bool Upgrade::takeRequest() {
+	if (!requested)
+		return false;
+	requested = 0;
+	return true;
+}
+
+void Upgrade::barrier() {
+	pthread_barrier_wait(&freezeBarrier);
+}
+
+UpgradeWriter& Upgrade::writer(size_t shard) {
+	return writers[shard];
+}
+
+void Upgrade::setMetricsFd(int fd) {
+	exporterFd = fd;
+}
+
+bool Upgrade::sendState(int fd) {
+	UpgradeWriter state;
+	state.put32(MAGIC);
+	state.put32(VERSION);
+	state.put32(static_cast<uint32_t>(shardCount));
+	state.putFd(exporterFd);
+	std::vector<int> fds(state.fds());
+	for (size_t shard = 0; shard < shardCount; ++shard) {
+		state.putString(writers[shard].data());
+		fds.insert(fds.end(), writers[shard].fds().begin(), writers[shard].fds().end());
+	}
+	UpgradeWriter header;
+	header.put64(state.data().size());
+	header.put32(static_cast<uint32_t>(fds.size()));
+	for (size_t i = 0; i < fds.size(); ++i)
+		header.put32(static_cast<uint32_t>(fds[i]));
+
+	if (!writeAll(fd, header.data().data(), header.data().size())
+		|| !writeAll(fd, state.data().data(), state.data().size()))
+		return false;
+	for (size_t i = 0; i < fds.size(); i += FD_BATCH) {
+		if (!sendFds(fd, &fds[i], std::min(FD_BATCH, fds.size() - i)))
+			return false;
+	}
+	LOG_INFO(LOG_SERVER, "Redémarrage à chaud : " << state.data().size() << " octets d'état et "
+		<< fds.size() << " sockets transmis");
+	return true;
+}
+
+bool Upgrade::handoff() {
+	uint64_t started = TimerWheel::nowMs();
+	int pair[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) {
+		LOG_ERROR(LOG_SERVER, "redémarrage à chaud : socketpair impossible : " << strerror(errno));
+		return false;
+	}
+	std::ostringstream option;
+	option << "--upgrade-fd=" << pair[1];
+	std::vector<std::string> args(command);
+	args.push_back(option.str());
+	std::vector<char*> argv;
+	for (size_t i = 0; i < args.size(); ++i)
+		argv.push_back(const_cast<char*>(args[i].c_str()));
+	argv.push_back(NULL);
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		// Processus multi-thread : rien d'autre que des appels sûrs avant exec
+		fcntl(pair[1], F_SETFD, 0);
+		execv(program.c_str(), &argv[0]);
+		_exit(127);
+	}
+	close(pair[1]);
+	if (pid < 0) {
+		LOG_ERROR(LOG_SERVER, "redémarrage à chaud : fork impossible : " << strerror(errno));
+		close(pair[0]);
+		return false;
+	}
+
+	struct timeval timeout = { READY_TIMEOUT_MS / 1000, 0 };
+	setsockopt(pair[0], SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	bool ready = sendState(pair[0]);
+	if (ready) {
+		// Le nouveau processus confirme une fois tout repris
+		struct pollfd wait;
+		wait.fd = pair[0];
+		wait.events = POLLIN;
+		char answer = 0;
+		ready = poll(&wait, 1, READY_TIMEOUT_MS) == 1 && read(pair[0], &answer, 1) == 1 && answer == 'K';
+	}
+	close(pair[0]);
+	if (!ready) {
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+		LOG_ERROR(LOG_SERVER, "redémarrage à chaud abandonné : " << program << " n'a pas repris l'état");
+		return false;
+	}
+	LOG_INFO(LOG_SERVER, "Redémarrage à chaud : processus " << pid << " prêt en "
+		<< TimerWheel::nowMs() - started << " ms");
+	return true;
+}
+
+void Upgrade::setResult(bool success) {
+	handedOff = success;
+}
+
+bool Upgrade::result() {
+	return handedOff;
+}
+
+/* ************************************************************************** */
+/*                          Gel et reprise d'un shard                         */
+/* ************************************************************************** */
+
+enum {
+	SAVED_REGISTERED = 1,
+	SAVED_CLOSING = 2,
+	SAVED_PING_SENT = 4,
+	SAVED_AUTHENTICATED = 8,
+	SAVED_PASS = 16,
+	SAVED_NICK = 32,
+	SAVED_USER = 64
+};
+
+// Gel d'un shard pour un redémarrage à chaud, en étapes séparées par des
+// rendez-vous : plus aucune lecture, puis plus aucun message entre shards,
+// puis écriture de l'état et passage de main par le shard 0. En cas
+// d'échec, chaque shard reprend là où il en était.
+void Server::freeze() {
+	freezeRequested = false;
+	upgrading = true;
+
+	// 1. Arrêter les lectures ; ce que io_uring a déjà lu va dans recvbuf
+	// sans être traité, les envois annulés resteront dans sendq
+	poller->suspend();
+	std::vector<PollEvent> events;
+	bool drained = !poller->completions();
+	while (!drained) {
+		drained = true;
+		poller->wait(events, 0);
+		for (size_t i = 0; i < events.size(); ++i) {
+			const PollEvent &event = events[i];
+			Client *client = connections.find(event.fd);
+			if (event.events & Poller::ACCEPTED) {
+				drained = false;
+				if (event.result >= 0 && event.fd == server_fd)
+					adoptClient(event.result);
+				else if (event.result >= 0)
+					close(event.result);
+			} else if (client && (event.events & Poller::RECEIVED)) {
+				drained = false;
+				if (event.result > 0) {
+					client->recvbuf.feed(event.data, static_cast<size_t>(event.result));
+					client->recvbuf.settle();
+				} else if (event.result != -ECANCELED) {
+					removeClient(event.fd);
+				}
+			} else if (client && (event.events & Poller::SENT)) {
+				drained = false;
+				client->sendInFlight = false;
+				if (event.result >= 0)
+					client->sendq.consume(static_cast<size_t>(event.result));
+				else if (event.result != -ECANCELED)
+					removeClient(event.fd);
+			}
+		}
+	}
+	if (shardId == 0) {
+		for (size_t i = 0; i < links.size(); ++i) {
+			if (links[i].fd >= 0)
+				removeClient(links[i].fd);
+		}
+	}
+	flushOutbox();
+	Upgrade::barrier();
+
+	// 2. Messages postés entre shards avant le gel
+	processMailbox();
+	flushOutbox();
+	Upgrade::barrier();
+
+	// 3. État de chaque shard, puis canaux et passage de main par le shard 0
+	UpgradeWriter &out = Upgrade::writer(shardId);
+	out.clear();
+	saveState(out);
+	Upgrade::barrier();
+	if (shardId == 0) {
+		saveChannels(out);
+		Upgrade::setResult(Upgrade::handoff());
+	}
+	Upgrade::barrier();
+	if (Upgrade::result()) {
+		if (shardId == 0) {
+			LOG_INFO(LOG_SERVER, "Redémarrage à chaud terminé, arrêt de l'ancien processus");
+			exit(EXIT_SUCCESS);
+		}
+		while (true)
+			pause();
+	}
+
+	upgrading = false;
+	poller->resume();
+	for (int fd = 0; fd < connections.fdLimit(); ++fd) {
+		Client *client = connections.find(fd);
+		if (client && !client->sendq.empty() && !client->flushScheduled) {
+			client->flushScheduled = true;
+			pendingFlush.push_back(fd);
+		}
+	}
+}
+
+void Server::saveState(UpgradeWriter &out) {
+	out.put8(shared->reusePort());
+	out.putFd(server_fd);
+	out.putFd(linkListenFd);
+	int limit = connections.fdLimit();
+	out.put32(static_cast<uint32_t>(limit));
+	for (int fd = 0; fd < limit; ++fd)
+		out.put32(connections.generation(fd));
+
+	std::vector<const Client*> saved;
+	for (int fd = 0; fd < limit; ++fd) {
+		if (const Client *client = connections.find(fd))
+			saved.push_back(client);
+	}
+	out.put32(static_cast<uint32_t>(saved.size()));
+	for (size_t i = 0; i < saved.size(); ++i) {
+		const Client &client = *saved[i];
+		out.putFd(client.fd);
+		out.put8((client.registered ? SAVED_REGISTERED : 0) | (client.closing ? SAVED_CLOSING : 0)
+			| (client.pingSent ? SAVED_PING_SENT : 0) | (client.is_authenticated ? SAVED_AUTHENTICATED : 0)
+			| (client.passReceived ? SAVED_PASS : 0) | (client.nickReceived ? SAVED_NICK : 0)
+			| (client.userReceived ? SAVED_USER : 0));
+		out.put64(client.lastActivity);
+		out.put64(client.floodClock);
+		out.put32(client.caps);
+		out.putString(client.nickname);
+		out.putString(client.profile->username);
+		out.putString(client.profile->realname);
+		out.put32(static_cast<uint32_t>(client.profile->channels.size()));
+		for (ChannelSet::const_iterator it = client.profile->channels.begin(); it != client.profile->channels.end(); ++it)
+			out.putString((*it)->display);
+		out.putString(client.recvbuf.unread());
+		out.putString(client.sendq.contents());
+	}
+}
+
+// Shard 0, tous les shards gelés : les canaux ne bougent plus
+void Server::saveChannels(UpgradeWriter &out) {
+	std::vector<std::string> names;
+	shared->channelNames(names);
+	UpgradeWriter records;
+	uint32_t count = 0;
+	for (size_t i = 0; i < names.size(); ++i) {
+		ChannelLock lock(*shared, names[i]);
+		const Channel *channel = lock.find();
+		if (channel == NULL)
+			continue;
+		++count;
+		records.putString(channel->name);
+		records.putString(channel->topic);
+		records.put8((channel->inviteOnly ? 1 : 0) | (channel->topicRestricted ? 2 : 0));
+		records.putString(channel->password);
+		records.put32(static_cast<uint32_t>(channel->userLimit));
+		records.put32(static_cast<uint32_t>(channel->clients.size()));
+		for (MemberModes::const_iterator it = channel->clients.begin(); it != channel->clients.end(); ++it) {
+			records.put64(static_cast<uint64_t>(it->first));
+			records.put8(it->second);
+		}
+	}
+	out.put32(count);
+	out.putString(records.data());
+}
+
+// Nouveau processus, avant le démarrage des boucles : reprend sockets,
+// clients et (shard 0) canaux sous leurs ClientId d'origine
+bool Server::restoreState(UpgradeReader &in) {
+	shared->setReusePort(in.get8() != 0);
+	server_fd = in.getFd();
+	linkListenFd = in.getFd();
+	if ((server_fd >= 0 && !poller->addListener(server_fd)) || (linkListenFd >= 0 && !poller->addListener(linkListenFd)))
+		return false;
+	uint32_t limit = in.get32();
+	for (uint32_t fd = 0; fd < limit && in.ok(); ++fd)
+		connections.setGeneration(static_cast<int>(fd), in.get32());
+
+	uint32_t count = in.get32();
+	uint64_t now = TimerWheel::nowMs();
+	for (uint32_t i = 0; i < count && in.ok(); ++i) {
+		int fd = in.getFd();
+		if (fd < 0 || fd >= static_cast<int>(limit) || !poller->addConnection(fd))
+			return false;
+		Client &client = connections.restore(fd);
+		uint8_t flags = in.get8();
+		client.registered = flags & SAVED_REGISTERED;
+		client.closing = flags & SAVED_CLOSING;
+		client.pingSent = flags & SAVED_PING_SENT;
+		client.is_authenticated = flags & SAVED_AUTHENTICATED;
+		client.passReceived = flags & SAVED_PASS;
+		client.nickReceived = flags & SAVED_NICK;
+		client.userReceived = flags & SAVED_USER;
+		client.lastActivity = in.get64();
+		client.floodClock = in.get64();
+		client.caps = in.get32();
+		client.nickname = in.getString();
+		client.profile->username = in.getString();
+		client.profile->realname = in.getString();
+		for (uint32_t joined = in.get32(); joined > 0 && in.ok(); --joined) {
+			std::string name = in.getString();
+			ChannelLock lock(*shared, name);
+			lock.pin();
+			if (!client.profile->channels.insert(lock.interned()).second)
+				lock.unpin();
+		}
+		updatePrefix(client);
+		std::string input = in.getString();
+		client.recvbuf.feed(input.data(), input.size());
+		client.recvbuf.settle();
+		client.sendq.setLimit(config.sendq);
+		std::string output = in.getString();
+		if (!output.empty())
+			client.sendq.appendFinal(output);
+
+		if (client.nickReceived)
+			client.nickEntry = shared->claimNick(client.nickname, idOf(fd));
+		if (!client.closing) {
+			timers.schedule(client.timer, client.pingSent ? now + config.pingTimeout * 1000
+				: client.lastActivity + config.pingInterval * 1000);
+			// Lignes déjà reçues : traitées au premier tour de boucle
+			if (client.recvbuf.pending() != 0)
+				timers.schedule(client.inputTimer, now);
+		}
+		if (client.closing || !client.sendq.empty()) {
+			client.flushScheduled = true;
+			pendingFlush.push_back(fd);
+		}
+	}
+	if (shardId == 0)
+		restoreChannels(in);
+	if (!in.ok())
+		return false;
+	flushOutbox();
+	flushPendingClients();
+	LOG_INFO(LOG_SERVER, "Redémarrage à chaud : " << count << " clients repris par le shard " << shardId + 1);
+	return true;
+}
+
+void Server::restoreChannels(UpgradeReader &in) {
+	uint32_t count = in.get32();
+	std::string data = in.getString();
+	UpgradeReader records(data.data(), data.size());
+	for (uint32_t i = 0; i < count && records.ok(); ++i) {
+		std::string name = records.getString();
+		ChannelLock lock(*shared, name);
+		Channel &channel = lock.create();
+		channel.topic = records.getString();
+		uint8_t modes = records.get8();
+		channel.inviteOnly = modes & 1;
+		channel.topicRestricted = modes & 2;
+		channel.password = records.getString();
+		channel.userLimit = static_cast<int>(records.get32());
+		uint32_t members = records.get32();
+		for (uint32_t m = 0; m < members && records.ok(); ++m) {
+			ClientId id = static_cast<ClientId>(records.get64());
+			channel.clients[id] = records.get8();
+		}
+		if (channel.clients.empty())
+			lock.erase();
+		else
+			publishMembers(channel);
+	}
+	if (!records.ok())
+		in.getString();   // Marque le lecteur principal en échec
+}
@@ -0,0 +1,103 @@
+#ifndef UPGRADE_HPP
+#define UPGRADE_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "strview.hpp"
+
+class Mailbox;
+
+/*
+ * Redémarrage à chaud (SIGUSR2) : le processus en place gèle ses shards,
+ * sérialise clients et canaux, lance le binaire (même ligne de commande,
+ * plus --upgrade-fd=N) et lui passe l'état puis tous les sockets
+ * (SCM_RIGHTS) sur une paire de sockets UNIX. Le nouveau processus remet
+ * chaque socket sous son numéro d'origine : ClientId, tables indexées par
+ * fd et listes de membres restent valides telles quelles. L'ancien
+ * processus s'arrête quand le nouveau confirme ; sinon il reprend.
+ *
+ * Les liens serveur ne sont pas transmis : ils sont fermés avant le gel
+ * et rétablis ensuite (netsplit bref pour les voisins).
+ */
+
+// État d'un shard en cours d'écriture. Les entiers sont en ordre natif :
+// l'état ne quitte pas la machine.
+class UpgradeWriter {
+public:
+	void put8(uint8_t value);
+	void put32(uint32_t value);
+	void put64(uint64_t value);
+	void putString(const StrView& value);
+	// Numéro d'un socket à transmettre ; -1 : aucun
+	void putFd(int fd);
+
+	void clear();
+	const std::string& data() const { return buffer; }
+	const std::vector<int>& fds() const { return sockets; }
+
+private:
+	std::string buffer;
+	std::vector<int> sockets;
+};
+
+// Lecture de l'état d'un shard ; une lecture hors limites rend 0 et
+// marque le lecteur en échec
+class UpgradeReader {
+public:
+	UpgradeReader() : ptr(NULL), left(0), failed(true) {}
+	UpgradeReader(const char* data, size_t len) : ptr(data), left(len), failed(false) {}
+
+	uint8_t get8();
+	uint32_t get32();
+	uint64_t get64();
+	std::string getString();
+	int getFd() { return static_cast<int>(get32()); }
+	bool ok() const { return !failed; }
+
+private:
+	bool take(void* out, size_t len);
+
+	const char* ptr;
+	size_t left;
+	bool failed;
+};
+
+class Upgrade {
+public:
+	static const uint32_t MAGIC = 0x55435249;    // "IRCU"
+	static const uint32_t VERSION = 3;
+	static const int READY_TIMEOUT_MS = 10000;   // Délai laissé au nouveau processus
+
+	// À appeler en premier : ligne de commande à relancer, nombre de shards
+	static void init(int argc, char** argv, size_t shards);
+	// Nouveau processus : reçoit l'état sur `fd` et remet les sockets sous
+	// leurs numéros d'origine. Doit précéder toute ouverture de fd.
+	static bool receive(int fd);
+	static bool restoring();
+	static UpgradeReader reader(size_t shard);
+	static int metricsFd();
+	// Nouveau processus prêt : l'ancien peut s'arrêter
+	static void confirm();
+
+	// SIGUSR2 réveille le shard 0 par sa boîte aux lettres
+	static void install(Mailbox& wake);
+	static bool takeRequest();
+
+	// Gel (tous les shards) : rendez-vous entre les étapes, état par shard
+	static void barrier();
+	static UpgradeWriter& writer(size_t shard);
+	static void setMetricsFd(int fd);
+	// Shard 0 : lance le nouveau processus et lui transmet l'état ; true
+	// s'il a confirmé
+	static bool handoff();
+	static void setResult(bool success);
+	static bool result();
+
+private:
+	static void onSignal(int signal);
+	static bool sendState(int fd);
+	static bool placeFds(const std::vector<int>& received, const std::vector<int>& original);
+};
+
+#endif // UPGRADE_HPP
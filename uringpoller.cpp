@@ -0,0 +1,490 @@
+#include "poller.hpp"
+
+#ifdef HAVE_IO_URING
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* ************************************************************************** */
+/*                                  io_uring                                  */
+/* ************************************************************************** */
+
+// Pas de dépendance à liburing : appels système directs
+static int uringSetup(unsigned entries, struct io_uring_params* params) {
+	return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize) {
+	return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+static int uringRegister(int fd, unsigned opcode, void* arg, unsigned nrArgs) {
+	return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+// user_data d'une opération : type (8 bits), génération du fd (24 bits), fd
+enum UringOp { OP_NONE, OP_ACCEPT, OP_RECV, OP_SEND, OP_POLL };
+
+static const unsigned RING_ENTRIES = 1024;
+static const unsigned BUF_COUNT = 512;     // Puissance de deux
+static const unsigned BUF_SIZE = 2048;
+static const uint16_t BUF_GROUP = 0;
+static const uint32_t GEN_MASK = 0xFFFFFF;
+
+static uint64_t packUserData(UringOp op, int fd, uint32_t gen) {
+	return (static_cast<uint64_t>(op) << 56) | (static_cast<uint64_t>(gen & GEN_MASK) << 32) | static_cast<uint32_t>(fd);
+}
+
+static unsigned toPollMask(unsigned events) {
+	unsigned mask = 0;
+	if (events & Poller::READ)
+		mask |= POLLIN | POLLRDHUP;
+	if (events & Poller::WRITE)
+		mask |= POLLOUT;
+	return mask;
+}
+
+UringPoller::UringPoller()
+	: ringFd(-1), ringMap(NULL), ringMapSize(0), sqHead(NULL), sqTail(NULL), sqMask(0), sqEntries(0),
+	  sqes(NULL), sqesSize(0), localTail(0), cqHead(NULL), cqTail(NULL), cqMask(0), cqes(NULL),
+	  bufMap(NULL), bufMapSize(0), bufRing(NULL), bufBase(NULL), bufTail(0), suspended(false) {
+	if (!setup(RING_ENTRIES) || !setupBuffers()) {
+		release();
+	}
+}
+
+UringPoller::~UringPoller() {
+	release();
+	for (size_t i = 0; i < fds.size(); ++i)
+		delete fds[i].send;
+}
+
+void UringPoller::release() {
+	if (ringFd >= 0)
+		close(ringFd);
+	if (sqes)
+		munmap(sqes, sqesSize);
+	if (ringMap)
+		munmap(ringMap, ringMapSize);
+	if (bufMap)
+		munmap(bufMap, bufMapSize);
+	ringFd = -1;
+	sqes = NULL;
+	ringMap = NULL;
+	bufMap = NULL;
+}
+
+bool UringPoller::isValid() const {
+	return ringFd >= 0;
+}
+
+bool UringPoller::setup(unsigned entries) {
+	struct io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+	params.cq_entries = entries * 4;
+	ringFd = uringSetup(entries, &params);
+	if (ringFd < 0)
+		return false;
+
+	// Les vecteurs d'envoi ne vivent que jusqu'à la soumission (SUBMIT_STABLE)
+	const unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_SUBMIT_STABLE | IORING_FEAT_EXT_ARG;
+	if ((params.features & required) != required)
+		return false;
+
+	size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	ringMapSize = sqSize > cqSize ? sqSize : cqSize;
+	void* map = mmap(NULL, ringMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	if (map == MAP_FAILED)
+		return false;
+	ringMap = map;
+	sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	map = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+	if (map == MAP_FAILED)
+		return false;
+	sqes = static_cast<struct io_uring_sqe*>(map);
+
+	char* base = static_cast<char*>(ringMap);
+	sqHead = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+	sqTail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+	sqMask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+	sqEntries = params.sq_entries;
+	localTail = *sqTail;
+	// Tableau d'indirection identité : l'entrée i désigne toujours sqes[i]
+	unsigned* sqArray = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+	for (unsigned i = 0; i < params.sq_entries; ++i)
+		sqArray[i] = i;
+	cqHead = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+	cqTail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+	cqMask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<struct io_uring_cqe*>(base + params.cq_off.cqes);
+
+	// L'annulation synchrone (6.0, comme recv multishot) sert à retirer un fd
+	// sans laisser d'opération en vol : sans objet, elle répond ENOENT
+	struct io_uring_sync_cancel_reg reg;
+	std::memset(&reg, 0, sizeof(reg));
+	reg.fd = ringFd;
+	reg.flags = IORING_ASYNC_CANCEL_FD;
+	reg.timeout.tv_sec = -1;
+	reg.timeout.tv_nsec = -1;
+	return uringRegister(ringFd, IORING_REGISTER_SYNC_CANCEL, &reg, 1) < 0 && errno == ENOENT;
+}
+
+// Anneau de tampons fournis : le noyau y choisit où écrire chaque recv
+bool UringPoller::setupBuffers() {
+	size_t ringSize = BUF_COUNT * sizeof(struct io_uring_buf);
+	bufMapSize = ringSize + BUF_COUNT * BUF_SIZE;
+	void* map = mmap(NULL, bufMapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		return false;
+	bufMap = map;
+	bufRing = static_cast<struct io_uring_buf_ring*>(map);
+	bufBase = static_cast<char*>(map) + ringSize;
+
+	struct io_uring_buf_reg reg;
+	std::memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = reinterpret_cast<uint64_t>(bufRing);
+	reg.ring_entries = BUF_COUNT;
+	reg.bgid = BUF_GROUP;
+	if (uringRegister(ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+		return false;
+
+	for (unsigned bid = 0; bid < BUF_COUNT; ++bid)
+		recycle(static_cast<uint16_t>(bid));
+	__atomic_store_n(&bufRing->tail, bufTail, __ATOMIC_RELEASE);
+	return true;
+}
+
+void UringPoller::recycle(uint16_t bid) {
+	// Pas de bufRing->bufs : en C++, le tableau flexible de l'en-tête noyau
+	// est décalé par sa structure vide (taille 1), l'anneau commence à 0
+	struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(bufRing) + (bufTail & (BUF_COUNT - 1));
+	buf->addr = reinterpret_cast<uint64_t>(bufBase + static_cast<size_t>(bid) * BUF_SIZE);
+	buf->len = BUF_SIZE;
+	buf->bid = bid;
+	++bufTail;
+}
+
+UringPoller::FdState& UringPoller::state(int fd) {
+	if (static_cast<size_t>(fd) >= fds.size())
+		fds.resize(fd + 1);
+	return fds[fd];
+}
+
+struct io_uring_sqe* UringPoller::getSqe() {
+	if (localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+		// File pleine : soumettre sans attendre
+		submit(0, 0);
+		if (localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries)
+			return NULL;
+	}
+	struct io_uring_sqe* sqe = &sqes[localTail & sqMask];
+	std::memset(sqe, 0, sizeof(*sqe));
+	++localTail;
+	return sqe;
+}
+
+// Soumet les entrées préparées et, si waitFor > 0, attend autant de
+// complétions (au plus timeout_ms, -1 : sans limite) dans le même appel
+int UringPoller::submit(unsigned waitFor, int timeout_ms) {
+	__atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+	unsigned toSubmit = localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+	if (toSubmit == 0 && waitFor == 0)
+		return 0;
+
+	unsigned flags = 0;
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	void* argp = NULL;
+	size_t argSize = 0;
+	if (waitFor > 0) {
+		flags |= IORING_ENTER_GETEVENTS;
+		if (timeout_ms >= 0) {
+			ts.tv_sec = timeout_ms / 1000;
+			ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+			std::memset(&arg, 0, sizeof(arg));
+			arg.ts = reinterpret_cast<uint64_t>(&ts);
+			flags |= IORING_ENTER_EXT_ARG;
+			argp = &arg;
+			argSize = sizeof(arg);
+		}
+	}
+	int ret = uringEnter(ringFd, toSubmit, waitFor, flags, argp, argSize);
+	if (ret < 0 && (errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY))
+		return 0;
+	return ret;
+}
+
+// (Re)lance l'opération multishot correspondant au rôle du fd
+void UringPoller::arm(int fd) {
+	FdState& st = fds[fd];
+	if (st.kind == NONE || (suspended && st.kind != POLL) || st.paused)
+		return;
+	struct io_uring_sqe* sqe = getSqe();
+	if (sqe == NULL) {
+		rearm.push_back(fd);
+		return;
+	}
+	sqe->fd = fd;
+	switch (st.kind) {
+	case LISTENER:
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->accept_flags = SOCK_CLOEXEC;
+		sqe->user_data = packUserData(OP_ACCEPT, fd, st.gen);
+		break;
+	case CONNECTION:
+		sqe->opcode = IORING_OP_RECV;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = BUF_GROUP;
+		sqe->user_data = packUserData(OP_RECV, fd, st.gen);
+		break;
+	case POLL:
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->poll32_events = toPollMask(st.events);
+		sqe->len = IORING_POLL_ADD_MULTI;
+		sqe->user_data = packUserData(OP_POLL, fd, st.gen);
+		break;
+	case NONE:
+		break;
+	}
+}
+
+// Annule toutes les opérations du fd et attend leurs complétions
+void UringPoller::stop(int fd) {
+	submit(0, 0);
+	struct io_uring_sync_cancel_reg reg;
+	std::memset(&reg, 0, sizeof(reg));
+	reg.fd = fd;
+	reg.flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+	reg.timeout.tv_sec = -1;
+	reg.timeout.tv_nsec = -1;
+	uringRegister(ringFd, IORING_REGISTER_SYNC_CANCEL, &reg, 1);
+}
+
+// Retire toutes les opérations du fd avant qu'il soit fermé : une fois son
+// numéro réutilisé, une opération restée en vol viserait la mauvaise connexion
+void UringPoller::cancel(int fd) {
+	stop(fd);
+	// Les complétions déjà publiées pour ce fd seront ignorées
+	++fds[fd].gen;
+}
+
+bool UringPoller::add(int fd, unsigned events) {
+	FdState& st = state(fd);
+	st.kind = POLL;
+	st.events = events;
+	arm(fd);
+	return true;
+}
+
+bool UringPoller::modify(int fd, unsigned events) {
+	FdState& st = state(fd);
+	if (st.kind != POLL)
+		return false;
+	if (st.events == events)
+		return true;
+	cancel(fd);
+	st.events = events;
+	arm(fd);
+	return true;
+}
+
+void UringPoller::remove(int fd) {
+	if (fd < 0 || static_cast<size_t>(fd) >= fds.size() || fds[fd].kind == NONE)
+		return;
+	cancel(fd);
+	fds[fd].kind = NONE;
+	fds[fd].paused = false;
+}
+
+bool UringPoller::addListener(int fd) {
+	state(fd).kind = LISTENER;
+	arm(fd);
+	return true;
+}
+
+bool UringPoller::addConnection(int fd) {
+	state(fd).kind = CONNECTION;
+	arm(fd);
+	return true;
+}
+
+bool UringPoller::completions() const {
+	return true;
+}
+
+bool UringPoller::send(int fd, const struct iovec* iov, int iovcnt) {
+	FdState& st = state(fd);
+	if (st.kind != CONNECTION || iovcnt <= 0)
+		return false;
+	if (st.send == NULL)
+		st.send = new SendSlot;
+	if (iovcnt > MAX_SEND_IOV)
+		iovcnt = MAX_SEND_IOV;
+	std::memcpy(st.send->iov, iov, iovcnt * sizeof(struct iovec));
+	std::memset(&st.send->msg, 0, sizeof(st.send->msg));
+	st.send->msg.msg_iov = st.send->iov;
+	st.send->msg.msg_iovlen = iovcnt;
+
+	struct io_uring_sqe* sqe = getSqe();
+	if (sqe == NULL)
+		return false;
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = fd;
+	sqe->addr = reinterpret_cast<uint64_t>(&st.send->msg);
+	sqe->len = 1;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = packUserData(OP_SEND, fd, st.gen);
+	return true;
+}
+
+// Les complétions des opérations annulées (-ECANCELED, ou les octets déjà
+// reçus ou envoyés) restent valides et sont remontées par wait()
+void UringPoller::suspend() {
+	suspended = true;
+	for (size_t fd = 0; fd < fds.size(); ++fd) {
+		if (fds[fd].kind == LISTENER || fds[fd].kind == CONNECTION)
+			stop(static_cast<int>(fd));
+	}
+}
+
+// Seul le recv est annulé, par son user_data : un envoi en vol continue
+void UringPoller::pauseReading(int fd) {
+	FdState& st = state(fd);
+	if (st.kind != CONNECTION || st.paused)
+		return;
+	st.paused = true;
+	submit(0, 0);
+	struct io_uring_sync_cancel_reg reg;
+	std::memset(&reg, 0, sizeof(reg));
+	reg.addr = packUserData(OP_RECV, fd, st.gen);
+	reg.fd = -1;
+	reg.timeout.tv_sec = -1;
+	reg.timeout.tv_nsec = -1;
+	uringRegister(ringFd, IORING_REGISTER_SYNC_CANCEL, &reg, 1);
+}
+
+void UringPoller::resumeReading(int fd) {
+	FdState& st = state(fd);
+	if (!st.paused)
+		return;
+	st.paused = false;
+	arm(fd);
+}
+
+void UringPoller::resume() {
+	suspended = false;
+	std::vector<int> pending;
+	for (size_t i = 0; i < rearm.size(); ++i) {
+		if (fds[rearm[i]].kind == POLL)
+			pending.push_back(rearm[i]);
+	}
+	rearm.swap(pending);
+	for (size_t fd = 0; fd < fds.size(); ++fd) {
+		if (fds[fd].kind == LISTENER || fds[fd].kind == CONNECTION)
+			arm(static_cast<int>(fd));
+	}
+}
+
+int UringPoller::wait(std::vector<PollEvent>& out, int timeout_ms) {
+	out.clear();
+
+	// Rendre au noyau les tampons remontés au tour précédent
+	if (!lent.empty()) {
+		for (size_t i = 0; i < lent.size(); ++i)
+			recycle(lent[i]);
+		lent.clear();
+		__atomic_store_n(&bufRing->tail, bufTail, __ATOMIC_RELEASE);
+	}
+	// Relancer les multishots terminés (tampons épuisés, erreur d'accept...)
+	std::vector<int> pending;
+	pending.swap(rearm);
+	for (size_t i = 0; i < pending.size(); ++i)
+		arm(pending[i]);
+
+	// Soumission et attente en un seul appel système
+	unsigned head = *cqHead;
+	bool ready = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) != head;
+	if (submit(ready ? 0 : 1, timeout_ms) < 0)
+		return -1;
+
+	unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+	for (; head != tail; ++head) {
+		const struct io_uring_cqe* cqe = &cqes[head & cqMask];
+		UringOp op = static_cast<UringOp>(cqe->user_data >> 56);
+		int fd = static_cast<int>(static_cast<uint32_t>(cqe->user_data));
+		uint32_t gen = static_cast<uint32_t>(cqe->user_data >> 32) & GEN_MASK;
+		bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+
+		PollEvent pe;
+		pe.fd = fd;
+		pe.events = 0;
+		pe.result = cqe->res;
+		pe.data = NULL;
+		if (cqe->flags & IORING_CQE_F_BUFFER) {
+			uint16_t bid = static_cast<uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+			lent.push_back(bid);
+			pe.data = bufBase + static_cast<size_t>(bid) * BUF_SIZE;
+		}
+		// Complétion d'un fd retiré depuis (son tampon est tout de même rendu)
+		if (op == OP_NONE || fd < 0 || static_cast<size_t>(fd) >= fds.size() || (fds[fd].gen & GEN_MASK) != gen)
+			continue;
+
+		switch (op) {
+		case OP_ACCEPT:
+			if (!more)
+				rearm.push_back(fd);
+			pe.events = ACCEPTED;
+			break;
+		case OP_RECV:
+			// Annulé par pauseReading() : relancé par resumeReading()
+			if (cqe->res == -ECANCELED && fds[fd].paused)
+				continue;
+			// Plus de tampon libre : ils reviennent au prochain wait()
+			if (cqe->res == -ENOBUFS) {
+				rearm.push_back(fd);
+				continue;
+			}
+			if (!more && cqe->res > 0)
+				rearm.push_back(fd);
+			pe.events = RECEIVED;
+			break;
+		case OP_SEND:
+			pe.events = SENT;
+			break;
+		case OP_POLL:
+			if (!more)
+				rearm.push_back(fd);
+			if (cqe->res < 0) {
+				pe.events = HANGUP;
+				break;
+			}
+			if (cqe->res & POLLIN)
+				pe.events |= READ;
+			if (cqe->res & POLLOUT)
+				pe.events |= WRITE;
+			if (cqe->res & (POLLERR | POLLHUP | POLLRDHUP))
+				pe.events |= HANGUP;
+			break;
+		case OP_NONE:
+			break;
+		}
+		out.push_back(pe);
+	}
+	__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+	return static_cast<int>(out.size());
+}
+
+const char* UringPoller::name() const {
+	return "io_uring";
+}
+
+#endif